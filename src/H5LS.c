@@ -102,6 +102,52 @@ cache_replacement_policy_t get_replacement_policy_from_str(char *str) {
   }
 }
 
+/*
+  This is to convert the RMA synchronization mode from string to enum;
+  RMA_INVALID if the string is not a mode
+ */
+cache_rma_mode_t get_rma_mode_from_str(char *str) {
+  if (!strcmp(str, "FENCE"))
+    return RMA_FENCE;
+  else if (!strcmp(str, "PASSIVE"))
+    return RMA_PASSIVE;
+  else {
+    LOG_ERROR(-1, "unknown RMA mode: %s", str);
+    return RMA_INVALID;
+  }
+}
+
+/*
+  This is to convert the unit of the read cache from string to enum;
+  READ_UNIT_INVALID if the string is not a unit
+ */
+cache_read_unit_t get_read_unit_from_str(char *str) {
+  if (!strcmp(str, "SAMPLE"))
+    return READ_UNIT_SAMPLE;
+  else if (!strcmp(str, "CHUNK"))
+    return READ_UNIT_CHUNK;
+  else {
+    LOG_ERROR(-1, "unknown read cache unit: %s", str);
+    return READ_UNIT_INVALID;
+  }
+}
+
+/*
+  This is to convert the durability of the write buffer from string to enum
+ */
+cache_durability_t get_durability_from_str(char *str) {
+  if (!strcmp(str, "NONE"))
+    return DURABILITY_NONE;
+  else if (!strcmp(str, "TASK"))
+    return DURABILITY_TASK;
+  else if (!strcmp(str, "CLOSE"))
+    return DURABILITY_CLOSE;
+  else {
+    LOG_ERROR(-1, "unknown write durability: %s", str);
+    return DURABILITY_INVALID;
+  }
+}
+
 /*---------------------------------------------------------------------------
  * Function:    readLSConf
  *
@@ -139,6 +185,20 @@ herr_t readLSConf(char *fname, cache_storage_t *LS) {
   LS->fusion_threshold = 0; // By default no merging the dataset at all.
   LS->replacement_policy = LRU;
   LS->write_buffer_size = 2147483648; // default size 2GB
+  LS->rma_mode = RMA_FENCE;
+  LS->read_unit = READ_UNIT_SAMPLE;
+  LS->decode_threads = 0;
+  LS->read_ahead_depth = 0;
+  LS->schedule_depth = 2;
+  LS->prefetch_block_size = 268435456; // 256 MiB
+  LS->prefetch_inflight = 4;
+  LS->prefetch_autotune = true;
+  LS->prefetch_yield = true;
+  LS->flush_max_age = 0.0;
+  LS->flush_idle = 0.0;
+  LS->prefetch_aggregators = 0;
+  LS->persistent = false;
+  LS->write_durability = DURABILITY_TASK;
   while (fgets(line, 256, file) != NULL) {
     char ip[256], mac[256];
     linenum++;
@@ -172,6 +232,46 @@ herr_t readLSConf(char *fname, cache_storage_t *LS) {
     } else if (!strcmp(ip, "HDF5_CACHE_REPLACEMENT_POLICY")) {
       if (get_replacement_policy_from_str(mac) > 0)
         LS->replacement_policy = get_replacement_policy_from_str(mac);
+    } else if (!strcmp(ip, "HDF5_CACHE_RMA_MODE")) {
+      cache_rma_mode_t mode = get_rma_mode_from_str(mac);
+      if (mode != RMA_INVALID)
+        LS->rma_mode = mode;
+    } else if (!strcmp(ip, "HDF5_CACHE_READ_UNIT")) {
+      cache_read_unit_t unit = get_read_unit_from_str(mac);
+      if (unit != READ_UNIT_INVALID)
+        LS->read_unit = unit;
+    } else if (!strcmp(ip, "HDF5_CACHE_DECODE_THREADS")) {
+      LS->decode_threads = atoi(mac);
+    } else if (!strcmp(ip, "HDF5_CACHE_READ_AHEAD_DEPTH")) {
+      LS->read_ahead_depth = atoi(mac);
+    } else if (!strcmp(ip, "HDF5_CACHE_PREFETCH_BLOCK_SIZE")) {
+      LS->prefetch_block_size = (hsize_t)atof(mac);
+    } else if (!strcmp(ip, "HDF5_CACHE_PREFETCH_INFLIGHT")) {
+      LS->prefetch_inflight = atoi(mac);
+      if (LS->prefetch_inflight < 1)
+        LS->prefetch_inflight = 1;
+    } else if (!strcmp(ip, "HDF5_CACHE_PREFETCH_AUTOTUNE")) {
+      LS->prefetch_autotune = !strcmp(mac, "yes");
+    } else if (!strcmp(ip, "HDF5_CACHE_PREFETCH_YIELD")) {
+      LS->prefetch_yield = !strcmp(mac, "yes");
+    } else if (!strcmp(ip, "HDF5_CACHE_FLUSH_MAX_AGE")) {
+      LS->flush_max_age = atof(mac);
+    } else if (!strcmp(ip, "HDF5_CACHE_FLUSH_IDLE")) {
+      LS->flush_idle = atof(mac);
+    } else if (!strcmp(ip, "HDF5_CACHE_WRITE_DURABILITY")) {
+      cache_durability_t durability = get_durability_from_str(mac);
+      if (durability != DURABILITY_INVALID)
+        LS->write_durability = durability;
+    } else if (!strcmp(ip, "HDF5_CACHE_PERSISTENT")) {
+      LS->persistent = !strcmp(mac, "yes");
+    } else if (!strcmp(ip, "HDF5_CACHE_PREFETCH_AGGREGATORS")) {
+      LS->prefetch_aggregators = atoi(mac);
+      if (LS->prefetch_aggregators < 0)
+        LS->prefetch_aggregators = 0;
+    } else if (!strcmp(ip, "HDF5_CACHE_SCHEDULE_DEPTH")) {
+      LS->schedule_depth = atoi(mac);
+      if (LS->schedule_depth < 1)
+        LS->schedule_depth = 1;
     } else {
       LOG_WARN(-1, "Unknown configuration setup:", ip);
     }
@@ -185,6 +285,13 @@ herr_t readLSConf(char *fname, cache_storage_t *LS) {
   }
   fclose(file);
   LS->mspace_left = LS->mspace_total;
+  LS->cache_list = NULL;
+  LS->cache_head = NULL;
+  LS->retained_head = NULL;
+  LS->decode_pool = NULL;
+  LS->prefetch_list = NULL;
+  LS->demand_reads = 0;
+  LS->demand_misses = 0;
   struct stat sb;
   if (strcmp(LS->type, "GPU") == 0 || strcmp(LS->type, "MEMORY") == 0 ||
       (stat(LS->path, &sb) == 0 && S_ISDIR(sb.st_mode))) {
@@ -270,6 +377,13 @@ herr_t H5LSset(cache_storage_t *LS, char *type, char *path,
   LS->mspace_total = mspace_total;
   LS->mspace_left = mspace_total;
   LS->num_cache = 0;
+  LS->cache_list = NULL;
+  LS->cache_head = NULL;
+  LS->retained_head = NULL;
+  LS->decode_pool = NULL;
+  LS->prefetch_list = NULL;
+  LS->demand_reads = 0;
+  LS->demand_misses = 0;
   LS->replacement_policy = replacement;
   if (path != NULL)
     strcpy(LS->path, path); // check existence of the space
@@ -392,43 +506,34 @@ herr_t H5LSclaim_space(cache_storage_t *LS, hsize_t size, cache_claim_t type,
     if (type == SOFT) {
       return FAIL;
     } else {
-      double mspace = 0.0;
+      double mspace = LS->mspace_left;
       /// compute the total space for all the temporal cache;
       CacheList *head = LS->cache_head;
-      cache_t *tmp, *stay;
+      cache_t *tmp;
       while (head != NULL) {
-        if (head->cache->duration == TEMPORAL) {
+        if (head->cache->duration == TEMPORAL)
           mspace += head->cache->mspace_total;
-          tmp = head->cache;
-        }
         head = head->next;
       }
-      stay = tmp;
       if (mspace < size) {
 #ifndef NDEBUG
         LOG_DEBUG(-1, "mspace (bytes): %f - %lu\n", mspace, size);
 #endif
         return FAIL;
-      } else {
-        mspace = 0.0;
-        while (mspace < size) {
-          head = LS->cache_list;
-          while (head != NULL) {
-            if ((head->cache->duration == TEMPORAL) &&
-                H5LScompare_cache(head->cache, tmp, crp)) {
-              tmp = head->cache;
-              stay = tmp;
-            }
-            if (mspace > 0)
-              continue; // if already found one, as long as we find another one
-                        // that is
-            head = head->next;
-          }
-          mspace += tmp->mspace_total;
-          H5LSremove_cache(LS, tmp);
-          tmp = stay;
-        }
       }
+      // evict the temporal caches in the order of the replacement policy
+      // until the space is available
+      while (LS->mspace_left <= size) {
+        tmp = NULL;
+        for (head = LS->cache_head; head != NULL; head = head->next)
+          if (head->cache->duration == TEMPORAL &&
+              (tmp == NULL || H5LScompare_cache(head->cache, tmp, crp)))
+            tmp = head->cache;
+        if (tmp == NULL)
+          return FAIL;
+        H5LSremove_cache(LS, tmp);
+      }
+      LS->mspace_left = LS->mspace_left - size;
     }
   }
 
@@ -445,24 +550,29 @@ herr_t H5LSremove_cache(cache_storage_t *LS, cache_t *cache) {
   LOG_INFO(-1, "H5LSremove_space");
 #endif
   if (cache != NULL) {
-    if (LS->io_node && strcmp(LS->scope, "GLOBAL"))
+    // a persistent read cache stays on the storage for the next jobs
+    if (LS->io_node && strcmp(LS->scope, "GLOBAL") &&
+        !(LS->persistent && cache->purpose == READ))
       LS->mmap_cls->removeCacheFolder(cache->path);
 
-    CacheList *head = LS->cache_head;
-    while (head != NULL && head->cache != NULL && head->cache != cache) {
-      head = head->next;
+    CacheList **head = &LS->cache_head;
+    while (*head != NULL && (*head)->cache != cache) {
+      head = &(*head)->next;
     }
-    if (head != NULL && head->cache != NULL && head->cache == cache) {
+    if (*head != NULL) {
+      CacheList *node = *head;
       LS->mspace_left += cache->mspace_total;
 #ifndef NDEBUG
       LOG_DEBUG(-1, "Cache storage space left: %lu bytes\n", LS->mspace_left);
 #endif
-
+      // unlink the cache, so that it is not evicted again
+      *head = node->next;
+      if (LS->cache_list == node)
+        LS->cache_list = node->next;
+      free(node);
       free(cache);
       cache = NULL;
     }
-    if (head != NULL)
-      head = head->next;
   } else {
     if (LS->io_node)
       LOG_ERROR(-1, "Trying to remove nonexisting cache\n");
@@ -474,6 +584,56 @@ herr_t H5LSremove_cache(cache_storage_t *LS, cache_t *cache) {
   return 0;
 } /* end H5LSremove_cache() */
 
+/*-------------------------------------------------------------------------
+ *  Function: H5LSretain_cache
+ *  Purpose: Unregister a persistent cache whose files stay on the storage
+ *           for the next jobs. Its space stays claimed until a cache of the
+ *           job takes its place (see H5LSrelease_retained_cache).
+ *-------------------------------------------------------------------------
+ */
+herr_t H5LSretain_cache(cache_storage_t *LS, cache_t *cache) {
+#ifndef NDEBUG
+  LOG_INFO(-1, "H5LSretain_cache");
+#endif
+  CacheList **head = &LS->cache_head;
+  while (*head != NULL && (*head)->cache != cache)
+    head = &(*head)->next;
+  if (*head == NULL)
+    return FAIL;
+  CacheList *node = *head;
+  *head = node->next;
+  if (LS->cache_list == node)
+    LS->cache_list = node->next;
+  node->target = NULL;
+  node->next = LS->retained_head;
+  LS->retained_head = node;
+  return SUCCEED;
+} /* end H5LSretain_cache() */
+
+/*-------------------------------------------------------------------------
+ *  Function: H5LSrelease_retained_cache
+ *  Purpose: Return the space of the persistent cache retained at path, if
+ *           any, once a cache of the job takes its place.
+ *  Return:  0 / -1 (no cache retained at path)
+ *-------------------------------------------------------------------------
+ */
+herr_t H5LSrelease_retained_cache(cache_storage_t *LS, const char *path) {
+  CacheList **head = &LS->retained_head;
+  while (*head != NULL && strcmp((*head)->cache->path, path))
+    head = &(*head)->next;
+  if (*head == NULL)
+    return FAIL;
+  CacheList *node = *head;
+  *head = node->next;
+  LS->mspace_left += node->cache->mspace_total;
+#ifndef NDEBUG
+  LOG_DEBUG(-1, "Cache storage space left: %lu bytes", LS->mspace_left);
+#endif
+  free(node->cache);
+  free(node);
+  return SUCCEED;
+} /* end H5LSrelease_retained_cache() */
+
 /*-------------------------------------------------------------------------
  *  Function: H5LSremove_cache_all
  *  Purpose: Clear all cache, remove all the files associated with it.
@@ -508,8 +668,14 @@ herr_t H5LSregister_cache(cache_storage_t *LS, cache_t *cache, void *target) {
   LS->cache_list = (CacheList *)malloc(sizeof(CacheList));
   LS->cache_list->cache = cache;
   LS->cache_list->target = target;
+  // the caches are kept in a list for the eviction (see H5LSclaim_space)
+  LS->cache_list->next = LS->cache_head;
+  LS->cache_head = LS->cache_list;
   cache->access_history.time_stamp[0] = time(NULL);
   cache->access_history.count = 0;
+  // the cache is in use by its target; the caches that may be evicted are
+  // made TEMPORAL after they are registered
+  cache->duration = PERMANENT;
   return SUCCEED;
 } /* end H5LSregister_cache() */
 
@@ -24,12 +24,23 @@ enum cache_duration { PERMANENT, TEMPORAL };
 enum cache_claim { SOFT, HARD };
 enum cache_replacement_policy { FIFO, LIFO, LRU, LFU };
 enum close_object { FILE_CLOSE, GROUP_CLOSE, DATASET_CLOSE };
+enum cache_rma_mode { RMA_FENCE, RMA_PASSIVE, RMA_INVALID };
+enum cache_read_unit { READ_UNIT_SAMPLE, READ_UNIT_CHUNK, READ_UNIT_INVALID };
+enum cache_durability {
+  DURABILITY_NONE,
+  DURABILITY_TASK,
+  DURABILITY_CLOSE,
+  DURABILITY_INVALID
+};
 
 typedef enum close_object close_object_t;
 typedef enum cache_purpose cache_purpose_t;
 typedef enum cache_duration cache_duration_t;
 typedef enum cache_claim cache_claim_t;
 typedef enum cache_replacement_policy cache_replacement_policy_t;
+typedef enum cache_rma_mode cache_rma_mode_t;
+typedef enum cache_read_unit cache_read_unit_t;
+typedef enum cache_durability cache_durability_t;
 /*
    This define the cache
  */
@@ -70,6 +81,7 @@ typedef struct _task_data_t {
   hsize_t offset; // offset in memory mapped file on SSD
   hsize_t size;
   void **buf;
+  void *merged_buf; // staging buffer of the coalesced writes (or NULL)
   struct _task_data_t *previous;
   struct _task_data_t *next;
 } task_data_t;
@@ -88,6 +100,7 @@ typedef struct _MPI_INFO {
   MPI_Comm comm, comm_t; // global communicator
   MPI_Comm node_comm;    // node local communicator
   MPI_Win win, win_t;
+  MPI_Win shm_win; // node shared memory backing the read cache (MEMORY)
   hsize_t offset;
 } MPI_INFO;
 
@@ -110,6 +123,9 @@ typedef struct _IO_THREAD {
   bool dset_cached;  // whether the entire dataset is cached to SSD or not.
   hsize_t offset_current;
   int round;
+  double fusion_time; // time the oldest task waiting to be fused was queued
+  double write_time;  // time of the last write
+  void *flush_timer;  // thread flushing the fused tasks on time (or NULL)
 } IO_THREAD;
 
 // Memory mapped files
@@ -123,6 +139,9 @@ typedef struct _MMAP {
                    // buffer, return the H5Dread_to_cache function, the back
                    // ground thread write the data to the SSD.
   hsize_t offset;  // the offset of the memory map
+  void **peer_buf; // read buffers of the ranks on the same node, indexed by
+                   // rank (NULL if not accessible)
+  cache_durability_t durability; // when the written data is synced
 } MMAP;
 
 // Dataset
@@ -137,6 +156,66 @@ typedef struct _BATCH {
   int size;
 } BATCH;
 
+// a contiguous byte range moved between a local buffer and the cache window
+// of another rank
+typedef struct _RMA_SEG {
+  int rank;      // rank that owns the cached bytes
+  MPI_Aint disp; // byte offset in the window of the owner
+  MPI_Aint pos;  // byte offset in the local buffer
+  size_t len;    // number of bytes
+  size_t block;  // global index of the sample the bytes belong to
+} RMA_SEG;
+
+// read-ahead of a dataset: pattern of the reads, and the samples fetched
+// ahead of the next reads
+typedef struct _READ_AHEAD {
+  int first;            // first sample of the previous read
+  int count;            // number of samples of the previous read
+  int stride;           // distance between the first samples of two reads
+  int nmatch;           // number of reads that followed the same stride
+  BATCH samples;        // samples fetched ahead (sorted)
+  char *buf;            // the samples fetched ahead, back to back
+  request_list_t *reqs; // reads in flight
+} READ_AHEAD;
+
+// prefetch schedule of a dataset: the samples of the batches that will be
+// read next, in order, staged a few batches ahead in a ring of buffers
+typedef struct _PREFETCH_SCHEDULE {
+  int *indices;          // samples, in the order of the reads
+  size_t n;              // number of samples
+  size_t batch_size;     // number of samples per batch
+  size_t nbatch;         // number of batches
+  size_t head;           // oldest batch held by the ring
+  size_t tail;           // next batch to stage
+  int depth;             // number of buffers of the ring
+  BATCH *slots;          // samples staged in each buffer (sorted)
+  char **bufs;           // staged samples of each buffer, back to back
+  request_list_t **reqs; // reads in flight for each buffer
+  hid_t dxpl_id;         // transfer properties of the reads
+} PREFETCH_SCHEDULE;
+
+// manifest of a persistent read cache: what the cache of a rank holds, so
+// that a later job can adopt it. The residency flags of the samples of the
+// rank follow it in the manifest file.
+#define CACHE_MANIFEST_MAGIC "H5CMAN01"
+typedef struct _CACHE_MANIFEST {
+  char magic[8];                    // CACHE_MANIFEST_MAGIC
+  char file[255];                   // HDF5 file
+  char dset[255];                   // dataset
+  int64_t file_mtime;               // modification time of the file
+  int64_t file_size;                // size of the file
+  int nproc;                        // number of ranks sharing the cache
+  int rank;                         // rank owning the cache
+  int ndims;                        // rank of the dataset
+  int chunked;                      // the samples are the HDF5 chunks
+  hsize_t dims[H5S_MAX_RANK];       // extent of the dataset
+  hsize_t chunk_dims[H5S_MAX_RANK]; // extent of a chunk
+  size_t esize;                     // size of an element
+  size_t ns_loc;                    // number of samples of the rank
+  size_t s_offset;                  // first sample of the rank
+  uint64_t checksum;                // checksum of the resident samples
+} CACHE_MANIFEST;
+
 typedef struct _DSET {
   SAMPLE sample;
   size_t ns_loc;    // number of samples per rank
@@ -146,9 +225,31 @@ typedef struct _DSET {
   BATCH batch;      // batch data to read
   int ns_cached;    // number of samples that are cached
   bool contig_read; // whether the batch of data to read is contigues or not.
-  MPI_Datatype mpi_datatype; // the constructed mpi dataset
-  hid_t h5_datatype;         // hdf5 dataset
-  size_t esize;              // the size of an element in bytes.
+  hid_t h5_datatype;   // hdf5 dataset
+  size_t esize;        // the size of an element in bytes.
+  hsize_t meta_offset; // offset of the cache metadata in the window
+  hsize_t win_size;    // size of the window (samples + metadata)
+  int64_t ns_pending;  // samples newly cached by this rank, not yet added
+                       // to the global counter
+  int64_t ns_sent;     // origin buffer of the counter update in flight
+  int64_t ns_claimed;  // samples for which this rank claimed cache space
+  int64_t ns_put_claimed; // samples cached in the slice of this rank by the
+                          // reads (of all the ranks) that it claimed space for
+  int64_t *put_pending;   // samples newly cached by this rank, per owner,
+                          // not yet added to the counters of the owners
+  int64_t *put_sent;      // origin buffer of the owner updates in flight
+  int64_t *owner_full;    // the owners that take no more samples (their
+                          // cache storage is full), as last fetched
+  int ndims;                        // rank of the dataset
+  hsize_t dims[H5S_MAX_RANK];       // extent of the dataset
+  bool chunked;                     // the samples are the HDF5 chunks
+  hsize_t chunk_dims[H5S_MAX_RANK]; // extent of a chunk
+  hsize_t nchunks[H5S_MAX_RANK];    // number of chunks along each dimension
+  struct _FILTER_PIPELINE *pipeline; // filters of the chunks, if the raw
+                                     // chunks are decoded by the cache
+  READ_AHEAD ra;                     // read-ahead of the uncached samples
+  PREFETCH_SCHEDULE *schedule;       // batches announced by the application
+  CACHE_MANIFEST *manifest;          // kept at close (persistent cache)
 } DSET;
 
 /*
@@ -184,6 +285,11 @@ typedef struct H5LS_cache_io_class_t {
   herr_t (*read_data_from_cache)(void *dset, hid_t mem_type_id,
                                  hid_t mem_space_id, hid_t file_space_id,
                                  hid_t plist_id, void *buf, void **req);
+  // serve the cached part of a selection from the cache, read the rest from
+  // the under VOL and cache it
+  herr_t (*read_data_through_cache)(void *dset, hid_t mem_type_id,
+                                    hid_t mem_space_id, hid_t file_space_id,
+                                    hid_t plist_id, void *buf, void **req);
 
 } H5LS_cache_io_class_t;
 
@@ -196,6 +302,13 @@ typedef struct H5LS_mmap_class_t {
   herr_t (*create_read_mmap)(MMAP *mmap, hsize_t size);
   herr_t (*remove_read_mmap)(MMAP *mmap, hsize_t size);
   herr_t (*removeCacheFolder)(const char *path);
+  // map the read buffer created by another process on the same node
+  void *(*attach_read_mmap)(const char *fname, hsize_t size);
+  herr_t (*detach_read_mmap)(void *buf, hsize_t size);
+  // sync the data written to the write buffer to the storage
+  herr_t (*sync_write_mmap)(MMAP *mmap);
+  // drop the pages of a range of the write buffer once it is flushed
+  herr_t (*release_write_mmap)(MMAP *mmap, hsize_t offset, hsize_t size);
 } H5LS_mmap_class_t;
 
 typedef struct cache_storage_t {
@@ -205,12 +318,34 @@ typedef struct cache_storage_t {
   hsize_t mspace_total;
   hsize_t mspace_left;
   CacheList *cache_list, *cache_head;
+  CacheList *retained_head; // persistent caches kept for the next jobs
   int num_cache;
   bool io_node; // select I/O node for I/O
   double write_buffer_size;
   double fusion_threshold;
   void *previous_write_req;
   cache_replacement_policy_t replacement_policy;
+  cache_rma_mode_t rma_mode; // synchronization of the read cache windows
+  cache_read_unit_t read_unit; // unit of the read cache (sample or chunk)
+  int decode_threads; // threads decoding raw chunks (0: decoded by HDF5)
+  struct _DECODE_POOL *decode_pool; // started at the first decoding
+  // the asynchronous prefetches in flight on this rank, and the demand
+  // reads: the number of reads in progress, and the number of reads that
+  // went to the under VOL (misses), which may queue behind the prefetches
+  struct _prefetch_async_t *prefetch_list;
+  int demand_reads;
+  unsigned long demand_misses;
+  int read_ahead_depth; // number of predicted reads fetched ahead (0: off)
+  int schedule_depth;   // number of scheduled batches staged ahead
+  hsize_t prefetch_block_size; // size of the reads of a prefetch (initial)
+  int prefetch_inflight;       // largest number of prefetch reads in flight
+  bool prefetch_autotune; // tune the prefetch reads from the bandwidth
+  bool prefetch_yield; // asynchronous prefetch yields to the demand reads
+  double flush_max_age; // seconds before the fused writes are flushed (0: off)
+  double flush_idle; // seconds without writes before flushing them (0: off)
+  int prefetch_aggregators; // ranks per node reading a prefetch (0: all)
+  bool persistent; // keep the read caches (SSD) across jobs
+  cache_durability_t write_durability; // sync of the write buffer (SSD)
   const H5LS_mmap_class_t *mmap_cls;
   const H5LS_cache_io_class_t *cache_io_cls; // for different cache storage
 } cache_storage_t;
@@ -236,6 +371,9 @@ extern "C" {
 const H5LS_mmap_class_t *get_H5LS_mmap_class_t(char *type);
 herr_t readLSConf(char *fname, cache_storage_t *LS);
 cache_replacement_policy_t get_replacement_policy_from_str(char *str);
+cache_rma_mode_t get_rma_mode_from_str(char *str);
+cache_read_unit_t get_read_unit_from_str(char *str);
+cache_durability_t get_durability_from_str(char *str);
 herr_t H5LSset(cache_storage_t *LS, char *type, char *path, hsize_t avail_space,
                cache_replacement_policy_t t);
 herr_t H5LSclaim_space(cache_storage_t *LS, hsize_t size, cache_claim_t type,
@@ -243,6 +381,8 @@ herr_t H5LSclaim_space(cache_storage_t *LS, hsize_t size, cache_claim_t type,
 herr_t H5LSremove_cache_all(cache_storage_t *LS);
 herr_t H5LSregister_cache(cache_storage_t *LS, cache_t *cache, void *target);
 herr_t H5LSremove_cache(cache_storage_t *LS, cache_t *cache);
+herr_t H5LSretain_cache(cache_storage_t *LS, cache_t *cache);
+herr_t H5LSrelease_retained_cache(cache_storage_t *LS, const char *path);
 herr_t H5LSrecord_cache_access(cache_t *cache);
 herr_t H5LSget(cache_storage_t *LS, char *flag, void *value);
 cache_storage_t *
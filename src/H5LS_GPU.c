@@ -12,6 +12,7 @@
 // Memory map
 // POSIX I/O
 #include "H5LS.h"
+#include "cache_utils.h"
 #include "string.h"
 #include <fcntl.h>
 #include <sys/mman.h>
@@ -21,6 +22,14 @@
 
 #include <assert.h>
 
+#ifndef SUCCEED
+#define SUCCEED 0
+#endif
+
+#ifndef FAIL
+#define FAIL -1
+#endif
+
 #include <cuda.h>
 #include <cuda_runtime_api.h>
 #define CUDA_RUNTIME_API_CALL(apiFuncCall)                                     \
@@ -47,30 +56,32 @@ static herr_t H5Ssel_gather_copy(hid_t space, hid_t tid, const void *buf,
   // assert(false);
   unsigned flags = H5S_SEL_ITER_GET_SEQ_LIST_SORTED;
   size_t elmt_size = H5Tget_size(tid);
-  hid_t iter = H5Ssel_iter_create(space, elmt_size, flags);
-  size_t maxseq = H5Sget_select_npoints(space);
-  size_t maxbytes = maxseq * elmt_size;
+  SEQ_SCRATCH *scratch = get_seq_scratch();
   size_t nseq, nbytes;
-  size_t *len = (size_t *)malloc(maxseq * sizeof(size_t));
-  hsize_t *off = (hsize_t *)malloc(maxseq * sizeof(hsize_t));
-  H5Ssel_iter_get_seq_list(iter, maxseq, maxbytes, &nseq, &nbytes, off, len);
   hsize_t off_contig = 0;
   char *p = (char *)buf;
   char *mp = (char *)mbuf;
-  // cudaStream_t stream0;
-  // cudaStreamCreate(&stream0);
-  int i;
-  for (i = 0; i < nseq; i++) {
-    // memcpy(&mp[offset+off_contig], &p[off[i]], len[i]);
-    CUDA_RUNTIME_API_CALL(cudaMemcpy(&mp[offset + off_contig], &p[off[i]],
-                                     len[i], cudaMemcpyDeviceToHost));
-    // CUDA_RUNTIME_API_CALL( cudaMemcpyAsync(&mp[offset+off_contig],
-    // &p[off[i]], len[i], cudaMemcpyDeviceToHost, stream0 ) );
-    // CUDA_RUNTIME_API_CALL( cudaMemPrefetchAsync(&mp[offset+off_contig],
-    // len[i], 1, 0) );
-    off_contig += len[i];
-  }
-  return 0;
+  size_t i;
+  if (scratch == NULL)
+    return FAIL;
+  hid_t iter = H5Ssel_iter_create(space, elmt_size, flags);
+  if (iter < 0)
+    return FAIL;
+  do {
+    if (H5Ssel_iter_get_seq_list(iter, SEQ_LIST_BATCH, SIZE_MAX, &nseq,
+                                 &nbytes, scratch->off, scratch->len) < 0) {
+      H5Ssel_iter_close(iter);
+      return FAIL;
+    }
+    for (i = 0; i < nseq; i++) {
+      CUDA_RUNTIME_API_CALL(cudaMemcpy(&mp[offset + off_contig],
+                                       &p[scratch->off[i]], scratch->len[i],
+                                       cudaMemcpyDeviceToHost));
+      off_contig += scratch->len[i];
+    }
+  } while (nseq == SEQ_LIST_BATCH);
+  H5Ssel_iter_close(iter);
+  return SUCCEED;
 } /* end  H5Ssel_gather_copy() */
 
 static void *H5LS_GPU_write_buffer_to_mmap(hid_t mem_space_id,
@@ -161,4 +172,8 @@ const H5LS_mmap_class_t H5LS_GPU_mmap_ext_g = {
     H5LS_GPU_create_read_mmap,
     H5LS_GPU_remove_read_mmap,
     removeFolderFake,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
 };
@@ -12,6 +12,7 @@
 // Memory map
 // POSIX I/O
 #include "H5LS.h"
+#include "cache_utils.h"
 #include "string.h"
 #include <fcntl.h>
 #include <sys/mman.h>
@@ -19,12 +20,24 @@
 #include <sys/statvfs.h>
 #include <unistd.h>
 
+#ifndef SUCCEED
+#define SUCCEED 0
+#endif
+
+#ifndef FAIL
+#define FAIL -1
+#endif
+
 /*-------------------------------------------------------------------------
  * Function:    H5Ssel_gather_copy
  *
- * Purpose:     Copy the data buffer into memory.
+ * Purpose:     Copy the data buffer into memory. The selection is walked
+ *              in batches of sequences, using the scratch space of the
+ *              calling thread, so that the memory used does not depend on
+ *              the size of the selection.
  *
- * Return:      NULL
+ * Return:      Success:    0
+ *              Failure:    -1
  *
  *-------------------------------------------------------------------------
  */
@@ -32,28 +45,38 @@ static herr_t H5Ssel_gather_copy(hid_t space, hid_t tid, const void *buf,
                                  void *mbuf, hsize_t offset) {
   unsigned flags = H5S_SEL_ITER_GET_SEQ_LIST_SORTED;
   size_t elmt_size = H5Tget_size(tid);
-  hid_t iter = H5Ssel_iter_create(space, elmt_size, flags);
-  size_t maxseq = H5Sget_select_npoints(space);
-  size_t maxbytes = maxseq * elmt_size;
+  SEQ_SCRATCH *scratch = get_seq_scratch();
   size_t nseq, nbytes;
-  size_t *len = (size_t *)malloc(maxseq * sizeof(size_t));
-  hsize_t *off = (hsize_t *)malloc(maxseq * sizeof(hsize_t));
-  H5Ssel_iter_get_seq_list(iter, maxseq, maxbytes, &nseq, &nbytes, off, len);
   hsize_t off_contig = 0;
   char *p = (char *)buf;
   char *mp = (char *)mbuf;
-  int i = 0;
-  for (i = 0; i < nseq; i++) {
-    memcpy(&mp[offset + off_contig], &p[off[i]], len[i]);
-    off_contig += len[i];
-  }
-  return 0;
+  size_t i;
+  if (scratch == NULL)
+    return FAIL;
+  hid_t iter = H5Ssel_iter_create(space, elmt_size, flags);
+  if (iter < 0)
+    return FAIL;
+  do {
+    if (H5Ssel_iter_get_seq_list(iter, SEQ_LIST_BATCH, SIZE_MAX, &nseq,
+                                 &nbytes, scratch->off, scratch->len) < 0) {
+      H5Ssel_iter_close(iter);
+      return FAIL;
+    }
+    for (i = 0; i < nseq; i++) {
+      memcpy(&mp[offset + off_contig], &p[scratch->off[i]], scratch->len[i]);
+      off_contig += scratch->len[i];
+    }
+  } while (nseq == SEQ_LIST_BATCH);
+  H5Ssel_iter_close(iter);
+  return SUCCEED;
 } /* end  H5Ssel_gather_copy() */
 
 static void *H5LS_RAM_write_buffer_to_mmap(hid_t mem_space_id,
                                            hid_t mem_type_id, const void *buf,
                                            hsize_t size, MMAP *mm) {
-  H5Ssel_gather_copy(mem_space_id, mem_type_id, buf, mm->buf, mm->offset);
+  if (H5Ssel_gather_copy(mem_space_id, mem_type_id, buf, mm->buf,
+                         mm->offset) < 0)
+    return NULL;
   void *p = mm->buf + mm->offset;
   return p;
 }
@@ -90,4 +113,8 @@ const H5LS_mmap_class_t H5LS_RAM_mmap_ext_g = {
     H5LS_RAM_create_read_mmap,
     H5LS_RAM_remove_read_mmap,
     removeFolderFake,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
 };
@@ -10,47 +10,115 @@
 
 #include "H5LS.h"
 #include "cache_utils.h"
+#include <errno.h>
 #include <fcntl.h>
 #include <libgen.h>
 #include <stdio.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/statvfs.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+#ifndef SUCCEED
+#define SUCCEED 0
+#endif
+
+#ifndef FAIL
+#define FAIL -1
+#endif
+
+/* sync the data written to a file to the storage */
+static herr_t sync_file_data(int fd) {
+#ifdef __APPLE__
+  return fsync(fd) == 0 ? SUCCEED : FAIL;
+#else
+  return fdatasync(fd) == 0 ? SUCCEED : FAIL;
+#endif
+}
+
+/* write a list of buffers to a file from offset, resuming after short
+ * writes; the list is modified */
+static herr_t pwritev_all(int fd, struct iovec *iov, int n, off_t offset) {
+  while (n > 0) {
+    ssize_t w = pwritev(fd, iov, n, offset);
+    if (w < 0) {
+      if (errno == EINTR)
+        continue;
+      return FAIL;
+    }
+    offset += w;
+    while (n > 0 && (size_t)w >= iov->iov_len) {
+      w -= iov->iov_len;
+      iov++;
+      n--;
+    }
+    if (n > 0) {
+      iov->iov_base = (char *)iov->iov_base + w;
+      iov->iov_len -= w;
+    }
+  }
+  return SUCCEED;
+}
+
 /*-------------------------------------------------------------------------
  * Function:    H5Ssel_gather_write
  *
- * Purpose:     Copy the data buffer into local storage.
+ * Purpose:     Copy the data buffer into local storage. The selection is
+ *              walked in batches of sequences, using the scratch space of
+ *              the calling thread, so that the memory used does not depend
+ *              on the size of the selection. The sequences, which are
+ *              written back to back in the file, are merged when they are
+ *              contiguous in memory and written with one pwritev per batch.
+ *              With DURABILITY_TASK, the data is synced to the storage.
  *
- * Return:      NULL
+ * Return:      Success:    0
+ *              Failure:    -1
  *
  *-------------------------------------------------------------------------
  */
 static herr_t H5Ssel_gather_write(hid_t space, hid_t tid, const void *buf,
-                                  int fd, hsize_t offset) {
+                                  int fd, hsize_t offset,
+                                  cache_durability_t durability) {
   unsigned flags = H5S_SEL_ITER_GET_SEQ_LIST_SORTED;
   size_t elmt_size = H5Tget_size(tid);
-  hid_t iter = H5Ssel_iter_create(space, elmt_size, flags);
-  size_t maxseq = H5Sget_select_npoints(space);
-  size_t maxbytes = maxseq * elmt_size;
+  SEQ_SCRATCH *scratch = get_seq_scratch();
+  struct iovec iov[SEQ_LIST_BATCH];
   size_t nseq, nbytes;
-  size_t *len = (size_t *)malloc(maxseq * sizeof(size_t));
-  hsize_t *off = (hsize_t *)malloc(maxseq * sizeof(hsize_t));
-  H5Ssel_iter_get_seq_list(iter, maxseq, maxbytes, &nseq, &nbytes, off, len);
   hsize_t off_contig = 0;
   char *p = (char *)buf;
-  int i;
-  for (i = 0; i < nseq; i++) {
-    int err = pwrite(fd, &p[off[i]], len[i], offset + off_contig);
-    off_contig += len[i];
-  }
-#ifdef __APPLE__
-  fcntl(fd, F_NOCACHE, 1);
-#else
-  fsync(fd);
-#endif
-  return 0;
+  herr_t ret_value = SUCCEED;
+  size_t i;
+  int n;
+  if (scratch == NULL)
+    return FAIL;
+  hid_t iter = H5Ssel_iter_create(space, elmt_size, flags);
+  if (iter < 0)
+    return FAIL;
+  do {
+    if (H5Ssel_iter_get_seq_list(iter, SEQ_LIST_BATCH, SIZE_MAX, &nseq,
+                                 &nbytes, scratch->off, scratch->len) < 0) {
+      ret_value = FAIL;
+      break;
+    }
+    n = 0;
+    for (i = 0; i < nseq; i++) {
+      if (n > 0 && (char *)iov[n - 1].iov_base + iov[n - 1].iov_len ==
+                       &p[scratch->off[i]]) {
+        iov[n - 1].iov_len += scratch->len[i];
+        continue;
+      }
+      iov[n].iov_base = &p[scratch->off[i]];
+      iov[n++].iov_len = scratch->len[i];
+    }
+    if (pwritev_all(fd, iov, n, offset + off_contig) < 0)
+      ret_value = FAIL;
+    off_contig += nbytes;
+  } while (nseq == SEQ_LIST_BATCH);
+  H5Ssel_iter_close(iter);
+  if (durability == DURABILITY_TASK && sync_file_data(fd) < 0)
+    ret_value = FAIL;
+  return ret_value;
 }
 
 static herr_t H5LS_SSD_create_write_mmap(MMAP *mm, hsize_t size) {
@@ -58,13 +126,33 @@ static herr_t H5LS_SSD_create_write_mmap(MMAP *mm, hsize_t size) {
   strcpy(dname, mm->fname);
   mkdirRecursive(dirname(dname), 0755); // dirname will change dname in linux.
                                         // therefore, we make copy first.
-  struct stat info;
   mm->fd = open(mm->fname, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (mm->fd < 0)
+    return FAIL;
+#ifdef __APPLE__
+  fcntl(mm->fd, F_NOCACHE, 1);
+#endif
+  // the whole write buffer is mapped once; the data of the writes is read
+  // back from sub-ranges of the mapping when it is flushed
+  if (ftruncate(mm->fd, size) < 0) {
+    close(mm->fd);
+    return FAIL;
+  }
+  mm->buf = mmap(NULL, size, PROT_READ, MAP_SHARED, mm->fd, 0);
+  if (mm->buf == MAP_FAILED) {
+    mm->buf = NULL;
+    close(mm->fd);
+    return FAIL;
+  }
   return 0;
 }
 
 /* remove data from write space */
 static herr_t H5LS_SSD_remove_write_mmap(MMAP *mm, hsize_t size) {
+  if (mm->buf != NULL)
+    munmap(mm->buf, size);
+  mm->buf = NULL;
+  close(mm->fd);
   if (access(mm->fname, F_OK) == 0)
     remove(mm->fname);
   return 0;
@@ -74,10 +162,32 @@ static herr_t H5LS_SSD_remove_write_mmap(MMAP *mm, hsize_t size) {
 static void *H5LS_SSD_write_buffer_to_mmap(hid_t mem_space_id,
                                            hid_t mem_type_id, const void *buf,
                                            hsize_t size, MMAP *mm) {
-  H5Ssel_gather_write(mem_space_id, mem_type_id, buf, mm->fd, mm->offset);
-  void *p = mmap(NULL, size, PROT_READ, MAP_SHARED, mm->fd, mm->offset);
-  msync(p, size, MS_SYNC);
-  return p;
+  if (H5Ssel_gather_write(mem_space_id, mem_type_id, buf, mm->fd, mm->offset,
+                          mm->durability) < 0)
+    return NULL;
+  // the pages just written are read back through the page cache, they do
+  // not need to be synced for the flush to see them
+  return (char *)mm->buf + mm->offset;
+}
+
+/* sync the data of the write buffer to the storage */
+static herr_t H5LS_SSD_sync_write_mmap(MMAP *mm) {
+  return sync_file_data(mm->fd);
+}
+
+/* drop the pages of a flushed range of the write buffer from the mapping;
+ * only the pages entirely in the range are dropped, the data stays in the
+ * file */
+static herr_t H5LS_SSD_release_write_mmap(MMAP *mm, hsize_t offset,
+                                          hsize_t size) {
+  hsize_t page = sysconf(_SC_PAGESIZE);
+  hsize_t start = (offset + page - 1) / page * page;
+  hsize_t end = (offset + size) / page * page;
+  if (mm->buf == NULL || end <= start)
+    return SUCCEED;
+  return madvise((char *)mm->buf + start, end - start, MADV_DONTNEED) == 0
+             ? SUCCEED
+             : FAIL;
 }
 
 /* create read mmap buffer, files */
@@ -85,7 +195,10 @@ static herr_t H5LS_SSD_create_read_mmap(MMAP *mm, hsize_t size) {
   char tmp[255];
   strcpy(tmp, mm->fname);
   mkdirRecursive(dirname(tmp), 0755);
-  int fh = open(mm->fname, O_RDWR | O_CREAT | O_TRUNC,
+  // not truncated, so that a persistent cache left by a previous job can be
+  // adopted; the samples of an existing file are only trusted through the
+  // manifest of the cache
+  int fh = open(mm->fname, O_RDWR | O_CREAT,
                 S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
   char a = 'A';
   pwrite(fh, &a, 1, size);
@@ -106,6 +219,20 @@ static herr_t H5LS_SSD_remove_read_mmap(MMAP *mm, hsize_t size) {
   return 0;
 };
 
+/* map the read buffer of another process on the same node */
+static void *H5LS_SSD_attach_read_mmap(const char *fname, hsize_t size) {
+  int fd = open(fname, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+  void *buf = mmap(NULL, size, PROT_READ, MAP_SHARED | MAP_NORESERVE, fd, 0);
+  close(fd);
+  return (buf == MAP_FAILED) ? NULL : buf;
+}
+
+static herr_t H5LS_SSD_detach_read_mmap(void *buf, hsize_t size) {
+  return munmap(buf, size);
+}
+
 const H5LS_mmap_class_t H5LS_SSD_mmap_ext_g = {
     "SSD",
     H5LS_SSD_create_write_mmap,
@@ -114,4 +241,8 @@ const H5LS_mmap_class_t H5LS_SSD_mmap_ext_g = {
     H5LS_SSD_create_read_mmap,
     H5LS_SSD_remove_read_mmap,
     rmdirRecursive,
+    H5LS_SSD_attach_read_mmap,
+    H5LS_SSD_detach_read_mmap,
+    H5LS_SSD_sync_write_mmap,
+    H5LS_SSD_release_write_mmap,
 };
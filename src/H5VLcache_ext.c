@@ -18,7 +18,9 @@
 #include "debug.h"
 
 #include <assert.h>
+#include <stddef.h>
 #include <libgen.h>
+#include <limits.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -26,6 +28,8 @@
 
 /* Public HDF5 files */
 #include "hdf5.h"
+// global lock of the library, taken by the flush timer of the write cache
+#include "H5TSdevelop.h"
 
 /* Async VOL connector's header files */
 #include "h5_async_lib.h"
@@ -37,6 +41,7 @@
 #include "unistd.h"
 // POSIX I/O
 #include <fcntl.h>
+#include <pthread.h>
 
 // Memory map
 #include <sys/mman.h>
@@ -47,6 +52,7 @@
 // VOL related header
 #include "H5LS.h"
 #include "H5VLcache_ext_private.h"
+#include "cache_filter.h"
 #include "cache_new_h5api.h"
 #include "cache_utils.h"
 #include <dirent.h>
@@ -91,7 +97,26 @@
 #endif
 #endif
 
-#define PREFETCH_BLOCK_SIZE 1073741824
+// largest block read by the prefetch when the block size is tuned
+#define PREFETCH_BLOCK_MAX 1073741824
+// relative bandwidth gain for which the prefetch keeps tuning
+#define PREFETCH_TUNE_GAIN 1.05
+// largest contiguous block moved by a single entry of an RMA datatype
+#define RMA_MAX_BLOCK 1073741824
+// number of sequences fetched at a time from a selection iterator
+#define SEL_SEQ_BATCH 1024
+// number of raw chunks read per decoding thread before they are decoded
+#define DECODE_GROUP_SIZE 4
+// slots (int64_t) of the metadata of the read cache of a rank, after its
+// samples: the counter of the cached samples (used on rank 0), the number of
+// samples cached in the slice of the rank by the reads, and whether the rank
+// takes no more samples. The residency flags follow.
+#define META_CACHED_COUNTER 0
+#define META_PUT_COUNTER 1
+#define META_OWNER_FULL 2
+#define META_NSLOTS 3
+
+typedef enum { RMA_OP_GET, RMA_OP_PUT, RMA_OP_SWAP, RMA_OP_FETCH } rma_op_t;
 
 int RANK = 0;
 int NPROC = 1;
@@ -429,6 +454,11 @@ static herr_t read_data_from_local_storage(void *dset, hid_t mem_type_id,
                                            hid_t mem_space_id,
                                            hid_t file_space_id, hid_t plist_id,
                                            void *buf, void **req);
+static herr_t read_data_through_local_storage(void *dset, hid_t mem_type_id,
+                                              hid_t mem_space_id,
+                                              hid_t file_space_id,
+                                              hid_t plist_id, void *buf,
+                                              void **req);
 static herr_t flush_data_from_local_storage(void *current_request, void **req);
 static herr_t create_file_cache_on_global_storage(void *obj, void *file_args,
                                                   void **req);
@@ -465,6 +495,7 @@ static const H5LS_cache_io_class_t H5LS_cache_io_class_global_g = {
     write_data_to_global_storage,           // write_data_to_cache
     flush_data_from_global_storage,         // flush_data_from_cache
     read_data_from_global_storage,          // read_data_from_cache
+    NULL,                                   // read_data_through_cache
 };
 
 static const H5LS_cache_io_class_t H5LS_cache_io_class_local_g = {
@@ -481,6 +512,7 @@ static const H5LS_cache_io_class_t H5LS_cache_io_class_local_g = {
     write_data_to_local_storage2,
     flush_data_from_local_storage,
     read_data_from_local_storage,
+    read_data_through_local_storage,
 };
 
 static herr_t remove_cache(void *obj, void **req) {
@@ -646,6 +678,8 @@ static hid_t H5VL_CACHE_EXT_g = H5I_INVALID_HID;
  */
 
 static int H5VL_cache_dataset_prefetch_op_g = -1;
+static int H5VL_cache_dataset_prefetch_schedule_op_g = -1;
+static int H5VL_cache_dataset_prefetch_status_op_g = -1;
 static int H5VL_cache_dataset_read_to_cache_op_g = -1;
 static int H5VL_cache_dataset_read_from_cache_op_g = -1;
 static int H5VL_cache_dataset_mmap_remap_op_g = -1;
@@ -977,6 +1011,18 @@ static herr_t H5VL_cache_ext_init(hid_t vipl_id) {
                                  &H5VL_cache_dataset_prefetch_op_g) < 0)
     return (-1);
 
+  assert(-1 == H5VL_cache_dataset_prefetch_schedule_op_g);
+  if (H5VLregister_opt_operation(
+          H5VL_SUBCLS_DATASET, H5VL_CACHE_EXT_DYN_DPREFETCH_SCHEDULE,
+          &H5VL_cache_dataset_prefetch_schedule_op_g) < 0)
+    return (-1);
+
+  assert(-1 == H5VL_cache_dataset_prefetch_status_op_g);
+  if (H5VLregister_opt_operation(H5VL_SUBCLS_DATASET,
+                                 H5VL_CACHE_EXT_DYN_DPREFETCH_STATUS,
+                                 &H5VL_cache_dataset_prefetch_status_op_g) < 0)
+    return (-1);
+
   assert(-1 == H5VL_cache_dataset_read_from_cache_op_g);
   if (H5VLregister_opt_operation(H5VL_SUBCLS_DATASET,
                                  H5VL_CACHE_EXT_DYN_DREAD_FROM_CACHE,
@@ -1091,6 +1137,11 @@ static herr_t H5VL_cache_ext_term(void) {
   assert(-1 != H5VL_cache_dataset_prefetch_op_g);
   H5VL_cache_dataset_prefetch_op_g = (-1);
 
+  assert(-1 != H5VL_cache_dataset_prefetch_schedule_op_g);
+  H5VL_cache_dataset_prefetch_schedule_op_g = (-1);
+  assert(-1 != H5VL_cache_dataset_prefetch_status_op_g);
+  H5VL_cache_dataset_prefetch_status_op_g = (-1);
+
   assert(-1 != H5VL_cache_dataset_read_from_cache_op_g);
   H5VL_cache_dataset_read_from_cache_op_g = (-1);
 
@@ -1128,6 +1179,8 @@ static herr_t H5VL_cache_ext_term(void) {
   H5LS_stack_t *next;
   while (current->next != NULL) {
     next = current->next;
+    if (current->H5LS != NULL)
+      decode_pool_free(current->H5LS->decode_pool);
     free(current->H5LS);
     current->H5LS = NULL;
     free(current);
@@ -1434,6 +1487,30 @@ static herr_t H5VL_cache_ext_str_to_info(const char *str, void **_info) {
 
   LOG_INFO(-1, " replacement_policy: %d", (int)p->H5LS->replacement_policy);
 
+  LOG_INFO(-1, "           rma mode: %s",
+           p->H5LS->rma_mode == RMA_PASSIVE ? "PASSIVE" : "FENCE");
+
+  LOG_INFO(-1, "    read cache unit: %s",
+           p->H5LS->read_unit == READ_UNIT_CHUNK ? "CHUNK" : "SAMPLE");
+
+  LOG_INFO(-1, "     decode threads: %d", p->H5LS->decode_threads);
+
+  LOG_INFO(-1, "   read-ahead depth: %d", p->H5LS->read_ahead_depth);
+  LOG_INFO(-1, "   prefetch block size: %.2f MiB, in flight: %d, autotune: %d",
+           p->H5LS->prefetch_block_size / 1048576., p->H5LS->prefetch_inflight,
+           p->H5LS->prefetch_autotune);
+  LOG_INFO(-1, "   prefetch aggregators per node: %d",
+           p->H5LS->prefetch_aggregators);
+  LOG_INFO(-1, "   prefetch yields to demand reads: %d",
+           p->H5LS->prefetch_yield);
+  LOG_INFO(-1, "   flush of fused writes: max age %.2f s, idle %.2f s",
+           p->H5LS->flush_max_age, p->H5LS->flush_idle);
+  LOG_INFO(-1, "   write durability: %s",
+           p->H5LS->write_durability == DURABILITY_NONE
+               ? "NONE"
+               : (p->H5LS->write_durability == DURABILITY_TASK ? "TASK"
+                                                               : "CLOSE"));
+
   LOG_INFO(-1, "=============================");
 #endif
 
@@ -2006,369 +2083,2025 @@ static void *H5VL_cache_ext_dataset_create(void *obj,
   return (void *)dset;
 } /* end H5VL_cache_ext_dataset_create() */
 
-static herr_t H5VL_cache_ext_dataset_mmap_remap(void *obj) {
-  H5VL_cache_ext_t *dset = (H5VL_cache_ext_t *)obj;
-  // created a memory mapped file on the local storage. And create a MPI_win
-  hsize_t ss = round_page(dset->H5DRMM->dset.size);
-  if (strcmp(dset->H5LS->type, "MEMORY") != 0) {
-    // msync(dset->H5DRMM->mmap->buf, ss, MS_SYNC);
-    double t0 = MPI_Wtime();
-    munmap(dset->H5DRMM->mmap->buf, ss);
-#ifdef __linux__
-    posix_fadvise(dset->H5DRMM->mmap->fd, 0, ss, POSIX_FADV_DONTNEED);
-#endif
-    fsync(dset->H5DRMM->mmap->fd);
-    close(dset->H5DRMM->mmap->fd);
-    MPI_Win_free(&dset->H5DRMM->mpi->win);
-    double t1 = MPI_Wtime();
+static void read_cache_sync(H5VL_cache_ext_t *dset);
+
+/* extent of a chunk of the dataset (CHUNK read unit); the chunks on the
+ * edge of the dataset are clipped */
+static void get_chunk_extent(DSET *d, size_t chunk, hsize_t *start,
+                             hsize_t *count) {
+  int i;
+  for (i = d->ndims - 1; i >= 0; i--) {
+    start[i] = (chunk % d->nchunks[i]) * d->chunk_dims[i];
+    count[i] = d->dims[i] - start[i];
+    if (count[i] > d->chunk_dims[i])
+      count[i] = d->chunk_dims[i];
+    chunk /= d->nchunks[i];
+  }
+}
 
-    char tmp[252];
-    strcpy(tmp, dset->H5DRMM->mmap->fname);
-    strcat(dset->H5DRMM->mmap->fname, "p");
-    char cmd[300];
-    strcpy(cmd, "cp ");
-    strcat(cmd, tmp);
-    strcat(cmd, " ");
-    strcat(cmd, dset->H5DRMM->mmap->fname);
-    //    sprintf(cmd, "cp %s %s", tmp, dset->H5DRMM->mmap->fname);
-    system(cmd);
-    remove(tmp);
-    dset->H5DRMM->mmap->fd = open(dset->H5DRMM->mmap->fname, O_RDWR);
-    dset->H5DRMM->mmap->buf =
-        mmap(NULL, ss, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_NORESERVE,
-             dset->H5DRMM->mmap->fd, 0);
-    MPI_Win_create(dset->H5DRMM->mmap->buf, ss, dset->H5DRMM->dset.esize,
-                   MPI_INFO_NULL, dset->H5DRMM->mpi->comm,
-                   &dset->H5DRMM->mpi->win);
-    double t2 = MPI_Wtime();
+/* number of bytes of the dataset held by a sample (or a chunk) */
+static size_t get_sample_bytes(DSET *d, size_t sample) {
+  hsize_t start[H5S_MAX_RANK], count[H5S_MAX_RANK];
+  size_t nbytes = d->esize;
+  int i;
+  if (!d->chunked)
+    return d->sample.size;
+  get_chunk_extent(d, sample, start, count);
+  for (i = 0; i < d->ndims; i++)
+    nbytes *= count[i];
+  return nbytes;
+}
+
+/* sample (or chunk) that holds the element at coords, and the byte offset of
+ * the element in it; a chunk is stored with the full chunk extent */
+static void locate_element(DSET *d, const hsize_t *coords, size_t *sample,
+                           size_t *within) {
+  size_t c = 0, w = 0;
+  int i;
+  if (!d->chunked) {
+    for (i = 0; i < d->ndims; i++)
+      w = w * d->dims[i] + coords[i];
+    *sample = w / d->sample.nel;
+    *within = (w % d->sample.nel) * d->esize;
+    return;
   }
-  return SUCCEED;
+  for (i = 0; i < d->ndims; i++) {
+    c = c * d->nchunks[i] + coords[i] / d->chunk_dims[i];
+    w = w * d->chunk_dims[i] + coords[i] % d->chunk_dims[i];
+  }
+  *sample = c;
+  *within = w * d->esize;
 }
 
-static herr_t H5VL_cache_ext_dataset_prefetch_async(void *obj, hid_t fspace,
-                                                    hid_t plist_id,
-                                                    void *req_list) {
-#ifndef NDEBUG
-  LOG_INFO(-1, "VOL DATASET Prefetch async");
-#endif
-  H5VL_cache_ext_t *dset = (H5VL_cache_ext_t *)obj;
-  herr_t ret_value = SUCCEED;
-  if (dset->read_cache) {
-    int ndims = H5Sget_simple_extent_ndims(fspace);
-    int *samples = (int *)malloc(sizeof(int) * dset->H5DRMM->dset.ns_loc);
-    int nblock = 1;
-    int nsample_per_block = dset->H5DRMM->dset.ns_loc;
-    if (dset->H5DRMM->dset.size > PREFETCH_BLOCK_SIZE) {
-      nblock = dset->H5DRMM->dset.size / PREFETCH_BLOCK_SIZE;
-      nsample_per_block = dset->H5DRMM->dset.ns_loc / nblock;
-#ifndef NDEBUG
-      LOG_DEBUG(-1,
-                "**Split into %d (+1) block(s) to write the data "
-                "to cache storage",
-                nblock);
+/* like locate_element, for the element of linear index elem in the dataset;
+ * run is the number of elements from elem on that are contiguous both in
+ * the dataset and in the sample */
+static void locate_element_run(DSET *d, hsize_t elem, size_t *sample,
+                               size_t *within, size_t *run) {
+  hsize_t coords[H5S_MAX_RANK];
+  int i, last = d->ndims - 1;
+  if (!d->chunked) {
+    *sample = elem / d->sample.nel;
+    *within = (elem % d->sample.nel) * d->esize;
+    *run = d->sample.nel - elem % d->sample.nel;
+    return;
+  }
+  for (i = last; i >= 0; i--) {
+    coords[i] = elem % d->dims[i];
+    elem /= d->dims[i];
+  }
+  locate_element(d, coords, sample, within);
+  *run = d->chunk_dims[last] - coords[last] % d->chunk_dims[last];
+  if (*run > d->dims[last] - coords[last])
+    *run = d->dims[last] - coords[last];
+}
 
-#endif
-    }
-    int i;
-    for (i = 0; i < dset->H5DRMM->dset.ns_loc; i++)
-      samples[i] = dset->H5DRMM->dset.s_offset + i;
-#ifndef NDEBUG
+/* size of a chunk as stored in the file, 0 if it is not allocated */
+static herr_t get_chunk_storage_size(H5VL_cache_ext_t *dset,
+                                     const hsize_t *offset, hsize_t *size,
+                                     hid_t dxpl_id) {
+  H5VL_optional_args_t vol_cb_args;
+  H5VL_native_dataset_optional_args_t dset_opt_args;
 
-    LOG_DEBUG(-1, "Number of samples per proc: %ld; offset: %ld",
-              dset->H5DRMM->dset.ns_loc, dset->H5DRMM->dset.s_offset);
+  /* Set up VOL callback arguments */
+  memset(&dset_opt_args, 0, sizeof(dset_opt_args));
+  dset_opt_args.get_chunk_storage_size.offset = offset;
+  dset_opt_args.get_chunk_storage_size.size = size;
+  vol_cb_args.op_type = H5VL_NATIVE_DATASET_GET_CHUNK_STORAGE_SIZE;
+  vol_cb_args.args = &dset_opt_args;
+
+  return H5VLdataset_optional(dset->under_object, dset->under_vol_id,
+                              &vol_cb_args, dxpl_id, NULL);
+}
 
-#endif
-    char *p = (char *)dset->H5DRMM->mmap->buf;
-    request_list_t *r = req_list;
-    int n;
-    for (n = 0; n < nblock; n++) {
-      r = (request_list_t *)malloc(sizeof(request_list_t));
-      r->req = NULL;
-      r->next = NULL;
-      hid_t fs_cpy = H5Scopy(fspace);
-      set_hyperslab_from_samples(&samples[n * nsample_per_block],
-                                 nsample_per_block, &fs_cpy);
-      hsize_t *ldims = (hsize_t *)malloc(ndims * sizeof(hsize_t));
-      H5Sget_simple_extent_dims(fs_cpy, ldims, NULL);
-      ldims[0] = nsample_per_block;
-      hid_t mspace = H5Screate_simple(ndims, ldims, NULL);
-      hsize_t offset =
-          round_page(dset->H5DRMM->dset.sample.size * n * nsample_per_block);
-      free(ldims);
-      void *ptr = &p[offset];
-      ret_value = H5VLdataset_read(1, &dset->under_object, dset->under_vol_id,
-                                   &dset->H5DRMM->dset.h5_datatype, &mspace,
-                                   &fs_cpy, plist_id, &ptr, &r->req);
-      r = r->next;
-      H5Sclose(fs_cpy);
-    }
-    if (dset->H5DRMM->dset.ns_loc % nsample_per_block != 0) {
-      hid_t fs_cpy = H5Scopy(fspace);
-      r = (request_list_t *)malloc(sizeof(request_list_t));
-      r->req = NULL;
-      r->next = NULL;
-      set_hyperslab_from_samples(&samples[nblock * nsample_per_block],
-                                 dset->H5DRMM->dset.ns_loc % nsample_per_block,
-                                 &fs_cpy);
-      hsize_t *ldims = (hsize_t *)malloc(ndims * sizeof(hsize_t));
-      H5Sget_simple_extent_dims(fs_cpy, ldims, NULL);
-      ldims[0] = dset->H5DRMM->dset.ns_loc % nsample_per_block;
-      hid_t mspace = H5Screate_simple(ndims, ldims, NULL);
-      hsize_t offset = round_page(dset->H5DRMM->dset.sample.size * nblock *
-                                  nsample_per_block);
-      // We only assume prefetching on dataset, not multiple.
-      void *ptr = &p[offset];
-      ret_value = H5VLdataset_read(1, &dset->under_object, dset->under_vol_id,
-                                   &dset->H5DRMM->dset.h5_datatype, &mspace,
-                                   &fs_cpy, plist_id, (void **)&p, &r->req);
-      nblock = nblock + 1;
-      free(ldims);
-      H5Sclose(fs_cpy);
-    }
-    free(samples);
-  }
+/* read a chunk as stored in the file, without going through the filters */
+static herr_t read_raw_chunk(H5VL_cache_ext_t *dset, const hsize_t *offset,
+                             uint32_t *filter_mask, void *buf,
+                             hid_t dxpl_id) {
+  H5VL_optional_args_t vol_cb_args;
+  H5VL_native_dataset_optional_args_t dset_opt_args;
+  herr_t ret_value;
+
+  /* Set up VOL callback arguments */
+  memset(&dset_opt_args, 0, sizeof(dset_opt_args));
+  dset_opt_args.chunk_read.offset = offset;
+  dset_opt_args.chunk_read.buf = buf;
+  vol_cb_args.op_type = H5VL_NATIVE_DATASET_CHUNK_READ;
+  vol_cb_args.args = &dset_opt_args;
+
+  ret_value = H5VLdataset_optional(dset->under_object, dset->under_vol_id,
+                                   &vol_cb_args, dxpl_id, NULL);
+  *filter_mask = dset_opt_args.chunk_read.filters;
   return ret_value;
 }
 
 /*-------------------------------------------------------------------------
- * Function:    H5VL_cache_ext_dataset_open
+ * Function:    decode_raw_chunks
  *
- * Purpose:     Opens a dataset in a container
+ * Purpose:     Read chunks of a filtered dataset as they are stored in the
+ *              file and decode them with a pool of threads into their slots
+ *              in dst. decoded[i] tells whether chunk i is in place; the
+ *              chunks that are not allocated in the file or could not be
+ *              decoded have to be read through HDF5.
  *
- * Return:      Success:    Pointer to a dataset object
- *              Failure:    NULL
+ * Return:      Success:    0
+ *              Failure:    -1
  *
  *-------------------------------------------------------------------------
  */
-static void *H5VL_cache_ext_dataset_open(void *obj,
-                                         const H5VL_loc_params_t *loc_params,
-                                         const char *name, hid_t dapl_id,
-                                         hid_t dxpl_id, void **req) {
-  H5VL_cache_ext_t *dset;
-  H5VL_cache_ext_t *o = (H5VL_cache_ext_t *)obj;
-  void *under;
-
+static herr_t decode_raw_chunks(H5VL_cache_ext_t *dset, int *chunks, int n,
+                                char *dst, hid_t plist_id, bool *decoded) {
+  DSET *d = &dset->H5DRMM->dset;
+  DECODE_TASK *tasks = (DECODE_TASK *)malloc(sizeof(DECODE_TASK) * (n + 1));
+  int *index = (int *)malloc(sizeof(int) * (n + 1));
+  hsize_t start[H5S_MAX_RANK], count[H5S_MAX_RANK], nbytes;
+  int i, ntask = 0;
+  for (i = 0; i < n; i++) {
+    decoded[i] = false;
+    get_chunk_extent(d, chunks[i], start, count);
+    if (get_chunk_storage_size(dset, start, &nbytes, plist_id) < 0 ||
+        nbytes == 0)
+      continue;
+    DECODE_TASK *t = &tasks[ntask];
+    t->raw = malloc(nbytes);
+    t->raw_size = nbytes;
+    t->dst = dst + (size_t)i * d->sample.size;
+    t->dst_size = d->sample.size;
+    if (read_raw_chunk(dset, start, &t->filter_mask, t->raw, plist_id) < 0) {
+      free(t->raw);
+      continue;
+    }
+    index[ntask++] = i;
+  }
+  // the threads are started once, and kept for the next reads
+  if (dset->H5LS->decode_pool == NULL)
+    dset->H5LS->decode_pool = decode_pool_create(dset->H5LS->decode_threads);
+  decode_chunks(dset->H5LS->decode_pool, d->pipeline, tasks, ntask);
+  for (i = 0; i < ntask; i++) {
+    decoded[index[i]] = (tasks[i].ret >= 0);
+    free(tasks[i].raw);
+  }
 #ifndef NDEBUG
-  LOG_INFO(-1, "VOL DATASET Open");
+  LOG_DEBUG(-1, "decoded %d of %d chunk(s) with %d thread(s)", ntask, n,
+            dset->H5LS->decode_threads);
 #endif
+  free(index);
+  free(tasks);
+  return SUCCEED;
+}
 
-  under = H5VLdataset_open(o->under_object, loc_params, o->under_vol_id, name,
-                           dapl_id, dxpl_id, req);
-  if (under) {
-    dset = H5VL_cache_ext_new_obj(under, o->under_vol_id);
-    /* Inherit Cache information from obj */
-    dset->parent = obj;
-    dset->H5DWMM = o->H5DWMM;
-    dset->write_cache = o->write_cache;
-    dset->read_cache = o->read_cache;
-    dset->num_request_dataset = 0;
-    dset->H5DRMM = NULL;
-    dset->H5LS = o->H5LS;
-    dset->async_pause = o->async_pause;
-    /* setup read cache */
-    if (dset->read_cache || dset->write_cache) {
-      dset->es_id = H5EScreate();
-      dset_args_t *args = (dset_args_t *)malloc(sizeof(dset_args_t)); // freed
-      args->type_id = H5Tcopy(dataset_get_type(
-          dset->under_object, dset->under_vol_id, dxpl_id, NULL));
-      args->space_id = H5Scopy(dataset_get_space(
-          dset->under_object, dset->under_vol_id, dxpl_id, NULL));
-      args->dcpl_id = H5Pcopy(dataset_get_dcpl(
-          dset->under_object, dset->under_vol_id, dxpl_id, NULL));
-      args->lcpl_id = H5Pcreate(H5P_LINK_CREATE);
-      args->name = name;
-      args->loc_params = loc_params;
-      args->dapl_id = H5Pcopy(dapl_id);
-      args->dxpl_id = H5Pcopy(dxpl_id);
-      dset->obj_type = H5I_DATASET;
-      dset->H5LS->cache_io_cls->create_cache((void *)dset, (void *)args, req);
-      H5Pclose(args->lcpl_id);
-      H5Tclose(args->type_id);
-      H5Sclose(args->space_id);
-      H5Pclose(args->dcpl_id);
-      H5Pclose(args->dapl_id);
-      H5Pclose(args->dxpl_id);
-      free(args);
-      if (getenv("DATASET_PREFETCH_AT_OPEN")) {
-        if (dset->read_cache &&
-            !strcmp(getenv("DATASET_PREFETCH_AT_OPEN"), "yes")) {
-#ifndef NDEBUG
-          LOG_DEBUG(-1, "DATASET_PREFETCH_AT_OPEN = yes");
-#endif
-          H5VL_cache_ext_dataset_prefetch_async(dset, args->space_id, dxpl_id,
-                                                dset->prefetch_req);
-        }
-      }
-    }
-    /* Check for async request */
-    if (req && *req)
-      *req = H5VL_cache_ext_new_obj(*req, o->under_vol_id);
+/* copy of a dataset transfer property list for the reads of the cache from
+ * the file. Each rank makes these reads on its own (the ranks read different
+ * numbers of samples, or none at all), so they are independent even if the
+ * application asked for collective transfers. To be closed by the caller. */
+static hid_t get_independent_dxpl(hid_t plist_id) {
+  hid_t dxpl_id = H5Pcopy((plist_id == H5P_DEFAULT) ? H5P_DATASET_XFER_DEFAULT
+                                                    : plist_id);
+  H5Pset_dxpl_mpio(dxpl_id, H5FD_MPIO_INDEPENDENT);
+  return dxpl_id;
+}
 
-  } /* end if */
-  else
-    dset = NULL;
-  return (void *)dset;
-} /* end H5VL_cache_ext_dataset_open() */
+/*-------------------------------------------------------------------------
+ * Function:    read_samples_from_pfs
+ *
+ * Purpose:     Read whole samples of the dataset from the under VOL into
+ *              dst, back to back, with the layout they have in the cache.
+ *              In the CHUNK read unit, the chunks are read one at a time,
+ *              so that each read maps to a single chunk of the file; the
+ *              chunks on the edge of the dataset only fill the part of their
+ *              slot that is inside the dataset. If the chunks of the dataset
+ *              are decoded by the cache, they are read raw and decoded in
+ *              parallel instead, in groups to bound the memory used.
+ *
+ * Return:      Success:    0
+ *              Failure:    -1
+ *
+ *-------------------------------------------------------------------------
+ */
+static herr_t read_samples_from_pfs(H5VL_cache_ext_t *dset, int *samples,
+                                    int n, char *dst, hid_t type_id,
+                                    hid_t plist_id) {
+  DSET *d = &dset->H5DRMM->dset;
+  herr_t ret_value = SUCCEED;
+  hid_t fspace = H5Screate_simple(d->ndims, d->dims, NULL);
+  int i;
+  if (n == 0) {
+    H5Sclose(fspace);
+    return SUCCEED;
+  }
+  if (!d->chunked) {
+    hsize_t nel = n * d->sample.nel;
+    hid_t mspace = H5Screate_simple(1, &nel, NULL);
+    set_hyperslab_from_samples(samples, n, &fspace);
+    ret_value = H5VLdataset_read(1, &dset->under_object, dset->under_vol_id,
+                                 &type_id, &mspace, &fspace, plist_id,
+                                 (void **)&dst, NULL);
+    H5Sclose(mspace);
+    H5Sclose(fspace);
+    return ret_value;
+  }
+  hsize_t start[H5S_MAX_RANK], count[H5S_MAX_RANK], zero[H5S_MAX_RANK];
+  hid_t mspace = H5Screate_simple(d->ndims, d->chunk_dims, NULL);
+  // raw chunks are in the datatype of the file
+  bool raw = (d->pipeline != NULL && H5Tequal(type_id, d->h5_datatype) > 0);
+  int ngroup = DECODE_GROUP_SIZE * dset->H5LS->decode_threads;
+  bool *decoded = (bool *)malloc(sizeof(bool) * (ngroup + 1));
+  for (i = 0; i < d->ndims; i++)
+    zero[i] = 0;
+  for (i = 0; i < n && ret_value >= 0; i++) {
+    void *p = dst + (size_t)i * d->sample.size;
+    if (raw && i % ngroup == 0)
+      decode_raw_chunks(dset, &samples[i], (n - i < ngroup) ? n - i : ngroup,
+                        (char *)p, plist_id, decoded);
+    if (raw && decoded[i % ngroup])
+      continue;
+    get_chunk_extent(d, samples[i], start, count);
+    H5Sselect_hyperslab(fspace, H5S_SELECT_SET, start, NULL, count, NULL);
+    H5Sselect_hyperslab(mspace, H5S_SELECT_SET, zero, NULL, count, NULL);
+    ret_value = H5VLdataset_read(1, &dset->under_object, dset->under_vol_id,
+                                 &type_id, &mspace, &fspace, plist_id, &p,
+                                 NULL);
+  }
+  free(decoded);
+  H5Sclose(mspace);
+  H5Sclose(fspace);
+  return ret_value;
+}
 
-herr_t H5VL_cache_ext_dataset_prefetch_wait(void *dset) {
-  H5VL_cache_ext_t *o = (H5VL_cache_ext_t *)dset;
-  H5VL_request_status_t status;
-  request_list_t *r = o->prefetch_req;
-  while (r != NULL) {
-    H5VLrequest_wait(r->req, o->under_vol_id, INF, &status);
-    r = r->next;
+/* record the samples of a read in the access pattern of the dataset; returns
+ * whether the next reads can be predicted: a scan of consecutive samples is
+ * recognized after two reads, any other constant stride after three */
+static bool update_read_pattern(READ_AHEAD *ra, BATCH *b) {
+  if (b->size == 0)
+    return false;
+  int first = b->list[0];
+  if (ra->count == b->size && ra->stride != 0 &&
+      first - ra->first == ra->stride) {
+    ra->nmatch++;
+  } else {
+    ra->stride = (ra->count == b->size) ? first - ra->first : 0;
+    ra->nmatch = 0;
   }
-  hsize_t ss = round_page(o->H5DRMM->dset.size);
-  if (o->H5LS->path != NULL)
-    msync(o->H5DRMM->mmap->buf, ss, MS_SYNC);
-  o->H5DRMM->io->dset_cached = true;
-  o->H5DRMM->io->batch_cached = true;
-  return 0;
+  ra->first = first;
+  ra->count = b->size;
+  return ra->stride != 0 && (ra->nmatch > 0 || ra->stride == ra->count);
 }
-/*
-   Dataset prefetch function: currently, we prefetch the entire dataset into the
-   storage.
-*/
 
-static herr_t H5VL_cache_ext_dataset_prefetch(void *obj, hid_t fspace,
-                                              hid_t plist_id, void **req) {
-#ifndef NDEBUG
-  LOG_INFO(-1, "VOL DATASET Prefetch");
-#endif
-  H5VL_cache_ext_t *dset = (H5VL_cache_ext_t *)obj;
-  herr_t ret_value;
-  if (dset->read_cache) {
-    if (getenv("DATASET_PREFETCH_AT_OPEN")) {
-      if (dset->read_cache &&
-          !strcmp(getenv("DATASET_PREFETCH_AT_OPEN"), "yes")) {
-#ifndef NDEBUG
-        LOG_DEBUG(-1, "prefetched async called");
-#endif
-        return SUCCEED;
-      }
+/* wait for a list of background reads and free it; returns whether all the
+ * reads succeeded */
+static bool wait_requests(H5VL_cache_ext_t *dset, request_list_t **reqs) {
+  H5VL_request_status_t status;
+  bool ret_value = true;
+  while (*reqs != NULL) {
+    request_list_t *r = *reqs;
+    if (r->req != NULL) {
+      if (H5VLrequest_wait(r->req, dset->under_vol_id, INF, &status) < 0 ||
+          status != H5VL_REQUEST_STATUS_SUCCEED)
+        ret_value = false;
+      H5VLrequest_free(r->req, dset->under_vol_id);
     }
-    int ndims = H5Sget_simple_extent_ndims(fspace);
-    int *samples = (int *)malloc(sizeof(int) * dset->H5DRMM->dset.ns_loc);
-    int nblock = 1;
-    int nsample_per_block = dset->H5DRMM->dset.ns_loc;
-    if (dset->H5DRMM->dset.size > PREFETCH_BLOCK_SIZE) {
-      nblock = dset->H5DRMM->dset.size / PREFETCH_BLOCK_SIZE;
-      nsample_per_block = dset->H5DRMM->dset.ns_loc / nblock;
-#ifndef NDEBUG
-
-      LOG_DEBUG(-1,
-                "**Split into %d (+1) block(s) to write data to "
-                "the cache storage",
-                nblock);
+    *reqs = r->next;
+    free(r);
+  }
+  return ret_value;
+}
 
-#endif
-    }
-    int i;
-    for (i = 0; i < dset->H5DRMM->dset.ns_loc; i++)
-      samples[i] = dset->H5DRMM->dset.s_offset + i;
-#ifndef NDEBUG
+/* wait for the reads ahead in flight; on failure, the samples fetched ahead
+ * are dropped, and read again when they are needed */
+static void wait_read_ahead(H5VL_cache_ext_t *dset) {
+  READ_AHEAD *ra = &dset->H5DRMM->dset.ra;
+  if (!wait_requests(dset, &ra->reqs)) {
+    LOG_WARN(-1, "read-ahead failed; dropping %d sample(s)", ra->samples.size);
+    ra->samples.size = 0;
+  }
+}
 
-    LOG_DEBUG(-1, "Number of samples: %ld; offset: %ld",
-              dset->H5DRMM->dset.ns_loc, dset->H5DRMM->dset.s_offset);
+/* wait for the reads ahead in flight and free the samples fetched ahead */
+static void free_read_ahead(H5VL_cache_ext_t *dset) {
+  READ_AHEAD *ra = &dset->H5DRMM->dset.ra;
+  wait_read_ahead(dset);
+  free(ra->buf);
+  free(ra->samples.list);
+  ra->buf = NULL;
+  ra->samples.list = NULL;
+  ra->samples.size = 0;
+}
 
-#endif
-    char *p = (char *)dset->H5DRMM->mmap->buf;
-    int n;
-    for (n = 0; n < nblock; n++) {
-      hid_t fs_cpy = H5Scopy(fspace);
-      set_hyperslab_from_samples(&samples[n * nsample_per_block],
-                                 nsample_per_block, &fs_cpy);
-      hsize_t *ldims = (hsize_t *)malloc(ndims * sizeof(hsize_t));
-      H5Sget_simple_extent_dims(fs_cpy, ldims, NULL);
-      ldims[0] = nsample_per_block;
-      hid_t mspace = H5Screate_simple(ndims, ldims, NULL);
-      free(ldims);
-      hsize_t offset =
-          round_page(dset->H5DRMM->dset.sample.size * n * nsample_per_block);
-      void *ptr = &p[offset];
-      ret_value = H5VLdataset_read(1, dset->under_object, dset->under_vol_id,
-                                   &dset->H5DRMM->dset.h5_datatype, &mspace,
-                                   &fs_cpy, plist_id, &ptr, NULL);
-      H5Sclose(fs_cpy);
-    }
-    if (dset->H5DRMM->dset.ns_loc % nsample_per_block != 0) {
-      hid_t fs_cpy = H5Scopy(fspace);
-      set_hyperslab_from_samples(&samples[nblock * nsample_per_block],
-                                 dset->H5DRMM->dset.ns_loc % nsample_per_block,
-                                 &fs_cpy);
-      hsize_t *ldims = (hsize_t *)malloc(ndims * sizeof(hsize_t));
-      H5Sget_simple_extent_dims(fs_cpy, ldims, NULL);
-      ldims[0] = dset->H5DRMM->dset.ns_loc % nsample_per_block;
-      hid_t mspace = H5Screate_simple(ndims, ldims, NULL);
-      free(ldims);
-      hsize_t offset = round_page(dset->H5DRMM->dset.sample.size * nblock *
-                                  nsample_per_block);
-      void *ptr = &p[offset];
-      ret_value = H5VLdataset_read(1, &dset->under_object, dset->under_vol_id,
-                                   &dset->H5DRMM->dset.h5_datatype, &mspace,
-                                   &fs_cpy, plist_id, &ptr, NULL);
-      nblock = nblock + 1;
-      H5Sclose(fs_cpy);
-    }
-    if (ret_value == 0) {
-      hsize_t ss = round_page(dset->H5DRMM->dset.size);
-      if (dset->H5LS->path != NULL)
-        msync(dset->H5DRMM->mmap->buf, dset->H5DRMM->dset.size, MS_SYNC);
-      dset->H5DRMM->io->dset_cached = true;
-      dset->H5DRMM->io->batch_cached = true;
+/* read samples into their slots of buf in the background; the requests are
+ * appended to reqs (a request is NULL if the under VOL read synchronously) */
+static herr_t read_samples_async(H5VL_cache_ext_t *dset, int *samples,
+                                 int *slots, int n, char *buf,
+                                 hid_t plist_id, request_list_t **reqs) {
+  DSET *d = &dset->H5DRMM->dset;
+  herr_t ret_value = SUCCEED;
+  hsize_t start[H5S_MAX_RANK], count[H5S_MAX_RANK], zero[H5S_MAX_RANK];
+  hid_t fspace = H5Screate_simple(d->ndims, d->dims, NULL);
+  hid_t mspace;
+  int i;
+  if (n == 0) {
+    H5Sclose(fspace);
+    return SUCCEED;
+  }
+  if (!d->chunked) {
+    // the selections of the file and of the memory are both in increasing
+    // order of the samples, so that each sample lands in its slot; the
+    // memory is selected by runs of consecutive slots, a single block when
+    // the slots are back to back
+    hsize_t nel = (hsize_t)(slots[n - 1] + 1) * d->sample.nel;
+    int j;
+    mspace = H5Screate_simple(1, &nel, NULL);
+    H5Sselect_none(mspace);
+    for (i = 0; i < n; i = j) {
+      for (j = i + 1; j < n && slots[j] == slots[j - 1] + 1; j++)
+        ;
+      start[0] = (hsize_t)slots[i] * d->sample.nel;
+      count[0] = (hsize_t)(j - i) * d->sample.nel;
+      H5Sselect_hyperslab(mspace, H5S_SELECT_OR, start, NULL, count, NULL);
     }
-    free(samples);
+    set_hyperslab_from_samples(samples, n, &fspace);
+    request_list_t *r = (request_list_t *)malloc(sizeof(request_list_t));
+    r->req = NULL;
+    ret_value = H5VLdataset_read(1, &dset->under_object, dset->under_vol_id,
+                                 &d->h5_datatype, &mspace, &fspace, plist_id,
+                                 (void **)&buf, &r->req);
+    r->next = *reqs;
+    *reqs = r;
+    H5Sclose(mspace);
+    H5Sclose(fspace);
     return ret_value;
-  } else {
-#ifndef NDEBUG
-    LOG_WARN(-1, "HDF5_CACHE_RD is not set, doing nothing here for "
-                 "dataset_prefetch");
-#endif
-    return 0;
   }
+  mspace = H5Screate_simple(d->ndims, d->chunk_dims, NULL);
+  for (i = 0; i < d->ndims; i++)
+    zero[i] = 0;
+  for (i = 0; i < n && ret_value >= 0; i++) {
+    void *p = buf + (size_t)slots[i] * d->sample.size;
+    request_list_t *r = (request_list_t *)malloc(sizeof(request_list_t));
+    r->req = NULL;
+    get_chunk_extent(d, samples[i], start, count);
+    H5Sselect_hyperslab(fspace, H5S_SELECT_SET, start, NULL, count, NULL);
+    H5Sselect_hyperslab(mspace, H5S_SELECT_SET, zero, NULL, count, NULL);
+    ret_value = H5VLdataset_read(1, &dset->under_object, dset->under_vol_id,
+                                 &d->h5_datatype, &mspace, &fspace, plist_id,
+                                 &p, &r->req);
+    r->next = *reqs;
+    *reqs = r;
+  }
+  H5Sclose(mspace);
+  H5Sclose(fspace);
+  return ret_value;
 }
 
 /*-------------------------------------------------------------------------
- * Function:    H5VL_cache_ext_dataset_read_to_cache
+ * Function:    issue_read_ahead
  *
- * Purpose:     Reads data elements from a dataset into a buffer and stores
- *              a copy to the local storage
+ * Purpose:     Fetch in the background the samples of the next reads of
+ *              the dataset, predicted from the samples b of the current
+ *              read and the stride of the pattern. Up to read_ahead_depth
+ *              reads are predicted. The samples already fetched ahead that
+ *              are still predicted are kept; the others are dropped.
  *
  * Return:      Success:    0
  *              Failure:    -1
  *
  *-------------------------------------------------------------------------
  */
+static herr_t issue_read_ahead(H5VL_cache_ext_t *dset, BATCH *b,
+                               hid_t plist_id) {
+  DSET *d = &dset->H5DRMM->dset;
+  READ_AHEAD *ra = &d->ra;
+  size_t ss = d->sample.size;
+  int depth = dset->H5LS->read_ahead_depth;
+  int i, j, k, n = 0, nfetch = 0;
+  BATCH next;
+  next.list = (int *)malloc(sizeof(int) * ((size_t)depth * b->size + 1));
+  for (k = 1; k <= depth; k++)
+    for (i = 0; i < b->size; i++) {
+      long s = (long)b->list[i] + (long)k * ra->stride;
+      if (s >= 0 && s < (long)d->ns_glob &&
+          find_sample(b->list, b->size, (int)s) < 0)
+        next.list[n++] = (int)s;
+    }
+  next.size = sort_unique_samples(next.list, n);
+  char *buf = (char *)malloc((size_t)next.size * ss + 1);
+  int *fetch = (int *)malloc(sizeof(int) * (next.size + 1));
+  int *slots = (int *)malloc(sizeof(int) * (next.size + 1));
+  for (i = 0; i < next.size; i++) {
+    j = find_sample(ra->samples.list, ra->samples.size, next.list[i]);
+    if (j >= 0) {
+      memcpy(buf + (size_t)i * ss, ra->buf + (size_t)j * ss, ss);
+    } else {
+      fetch[nfetch] = next.list[i];
+      slots[nfetch++] = i;
+    }
+  }
+  free(ra->buf);
+  free(ra->samples.list);
+  ra->buf = buf;
+  ra->samples = next;
+#ifndef NDEBUG
+  LOG_DEBUG(-1, "read-ahead of %d sample(s) (stride %d), %d to fetch",
+            next.size, ra->stride, nfetch);
+#endif
+  herr_t ret_value = read_samples_async(dset, fetch, slots, nfetch, buf,
+                                        plist_id, &ra->reqs);
+  free(fetch);
+  free(slots);
+  return ret_value;
+}
 
-static herr_t H5VL_cache_ext_dataset_read_to_cache(
-    size_t count, void *dset[], hid_t mem_type_id[], hid_t mem_space_id[],
-    hid_t file_space_id[], hid_t plist_id, void *buf[], void **req) {
-  void *obj_local;
-  void **obj = &obj_local;
-  size_t i;
-  herr_t ret_value;
-
-#ifndef NDEBUG
-  LOG_INFO(-1, "VOL DATASET Read to cache");
-#endif
-  if (count > 1)
-    if (NULL == (obj = (void **)malloc(count * sizeof(void *))))
-      return -1;
-  // get the under vol object from all the dataset
-  for (i = 0; i < count; i++) {
-    obj[i] = ((H5VL_cache_ext_t *)dset[i])->under_object;
-    if (((H5VL_cache_ext_t *)dset[i])->under_vol_id !=
-        ((H5VL_cache_ext_t *)dset[0])->under_vol_id)
-      return -1;
+/* cache units holding a list of samples (slices along the first dimension),
+ * sorted: the samples themselves, or in the CHUNK unit, all the chunks that
+ * the samples cross */
+static void get_batch_units(DSET *d, const int *samples, size_t n, BATCH *b) {
+  size_t per = 1, i, j, k = 0;
+  int dim;
+  if (d->chunked)
+    for (dim = 1; dim < d->ndims; dim++)
+      per *= d->nchunks[dim];
+  b->list = (int *)malloc(sizeof(int) * (n * per + 1));
+  for (i = 0; i < n; i++) {
+    if (!d->chunked) {
+      b->list[k++] = samples[i];
+      continue;
+    }
+    size_t c0 = samples[i] / d->chunk_dims[0];
+    for (j = 0; j < per; j++)
+      b->list[k++] = c0 * per + j;
   }
+  b->size = sort_unique_samples(b->list, k);
+}
 
-  // calling the under H5VLdataset_read
-  ret_value = H5VLdataset_read(
-      count, obj, ((H5VL_cache_ext_t *)dset[0])->under_vol_id, mem_type_id,
-      mem_space_id, file_space_id, plist_id, buf, NULL);
-  /* Saving the read buffer(s) to local storage */
-  if (((H5VL_cache_ext_t *)dset[0])->read_cache)
-    for (i = 0; i < count; i++)
+/* stage the next batch of the schedule into its buffer of the ring */
+static herr_t stage_next_batch(H5VL_cache_ext_t *dset) {
+  DSET *d = &dset->H5DRMM->dset;
+  PREFETCH_SCHEDULE *s = d->schedule;
+  size_t first = s->tail * s->batch_size, n = s->batch_size;
+  int k = s->tail % s->depth, i;
+  if (first + n > s->n)
+    n = s->n - first;
+  get_batch_units(d, &s->indices[first], n, &s->slots[k]);
+  s->bufs[k] = (char *)malloc((size_t)s->slots[k].size * d->sample.size + 1);
+  int *pos = (int *)malloc(sizeof(int) * (s->slots[k].size + 1));
+  for (i = 0; i < s->slots[k].size; i++)
+    pos[i] = i;
+#ifndef NDEBUG
+  LOG_DEBUG(-1, "staging batch %zu of %zu (%d sample(s))", s->tail,
+            s->nbatch, s->slots[k].size);
+#endif
+  herr_t ret_value =
+      read_samples_async(dset, s->slots[k].list, pos, s->slots[k].size,
+                         s->bufs[k], s->dxpl_id, &s->reqs[k]);
+  free(pos);
+  s->tail++;
+  return ret_value;
+}
+
+/* release the buffer of the oldest batch of the ring */
+static void release_oldest_batch(H5VL_cache_ext_t *dset) {
+  PREFETCH_SCHEDULE *s = dset->H5DRMM->dset.schedule;
+  int k = s->head % s->depth;
+  wait_requests(dset, &s->reqs[k]);
+  free(s->bufs[k]);
+  free(s->slots[k].list);
+  s->bufs[k] = NULL;
+  s->slots[k].list = NULL;
+  s->slots[k].size = 0;
+  s->head++;
+}
+
+/* stage batches until the ring is full or the schedule is exhausted */
+static void refill_prefetch_schedule(H5VL_cache_ext_t *dset) {
+  PREFETCH_SCHEDULE *s = dset->H5DRMM->dset.schedule;
+  while (s != NULL && s->tail < s->nbatch && s->tail < s->head + s->depth)
+    stage_next_batch(dset);
+}
+
+/* wait for the staged batches and free the schedule of a dataset */
+static void free_prefetch_schedule(H5VL_cache_ext_t *dset) {
+  PREFETCH_SCHEDULE *s = dset->H5DRMM->dset.schedule;
+  if (s == NULL)
+    return;
+  while (s->head < s->tail)
+    release_oldest_batch(dset);
+  H5Pclose(s->dxpl_id);
+  free(s->indices);
+  free(s->slots);
+  free(s->bufs);
+  free(s->reqs);
+  free(s);
+  dset->H5DRMM->dset.schedule = NULL;
+}
+
+/* a read has touched the samples b: the batches of the ring older than the
+ * latest batch that the read touched have been consumed */
+static void advance_prefetch_schedule(H5VL_cache_ext_t *dset, BATCH *b) {
+  PREFETCH_SCHEDULE *s = dset->H5DRMM->dset.schedule;
+  size_t t, last = 0;
+  bool found = false;
+  int i;
+  if (s == NULL)
+    return;
+  for (t = s->head; t < s->tail; t++) {
+    BATCH *slot = &s->slots[t % s->depth];
+    for (i = 0; i < b->size; i++)
+      if (find_sample(slot->list, slot->size, b->list[i]) >= 0) {
+        last = t;
+        found = true;
+        break;
+      }
+  }
+  while (found && s->head < last)
+    release_oldest_batch(dset);
+}
+
+/* staged copy of a sample, fetched ahead or staged by the schedule; NULL if
+ * the sample is not staged */
+static char *get_staged_sample(H5VL_cache_ext_t *dset, int sample) {
+  DSET *d = &dset->H5DRMM->dset;
+  PREFETCH_SCHEDULE *s = d->schedule;
+  size_t t;
+  int j = find_sample(d->ra.samples.list, d->ra.samples.size, sample);
+  if (j >= 0)
+    return d->ra.buf + (size_t)j * d->sample.size;
+  if (s == NULL)
+    return NULL;
+  for (t = s->head; t < s->tail; t++) {
+    int k = t % s->depth;
+    j = find_sample(s->slots[k].list, s->slots[k].size, sample);
+    if (j < 0)
+      continue;
+    if (!wait_requests(dset, &s->reqs[k])) {
+      LOG_WARN(-1, "staging of batch %zu failed", t);
+      s->slots[k].size = 0;
+      continue;
+    }
+    return s->bufs[k] + (size_t)j * d->sample.size;
+  }
+  return NULL;
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    H5VL_cache_ext_dataset_prefetch_schedule
+ *
+ * Purpose:     Register the samples that the calling rank will read next,
+ *              in the order of the reads, in batches of batch_size samples.
+ *              The batches are staged in a ring of schedule_depth buffers:
+ *              when a read touches a batch, the older batches are released
+ *              and the next batches of the schedule are staged in the
+ *              background, so that the samples that are not cached yet are
+ *              never read from the file system on the read path. A new
+ *              schedule replaces the previous one.
+ *
+ * Return:      Success:    0
+ *              Failure:    -1
+ *
+ *-------------------------------------------------------------------------
+ */
+static herr_t H5VL_cache_ext_dataset_prefetch_schedule(void *obj,
+                                                       const hsize_t *indices,
+                                                       size_t n,
+                                                       size_t batch_size,
+                                                       hid_t dxpl_id) {
+  H5VL_cache_ext_t *dset = (H5VL_cache_ext_t *)obj;
+  size_t i;
+#ifndef NDEBUG
+  LOG_INFO(-1, "VOL DATASET Prefetch schedule");
+#endif
+  if (!dset->read_cache || !strcmp(dset->H5LS->scope, "GLOBAL"))
+    return SUCCEED;
+  DSET *d = &dset->H5DRMM->dset;
+  if (batch_size == 0) {
+    LOG_ERROR(-1, "the batch size of a prefetch schedule must be positive");
+    return FAIL;
+  }
+  // the cache indexes the samples with int, larger indices are not taken
+  for (i = 0; i < n; i++)
+    if (indices[i] >= d->dims[0] || indices[i] > INT_MAX) {
+      LOG_ERROR(-1, "sample %llu of the prefetch schedule is out of range",
+                (unsigned long long)indices[i]);
+      return FAIL;
+    }
+  free_prefetch_schedule(dset);
+  if (n == 0 || dset->H5DRMM->io->dset_cached)
+    return SUCCEED;
+  PREFETCH_SCHEDULE *s =
+      (PREFETCH_SCHEDULE *)malloc(sizeof(PREFETCH_SCHEDULE));
+  s->indices = (int *)malloc(sizeof(int) * n);
+  for (i = 0; i < n; i++)
+    s->indices[i] = indices[i];
+  s->n = n;
+  s->batch_size = batch_size;
+  s->nbatch = (n + batch_size - 1) / batch_size;
+  s->head = 0;
+  s->tail = 0;
+  s->depth = dset->H5LS->schedule_depth;
+  s->slots = (BATCH *)calloc(s->depth, sizeof(BATCH));
+  s->bufs = (char **)calloc(s->depth, sizeof(char *));
+  s->reqs = (request_list_t **)calloc(s->depth, sizeof(request_list_t *));
+  s->dxpl_id = get_independent_dxpl(dxpl_id);
+  d->schedule = s;
+  refill_prefetch_schedule(dset);
+  return SUCCEED;
+}
+
+/* layout of the read cache window of a rank: its samples, followed by the
+ * cache metadata, i.e., the counter of the samples cached by all the ranks
+ * (only used on rank 0) and one residency flag per sample of the rank. */
+static void get_read_cache_layout(io_handler_t *dmm, int rank,
+                                  hsize_t *meta_offset, hsize_t *win_size) {
+  size_t ns, start;
+  parallel_dist(dmm->dset.ns_glob, dmm->mpi->nproc, rank, &ns, &start);
+  *meta_offset = round_page(ns * dmm->dset.sample.size);
+  *win_size = *meta_offset + META_NSLOTS * sizeof(int64_t) + ns;
+}
+
+/* offset of a slot of the cache metadata in the window of a rank */
+static MPI_Aint meta_slot_disp(io_handler_t *dmm, int rank, int slot) {
+  hsize_t meta_offset, win_size;
+  get_read_cache_layout(dmm, rank, &meta_offset, &win_size);
+  return meta_offset + slot * sizeof(int64_t);
+}
+
+/* offset of the counter of the cached samples in the window of rank 0 */
+static MPI_Aint cached_counter_disp(io_handler_t *dmm) {
+  return meta_slot_disp(dmm, 0, META_CACHED_COUNTER);
+}
+
+/* residency flags of the samples of the calling rank */
+static unsigned char *get_residency_flags(io_handler_t *dmm) {
+  return (unsigned char *)dmm->mmap->buf + dmm->dset.meta_offset +
+         META_NSLOTS * sizeof(int64_t);
+}
+
+/* claim the space of n more samples of the calling rank in the cache
+ * storage. On the SSD, the space of the read cache is claimed as the
+ * samples are cached rather than for the whole slice of the rank at
+ * creation, so that a dataset that is only partially read (or prefetched)
+ * holds the space of the samples it caches only; the node memory is
+ * allocated, and claimed, as a whole at creation. Like at creation, the
+ * ranks of a node are assumed to claim alike. */
+static herr_t claim_read_cache_space(H5VL_cache_ext_t *dset, int64_t n) {
+  io_handler_t *dmm = dset->H5DRMM;
+  if (n > (int64_t)dmm->dset.ns_loc - dmm->dset.ns_claimed)
+    n = (int64_t)dmm->dset.ns_loc - dmm->dset.ns_claimed;
+  if (n <= 0)
+    return SUCCEED;
+  hsize_t size = n * dmm->dset.sample.size * dmm->mpi->ppn;
+  if (H5LSclaim_space(dset->H5LS, size, HARD,
+                      dset->H5LS->replacement_policy) < 0)
+    return FAIL;
+  dmm->cache->mspace_total += size;
+  dmm->cache->mspace_per_rank_left -= n * dmm->dset.sample.size;
+  dmm->dset.ns_claimed += n;
+  return SUCCEED;
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    count_cached_samples
+ *
+ * Purpose:     Record that n samples were newly cached by the calling rank.
+ *              In the PASSIVE mode the global counter on rank 0 is updated
+ *              right away. In the FENCE mode, the update is deferred to the
+ *              next access epoch (see send_cached_sample_count) so that the
+ *              counter is only read in epochs where nobody updates it, and
+ *              all the ranks agree on whether the dataset is fully cached.
+ *
+ * Return:      Success:    0
+ *              Failure:    -1
+ *
+ *-------------------------------------------------------------------------
+ */
+static herr_t count_cached_samples(H5VL_cache_ext_t *dset, int64_t n) {
+  io_handler_t *dmm = dset->H5DRMM;
+  if (n == 0)
+    return SUCCEED;
+  dmm->dset.ns_cached += n;
+  if (dset->H5LS->rma_mode == RMA_PASSIVE) {
+    int64_t total;
+    MPI_Fetch_and_op(&n, &total, MPI_INT64_T, 0, cached_counter_disp(dmm),
+                     MPI_SUM, dmm->mpi->win);
+    MPI_Win_flush(0, dmm->mpi->win);
+    if (total + n >= dmm->dset.ns_glob)
+      dmm->io->dset_cached = true;
+  } else {
+    dmm->dset.ns_pending += n;
+  }
+  return SUCCEED;
+}
+
+/* add the samples newly cached by the calling rank to the counters of
+ * their owners, which claim their space (see claim_put_samples_space) */
+static void send_put_sample_counts(H5VL_cache_ext_t *dset) {
+  io_handler_t *dmm = dset->H5DRMM;
+  int r;
+  for (r = 0; r < dmm->mpi->nproc; r++) {
+    dmm->dset.put_sent[r] = dmm->dset.put_pending[r];
+    dmm->dset.put_pending[r] = 0;
+    if (dmm->dset.put_sent[r] > 0)
+      MPI_Accumulate(&dmm->dset.put_sent[r], 1, MPI_INT64_T, r,
+                     meta_slot_disp(dmm, r, META_PUT_COUNTER), 1, MPI_INT64_T,
+                     MPI_SUM, dmm->mpi->win);
+  }
+}
+
+/* FENCE mode: add the pending count to the global counter, and the pending
+ * counts of the owners to theirs; to be called at the beginning of an epoch
+ * in which the counters are not read */
+static void send_cached_sample_count(H5VL_cache_ext_t *dset) {
+  io_handler_t *dmm = dset->H5DRMM;
+  if (dset->H5LS->rma_mode != RMA_FENCE || dmm->dset.ns_pending == 0)
+    return;
+  dmm->dset.ns_sent = dmm->dset.ns_pending;
+  dmm->dset.ns_pending = 0;
+  MPI_Accumulate(&dmm->dset.ns_sent, 1, MPI_INT64_T, 0,
+                 cached_counter_disp(dmm), 1, MPI_INT64_T, MPI_SUM,
+                 dmm->mpi->win);
+  send_put_sample_counts(dset);
+}
+
+/* record the samples of b newly cached by the calling rank (whose flags
+ * were not set before, see put_samples_to_cache) for their owners. In the
+ * PASSIVE mode the counters of the owners are updated right away; in the
+ * FENCE mode, with the global counter, in the next epoch. */
+static void count_put_samples(H5VL_cache_ext_t *dset, BATCH *b,
+                              unsigned char *flags) {
+  io_handler_t *dmm = dset->H5DRMM;
+  size_t local;
+  int i, r;
+  for (i = 0; i < b->size; i++) {
+    if (flags[b->size + i] != 0)
+      continue;
+    get_sample_owner(dmm->dset.ns_glob, dmm->mpi->nproc, b->list[i], &r,
+                     &local);
+    dmm->dset.put_pending[r]++;
+  }
+  if (dset->H5LS->rma_mode == RMA_PASSIVE) {
+    send_put_sample_counts(dset);
+    MPI_Win_flush_all(dmm->mpi->win);
+  }
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    claim_put_samples_space
+ *
+ * Purpose:     Claim the space of the samples that the reads (of all the
+ *              ranks) cached in the slice of the calling rank since the
+ *              last call. The space is claimed by the owner of the samples,
+ *              in the cache storage of its node, rather than by the rank
+ *              that stores them. If the storage is full, even after
+ *              eviction, the rank takes no more samples: the other ranks
+ *              learn it when they fetch its state (see fetch_owner_state)
+ *              and read its samples from the file instead. In the FENCE
+ *              mode, this has to be called outside of the epochs.
+ *
+ * Return:      Success:    0
+ *              Failure:    -1
+ *
+ *-------------------------------------------------------------------------
+ */
+static herr_t claim_put_samples_space(H5VL_cache_ext_t *dset) {
+  io_handler_t *dmm = dset->H5DRMM;
+  int rank = dmm->mpi->rank;
+  int64_t nput, full = 1;
+  if (dset->H5LS->rma_mode == RMA_PASSIVE) {
+    MPI_Fetch_and_op(NULL, &nput, MPI_INT64_T, rank,
+                     meta_slot_disp(dmm, rank, META_PUT_COUNTER), MPI_NO_OP,
+                     dmm->mpi->win);
+    MPI_Win_flush(rank, dmm->mpi->win);
+  } else {
+    nput = *(int64_t *)((char *)dmm->mmap->buf + dmm->dset.meta_offset +
+                        META_PUT_COUNTER * sizeof(int64_t));
+  }
+  if (nput <= dmm->dset.ns_put_claimed)
+    return SUCCEED;
+  if (claim_read_cache_space(dset, nput - dmm->dset.ns_put_claimed) >= 0) {
+    dmm->dset.ns_put_claimed = nput;
+    return SUCCEED;
+  }
+  LOG_WARN(-1, "cache storage is full; no more samples are cached by rank %d",
+           rank);
+  dmm->dset.ns_put_claimed = nput;
+  if (dset->H5LS->rma_mode == RMA_PASSIVE) {
+    MPI_Accumulate(&full, 1, MPI_INT64_T, rank,
+                   meta_slot_disp(dmm, rank, META_OWNER_FULL), 1, MPI_INT64_T,
+                   MPI_REPLACE, dmm->mpi->win);
+    MPI_Win_flush(rank, dmm->mpi->win);
+  } else {
+    *(int64_t *)((char *)dmm->mmap->buf + dmm->dset.meta_offset +
+                 META_OWNER_FULL * sizeof(int64_t)) = full;
+  }
+  return FAIL;
+}
+
+/* fetch the state of the owners of the samples of b (sorted) into
+ * owner_full, so that no samples are stored to the ranks whose cache
+ * storage is full. Has to be called inside an access epoch; the state is
+ * available once the operations are completed locally. */
+static void fetch_owner_state(H5VL_cache_ext_t *dset, BATCH *b) {
+  io_handler_t *dmm = dset->H5DRMM;
+  size_t local;
+  int i, r, last = -1;
+  for (i = 0; i < b->size; i++) {
+    get_sample_owner(dmm->dset.ns_glob, dmm->mpi->nproc, b->list[i], &r,
+                     &local);
+    if (r == last)
+      continue;
+    last = r;
+    if (dset->H5LS->rma_mode == RMA_PASSIVE)
+      MPI_Fetch_and_op(NULL, &dmm->dset.owner_full[r], MPI_INT64_T, r,
+                       meta_slot_disp(dmm, r, META_OWNER_FULL), MPI_NO_OP,
+                       dmm->mpi->win);
+    else
+      MPI_Get(&dmm->dset.owner_full[r], 1, MPI_INT64_T, r,
+              meta_slot_disp(dmm, r, META_OWNER_FULL), 1, MPI_INT64_T,
+              dmm->mpi->win);
+  }
+}
+
+/* drop the samples of the owners whose cache storage is full (as last
+ * fetched) from b and from the segments of its samples; return the number
+ * of segments left */
+static size_t drop_full_owners(H5VL_cache_ext_t *dset, RMA_SEG *segs,
+                               size_t nseg, BATCH *b) {
+  io_handler_t *dmm = dset->H5DRMM;
+  size_t i, n = 0, local;
+  int j, m = 0, r;
+  for (i = 0; i < nseg; i++)
+    if (!dmm->dset.owner_full[segs[i].rank])
+      segs[n++] = segs[i];
+  for (j = 0; j < b->size; j++) {
+    get_sample_owner(dmm->dset.ns_glob, dmm->mpi->nproc, b->list[j], &r,
+                     &local);
+    if (!dmm->dset.owner_full[r])
+      b->list[m++] = b->list[j];
+  }
+  b->size = m;
+  return n;
+}
+
+static size_t get_residency_segments(io_handler_t *dmm, BATCH *b,
+                                     RMA_SEG **segs);
+static herr_t rma_segments(io_handler_t *dmm, RMA_SEG *segs, size_t nseg,
+                           char *buf, char *result, rma_op_t op);
+static int64_t count_new_samples(unsigned char *flags, int n);
+
+/* mark n samples of the calling rank, given by their (global) index, as
+ * resident after they have been stored directly into the local cache. In
+ * the PASSIVE mode, the other ranks swap the flags atomically at any time
+ * (see put_samples_to_cache), so they are set the same way; in the FENCE
+ * mode, this is called outside of the epochs and the flags are stored
+ * directly. */
+static herr_t mark_sample_list_resident(H5VL_cache_ext_t *dset,
+                                        const int *samples, size_t n) {
+  io_handler_t *dmm = dset->H5DRMM;
+  size_t s_offset = dmm->dset.s_offset;
+  int64_t nnew = 0;
+  size_t i;
+  if (n == 0)
+    return SUCCEED;
+  // the data has to be visible before the flags are set
+  read_cache_sync(dset);
+  if (dset->H5LS->rma_mode == RMA_PASSIVE) {
+    unsigned char *flags = (unsigned char *)malloc(2 * n);
+    BATCH b;
+    RMA_SEG *segs;
+    b.list = (int *)samples;
+    b.size = n;
+    memset(flags, 1, 2 * n);
+    size_t nr = get_residency_segments(dmm, &b, &segs);
+    nr = unique_rma_segments(segs, nr);
+    rma_segments(dmm, segs, nr, (char *)flags, (char *)&flags[n],
+                 RMA_OP_SWAP);
+    MPI_Win_flush(dmm->mpi->rank, dmm->mpi->win);
+    nnew = count_new_samples(flags, n);
+    free(segs);
+    free(flags);
+  } else {
+    unsigned char *flags = get_residency_flags(dmm);
+    for (i = 0; i < n; i++) {
+      nnew += (flags[samples[i] - s_offset] == 0);
+      flags[samples[i] - s_offset] = 1;
+    }
+  }
+  return count_cached_samples(dset, nnew);
+}
+
+/* copy of the residency flags of the samples of the calling rank, to be
+ * freed by the caller. In the PASSIVE mode, the other ranks swap the flags
+ * atomically at any time, so they are fetched atomically as well. */
+static unsigned char *get_local_residency_flags(H5VL_cache_ext_t *dset) {
+  io_handler_t *dmm = dset->H5DRMM;
+  size_t n = dmm->dset.ns_loc;
+  unsigned char *flags = (unsigned char *)malloc(n + 1);
+  if (dset->H5LS->rma_mode == RMA_PASSIVE && n > 0) {
+    MPI_Get_accumulate(NULL, 0, MPI_UNSIGNED_CHAR, flags, n,
+                       MPI_UNSIGNED_CHAR, dmm->mpi->rank,
+                       dmm->dset.meta_offset + META_NSLOTS * sizeof(int64_t),
+                       n,
+                       MPI_UNSIGNED_CHAR, MPI_NO_OP, dmm->mpi->win);
+    MPI_Win_flush_local(dmm->mpi->rank, dmm->mpi->win);
+  } else {
+    memcpy(flags, get_residency_flags(dmm), n);
+  }
+  return flags;
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    get_prefetch_samples
+ *
+ * Purpose:     Get the samples (or chunks) of the calling rank touched by
+ *              the selection fspace of a prefetch and not cached yet, in
+ *              increasing order. H5S_ALL selects the whole dataset. The
+ *              list is allocated and has to be freed by the caller.
+ *
+ * Return:      Number of samples of the list
+ *
+ *-------------------------------------------------------------------------
+ */
+static size_t get_prefetch_samples(H5VL_cache_ext_t *dset, hid_t fspace,
+                                   int **samples) {
+  DSET *d = &dset->H5DRMM->dset;
+  hsize_t start[H5S_MAX_RANK], count[H5S_MAX_RANK], end[H5S_MAX_RANK];
+  hsize_t lo[H5S_MAX_RANK], hi[H5S_MAX_RANK];
+  bool all = fspace == H5S_ALL || H5Sget_select_type(fspace) == H5S_SEL_ALL;
+  size_t i, n = 0;
+  int k;
+  *samples = (int *)malloc(sizeof(int) * (d->ns_loc + 1));
+  if (!all && (H5Sget_select_npoints(fspace) <= 0 ||
+               H5Sget_select_bounds(fspace, lo, hi) < 0))
+    return 0;
+  unsigned char *flags = get_local_residency_flags(dset);
+  for (i = 0; i < d->ns_loc; i++) {
+    if (flags[i])
+      continue;
+    if (!all) {
+      if (d->chunked) {
+        get_chunk_extent(d, d->s_offset + i, start, count);
+      } else {
+        start[0] = d->s_offset + i;
+        count[0] = 1;
+        for (k = 1; k < d->ndims; k++) {
+          start[k] = 0;
+          count[k] = d->dims[k];
+        }
+      }
+      // the bounding box of the selection rules out most samples cheaply
+      for (k = 0; k < d->ndims; k++) {
+        end[k] = start[k] + count[k] - 1;
+        if (end[k] < lo[k] || start[k] > hi[k])
+          break;
+      }
+      if (k < d->ndims || H5Sselect_intersect_block(fspace, start, end) <= 0)
+        continue;
+    }
+    (*samples)[n++] = d->s_offset + i;
+  }
+  free(flags);
+  return n;
+}
+
+/* range [lo, hi) of the merged list of a node read by an aggregator in a
+ * round; the list is shared evenly among the aggregators */
+static void get_aggregator_range(size_t total, int naggr, int a, size_t round,
+                                 size_t bs, size_t *lo, size_t *hi) {
+  size_t first = total * a / naggr, last = total * (a + 1) / naggr;
+  *lo = first + round * bs;
+  if (*lo > last)
+    *lo = last;
+  *hi = (*lo + bs < last) ? *lo + bs : last;
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    prefetch_node_aggregated
+ *
+ * Purpose:     Prefetch the samples of the ranks of a node through
+ *              prefetch_aggregators ranks of the node, so that the file
+ *              system sees a few large reads per node rather than one
+ *              stream of small reads per rank. The lists of samples of the
+ *              ranks of the node are merged; each aggregator reads its
+ *              share of the merged list, in rounds of prefetch_block_size
+ *              bytes, into a staging buffer shared on the node, from which
+ *              every rank copies its own samples into its cache. Collective
+ *              on the ranks of the node.
+ *
+ * Return:      Success:    0
+ *              Failure:    -1
+ *
+ *-------------------------------------------------------------------------
+ */
+static herr_t prefetch_node_aggregated(H5VL_cache_ext_t *dset, int *samples,
+                                       size_t n, hid_t plist_id) {
+  DSET *d = &dset->H5DRMM->dset;
+  MPI_INFO *mpi = dset->H5DRMM->mpi;
+  size_t ss = d->sample.size, nround = 0, r, lo, hi, k;
+  size_t bs = dset->H5LS->prefetch_block_size / ss;
+  int ppn = mpi->ppn, cnt = (int)n, total, i, a, me = -1;
+  int naggr = (dset->H5LS->prefetch_aggregators < ppn)
+                  ? dset->H5LS->prefetch_aggregators
+                  : ppn;
+  herr_t ret_value = SUCCEED;
+  char *cache = (char *)dset->H5DRMM->mmap->buf;
+  if (bs == 0)
+    bs = 1;
+  // merge the lists of samples of the node
+  int *counts = (int *)malloc(sizeof(int) * ppn);
+  int *displs = (int *)malloc(sizeof(int) * (ppn + 1));
+  MPI_Allgather(&cnt, 1, MPI_INT, counts, 1, MPI_INT, mpi->node_comm);
+  displs[0] = 0;
+  for (i = 0; i < ppn; i++)
+    displs[i + 1] = displs[i] + counts[i];
+  int *all = (int *)malloc(sizeof(int) * (displs[ppn] + 1));
+  MPI_Allgatherv(samples, cnt, MPI_INT, all, counts, displs, MPI_INT,
+                 mpi->node_comm);
+  total = sort_unique_samples(all, displs[ppn]);
+  // the aggregators are spread over the ranks of the node
+  for (a = 0; a < naggr; a++) {
+    if (mpi->local_rank == a * ppn / naggr)
+      me = a;
+    get_aggregator_range(total, naggr, a, 0, total, &lo, &hi);
+    if ((hi - lo + bs - 1) / bs > nround)
+      nround = (hi - lo + bs - 1) / bs;
+  }
+#ifndef NDEBUG
+  LOG_DEBUG(-1, "node prefetch: %d sample(s), %d aggregator(s), %zu round(s)",
+            total, naggr, nround);
+#endif
+  char *stage;
+  char **segs = (char **)malloc(sizeof(char *) * naggr);
+  MPI_Win win;
+  MPI_Win_allocate_shared((me >= 0) ? bs * ss : 0, 1, MPI_INFO_NULL,
+                          mpi->node_comm, &stage, &win);
+  for (a = 0; a < naggr; a++) {
+    MPI_Aint size;
+    int disp_unit;
+    MPI_Win_shared_query(win, a * ppn / naggr, &size, &disp_unit, &segs[a]);
+  }
+  int *mine = (int *)malloc(sizeof(int) * (n + 1));
+  MPI_Win_lock_all(MPI_MODE_NOCHECK, win);
+  for (r = 0; r < nround; r++) {
+    int ok = 1, all_ok;
+    size_t m = 0;
+    if (me >= 0) {
+      get_aggregator_range(total, naggr, me, r, bs, &lo, &hi);
+      if (lo < hi && read_samples_from_pfs(dset, &all[lo], hi - lo, stage,
+                                           d->h5_datatype, plist_id) < 0)
+        ok = 0;
+    }
+    // the staging buffers are complete on the node
+    MPI_Win_sync(win);
+    MPI_Allreduce(&ok, &all_ok, 1, MPI_INT, MPI_MIN, mpi->node_comm);
+    MPI_Win_sync(win);
+    if (!all_ok) {
+      LOG_WARN(-1, "aggregated prefetch failed on the node");
+      ret_value = FAIL;
+      break;
+    }
+    for (a = 0; a < naggr; a++) {
+      get_aggregator_range(total, naggr, a, r, bs, &lo, &hi);
+      for (k = lo; k < hi; k++)
+        if (all[k] >= d->s_offset && all[k] < d->s_offset + d->ns_loc) {
+          memcpy(cache + (all[k] - d->s_offset) * ss, segs[a] + (k - lo) * ss,
+                 ss);
+          mine[m++] = all[k];
+        }
+    }
+    mark_sample_list_resident(dset, mine, m);
+    // the staging buffers are reused by the next round
+    MPI_Barrier(mpi->node_comm);
+  }
+  MPI_Win_unlock_all(win);
+  MPI_Win_free(&win);
+  free(mine);
+  free(segs);
+  free(all);
+  free(displs);
+  free(counts);
+  return ret_value;
+}
+
+/* a block of local samples read by the prefetch */
+typedef struct _prefetch_block_t {
+  size_t first;         // first sample of the block in the prefetch list
+  size_t n;             // number of samples of the block
+  request_list_t *reqs; // reads of the block in flight
+} prefetch_block_t;
+
+/* prefetch tuning: the number of reads in flight is tuned first, then the
+ * size of the blocks, then the configuration is kept */
+typedef enum { TUNE_INFLIGHT, TUNE_BLOCK, TUNE_DONE } prefetch_tune_t;
+
+/*-------------------------------------------------------------------------
+ * Function:    prefetch_local_samples
+ *
+ * Purpose:     Read the n samples of the calling rank listed in samples
+ *              (in increasing order) into their slots of the cache with a
+ *              pipeline of block reads: up to prefetch_inflight blocks are
+ *              read concurrently (the reads are asynchronous with the Async
+ *              VOL below), and each block is marked resident as soon as it
+ *              is read. With prefetch_autotune, the bandwidth is measured
+ *              over each round of reads; the number of reads in flight and
+ *              then the block size are doubled as long as the bandwidth
+ *              improves, and the last step is undone when it does not, so
+ *              that the file system is saturated without being flooded.
+ *
+ * Return:      Success:    0
+ *              Failure:    -1
+ *
+ *-------------------------------------------------------------------------
+ */
+static herr_t prefetch_local_samples(H5VL_cache_ext_t *dset, int *samples,
+                                     size_t n, hid_t plist_id) {
+  DSET *d = &dset->H5DRMM->dset;
+  size_t ss = d->sample.size, next = 0, i;
+  int max_inflight = dset->H5LS->prefetch_inflight;
+  int inflight = dset->H5LS->prefetch_autotune ? 1 : max_inflight;
+  size_t bs = dset->H5LS->prefetch_block_size / ss;
+  int head = 0, nq = 0, ndone = 0;
+  herr_t ret_value = SUCCEED;
+  prefetch_tune_t phase =
+      dset->H5LS->prefetch_autotune ? TUNE_INFLIGHT : TUNE_DONE;
+  double best_bw = 0.0, t0 = MPI_Wtime();
+  size_t nbytes = 0;
+  if (bs == 0)
+    bs = 1;
+  int *slots = (int *)malloc(sizeof(int) * (n + 1));
+  for (i = 0; i < n; i++)
+    slots[i] = samples[i] - d->s_offset;
+  prefetch_block_t *blocks =
+      (prefetch_block_t *)malloc(sizeof(prefetch_block_t) * max_inflight);
+  char *p = (char *)dset->H5DRMM->mmap->buf;
+  while (next < n || nq > 0) {
+    // keep the pipeline full
+    while (nq < inflight && next < n) {
+      prefetch_block_t *b = &blocks[(head + nq) % max_inflight];
+      b->first = next;
+      b->n = (n - next < bs) ? n - next : bs;
+      b->reqs = NULL;
+      if (read_samples_async(dset, &samples[next], &slots[next], b->n, p,
+                             plist_id, &b->reqs) < 0)
+        ret_value = FAIL;
+      next += b->n;
+      nq++;
+    }
+    // complete the oldest block
+    prefetch_block_t *b = &blocks[head];
+    if (wait_requests(dset, &b->reqs))
+      mark_sample_list_resident(dset, &samples[b->first], b->n);
+    else
+      ret_value = FAIL;
+    head = (head + 1) % max_inflight;
+    nq--;
+    nbytes += b->n * ss;
+    if (phase == TUNE_DONE || ++ndone < inflight)
+      continue;
+    double t1 = MPI_Wtime();
+    double bw = (t1 > t0) ? nbytes / (t1 - t0) : 0.0;
+#ifndef NDEBUG
+    LOG_DEBUG(-1, "prefetch: %d read(s) of %zu sample(s) in flight, %.2f MB/s",
+              inflight, bs, bw / 1048576.);
+#endif
+    if (bw > best_bw * PREFETCH_TUNE_GAIN) {
+      best_bw = bw;
+      if (phase == TUNE_INFLIGHT && inflight < max_inflight) {
+        inflight = (2 * inflight < max_inflight) ? 2 * inflight : max_inflight;
+      } else if (2 * bs * ss <= PREFETCH_BLOCK_MAX) {
+        phase = TUNE_BLOCK;
+        bs *= 2;
+      } else {
+        phase = TUNE_DONE;
+      }
+    } else if (phase == TUNE_INFLIGHT) {
+      // the file system is saturated; undo the last step
+      inflight = (inflight > 1) ? inflight / 2 : 1;
+      phase = (2 * bs * ss <= PREFETCH_BLOCK_MAX) ? TUNE_BLOCK : TUNE_DONE;
+      if (phase == TUNE_BLOCK)
+        bs *= 2;
+    } else {
+      bs = (bs > 1) ? bs / 2 : 1;
+      phase = TUNE_DONE;
+    }
+    ndone = 0;
+    nbytes = 0;
+    t0 = MPI_Wtime();
+  }
+#ifndef NDEBUG
+  LOG_DEBUG(-1, "prefetch done: %d read(s) of %zu sample(s) in flight",
+            inflight, bs);
+#endif
+  free(blocks);
+  free(slots);
+  return ret_value;
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    attach_node_read_caches
+ *
+ * Purpose:     Map the read cache of every rank on the same node into the
+ *              address space of the calling rank, so that cached samples
+ *              owned by these ranks are copied directly instead of going
+ *              through MPI_Get. For MEMORY storage the cache lives in node
+ *              shared memory; for file based storage the cache file of the
+ *              peer is mapped if the storage class supports it. Collective
+ *              over the node communicator.
+ *
+ * Return:      Success:    0
+ *              Failure:    -1
+ *
+ *-------------------------------------------------------------------------
+ */
+static herr_t attach_node_read_caches(H5VL_cache_ext_t *dset) {
+  io_handler_t *dmm = dset->H5DRMM;
+  int ppn = dmm->mpi->ppn;
+  int *ranks = (int *)malloc(sizeof(int) * ppn);
+  char *fnames = (char *)malloc(sizeof(dmm->mmap->fname) * ppn);
+  int i;
+  dmm->mmap->peer_buf = (void **)calloc(dmm->mpi->nproc, sizeof(void *));
+  // the cache of every rank is created once this returns
+  MPI_Allgather(&dmm->mpi->rank, 1, MPI_INT, ranks, 1, MPI_INT,
+                dmm->mpi->node_comm);
+  MPI_Allgather(dmm->mmap->fname, sizeof(dmm->mmap->fname), MPI_CHAR, fnames,
+                sizeof(dmm->mmap->fname), MPI_CHAR, dmm->mpi->node_comm);
+  for (i = 0; i < ppn; i++) {
+    int r = ranks[i];
+    if (r == dmm->mpi->rank) {
+      dmm->mmap->peer_buf[r] = dmm->mmap->buf;
+    } else if (!strcmp(dset->H5LS->type, "MEMORY")) {
+      MPI_Aint size;
+      int disp_unit;
+      MPI_Win_shared_query(dmm->mpi->shm_win, i, &size, &disp_unit,
+                           &dmm->mmap->peer_buf[r]);
+    } else if (dset->H5LS->mmap_cls->attach_read_mmap != NULL) {
+      hsize_t meta_offset, win_size;
+      get_read_cache_layout(dmm, r, &meta_offset, &win_size);
+      dmm->mmap->peer_buf[r] = dset->H5LS->mmap_cls->attach_read_mmap(
+          &fnames[i * sizeof(dmm->mmap->fname)], win_size);
+    }
+#ifndef NDEBUG
+    if (dmm->mmap->peer_buf[r] == NULL)
+      LOG_DEBUG(dmm->mpi->rank, "read cache of rank %d is accessed by RMA", r);
+#endif
+  }
+  free(ranks);
+  free(fnames);
+  return SUCCEED;
+}
+
+static herr_t detach_node_read_caches(H5VL_cache_ext_t *dset) {
+  io_handler_t *dmm = dset->H5DRMM;
+  int r;
+  if (dmm->mmap->peer_buf == NULL)
+    return SUCCEED;
+  if (strcmp(dset->H5LS->type, "MEMORY") &&
+      dset->H5LS->mmap_cls->detach_read_mmap != NULL)
+    for (r = 0; r < dmm->mpi->nproc; r++)
+      if (r != dmm->mpi->rank && dmm->mmap->peer_buf[r] != NULL) {
+        hsize_t meta_offset, win_size;
+        get_read_cache_layout(dmm, r, &meta_offset, &win_size);
+        dset->H5LS->mmap_cls->detach_read_mmap(dmm->mmap->peer_buf[r],
+                                               win_size);
+      }
+  free(dmm->mmap->peer_buf);
+  dmm->mmap->peer_buf = NULL;
+  return SUCCEED;
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    copy_node_local_segments
+ *
+ * Purpose:     Copy the segments whose owner cache is mapped by the calling
+ *              rank (same node) with memcpy, and move the remaining
+ *              segments, which need RMA, to the front of the list. In the
+ *              PASSIVE mode, the window is synced first, so that the copy
+ *              sees the stores of the other ranks that the residency flags
+ *              (read by an earlier call) proved.
+ *
+ * Return:      the number of segments left for RMA
+ *
+ *-------------------------------------------------------------------------
+ */
+static void read_cache_sync(H5VL_cache_ext_t *dset);
+
+static size_t copy_node_local_segments(H5VL_cache_ext_t *dset, RMA_SEG *segs,
+                                       size_t nseg, char *buf) {
+  io_handler_t *dmm = dset->H5DRMM;
+  size_t i, n = 0;
+  if (dmm->mmap->peer_buf != NULL && nseg > 0)
+    read_cache_sync(dset);
+  for (i = 0; i < nseg; i++) {
+    char *src = (dmm->mmap->peer_buf == NULL)
+                    ? NULL
+                    : (char *)dmm->mmap->peer_buf[segs[i].rank];
+    if (src != NULL)
+      memcpy(&buf[segs[i].pos], &src[segs[i].disp], segs[i].len);
+    else
+      segs[n++] = segs[i];
+  }
+  return n;
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    create_read_cache_window
+ *
+ * Purpose:     Expose the read cache buffer of a dataset to the other ranks
+ *              through an MPI window. In the PASSIVE RMA mode a shared lock
+ *              on all the ranks is held for the lifetime of the window so
+ *              that each rank can access the cache independently.
+ *
+ * Return:      Success:    0
+ *              Failure:    -1
+ *
+ *-------------------------------------------------------------------------
+ */
+static herr_t create_read_cache_window(H5VL_cache_ext_t *dset) {
+  io_handler_t *dmm = dset->H5DRMM;
+  MPI_Win_create(dmm->mmap->buf, dmm->dset.win_size, 1, MPI_INFO_NULL,
+                 dmm->mpi->comm, &dmm->mpi->win);
+  if (dset->H5LS->rma_mode == RMA_PASSIVE)
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, dmm->mpi->win);
+  return SUCCEED;
+}
+
+static herr_t free_read_cache_window(H5VL_cache_ext_t *dset) {
+  if (dset->H5LS->rma_mode == RMA_PASSIVE)
+    MPI_Win_unlock_all(dset->H5DRMM->mpi->win);
+  MPI_Win_free(&dset->H5DRMM->mpi->win);
+  return SUCCEED;
+}
+
+/* start an access epoch on the read cache window; in the PASSIVE mode the
+ * epoch is already opened by MPI_Win_lock_all */
+static void read_cache_epoch_start(H5VL_cache_ext_t *dset, int mode) {
+  if (dset->H5LS->rma_mode == RMA_FENCE)
+    MPI_Win_fence(mode, dset->H5DRMM->mpi->win);
+}
+
+/* complete the operations issued on the read cache window. In the PASSIVE
+ * mode only the calling rank waits: for MPI_Get local completion is enough,
+ * while MPI_Put has to be completed at the target. */
+static void read_cache_epoch_end(H5VL_cache_ext_t *dset, int mode,
+                                 bool remote) {
+  if (dset->H5LS->rma_mode == RMA_FENCE)
+    MPI_Win_fence(mode, dset->H5DRMM->mpi->win);
+  else if (remote)
+    MPI_Win_flush_all(dset->H5DRMM->mpi->win);
+  else
+    MPI_Win_flush_local_all(dset->H5DRMM->mpi->win);
+}
+
+/* make local stores to the read cache buffer (prefetch) visible to RMA
+ * accesses from the other ranks, and the stores of the other ranks visible
+ * to direct loads from the node-local caches */
+static void read_cache_sync(H5VL_cache_ext_t *dset) {
+  if (dset->H5LS->rma_mode == RMA_PASSIVE)
+    MPI_Win_sync(dset->H5DRMM->mpi->win);
+}
+
+/* PASSIVE mode: complete the outstanding operations at their targets
+ * without closing the epoch */
+static void read_cache_flush(H5VL_cache_ext_t *dset) {
+  if (dset->H5LS->rma_mode == RMA_PASSIVE)
+    MPI_Win_flush_all(dset->H5DRMM->mpi->win);
+}
+
+static herr_t H5VL_cache_ext_dataset_mmap_remap(void *obj) {
+  H5VL_cache_ext_t *dset = (H5VL_cache_ext_t *)obj;
+  // created a memory mapped file on the local storage. And create a MPI_win
+  hsize_t ss = dset->H5DRMM->dset.win_size;
+  if (strcmp(dset->H5LS->type, "MEMORY") != 0) {
+    // msync(dset->H5DRMM->mmap->buf, ss, MS_SYNC);
+    double t0 = MPI_Wtime();
+    detach_node_read_caches(dset);
+    free_read_cache_window(dset);
+    munmap(dset->H5DRMM->mmap->buf, ss);
+#ifdef __linux__
+    posix_fadvise(dset->H5DRMM->mmap->fd, 0, ss, POSIX_FADV_DONTNEED);
+#endif
+    fsync(dset->H5DRMM->mmap->fd);
+    close(dset->H5DRMM->mmap->fd);
+    double t1 = MPI_Wtime();
+
+    char tmp[252];
+    strcpy(tmp, dset->H5DRMM->mmap->fname);
+    strcat(dset->H5DRMM->mmap->fname, "p");
+    char cmd[300];
+    strcpy(cmd, "cp ");
+    strcat(cmd, tmp);
+    strcat(cmd, " ");
+    strcat(cmd, dset->H5DRMM->mmap->fname);
+    //    sprintf(cmd, "cp %s %s", tmp, dset->H5DRMM->mmap->fname);
+    system(cmd);
+    remove(tmp);
+    dset->H5DRMM->mmap->fd = open(dset->H5DRMM->mmap->fname, O_RDWR);
+    dset->H5DRMM->mmap->buf =
+        mmap(NULL, ss, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_NORESERVE,
+             dset->H5DRMM->mmap->fd, 0);
+    create_read_cache_window(dset);
+    attach_node_read_caches(dset);
+    double t2 = MPI_Wtime();
+  }
+  return SUCCEED;
+}
+
+/* state of an asynchronous prefetch (H5VL_cache_ext_t.prefetch_req): the
+ * samples are read in blocks, issued a few at a time by
+ * schedule_prefetch_async, and each block is marked resident as soon as its
+ * reads complete. The state is kept once the prefetch is done, for
+ * H5Dprefetch_status. It is shared by the dataset and the requests of the
+ * prefetch (H5VL_cache_ext_t.prefetch_req of a request) and freed with the
+ * last of them; once the dataset is closed, the prefetch is complete and
+ * detached from it (dset is NULL), and only its outcome is kept. */
+typedef struct _prefetch_async_t {
+  int refcount;           // the dataset (until detached) and the requests
+  H5VL_cache_ext_t *dset; // dataset prefetched, NULL once detached
+  int *samples;           // samples of the prefetch, in increasing order
+  size_t n;               // number of samples
+  size_t block;           // number of samples per block
+  size_t nblock;          // number of blocks
+  size_t nissued;         // number of blocks issued to the under VOL
+  size_t nlanded;         // number of blocks whose reads completed
+  int window;             // largest number of blocks in flight
+  unsigned long misses;   // demand misses seen by the last scheduling
+  request_list_t **reqs;  // reads of each block; NULL once landed
+  bool *landed;           // whether the reads of each block completed
+  bool failed;            // whether the reads of a block failed
+  hsize_t bytes_done;     // bytes landed in the cache
+  hsize_t bytes_total;    // bytes of the prefetch
+  hid_t dxpl_id;          // transfer property list of the reads
+  H5VL_request_notify_t notify; // callback of the request, once done
+  void *notify_ctx;               // context of the callback
+  struct _prefetch_async_t *next; // next prefetch in flight on the rank
+} prefetch_async_t;
+
+/* whether the reads of a list have all completed, without waiting */
+static bool test_requests(H5VL_cache_ext_t *dset, request_list_t *reqs) {
+  H5VL_request_status_t status;
+  for (; reqs != NULL; reqs = reqs->next)
+    if (reqs->req != NULL &&
+        H5VLrequest_wait(reqs->req, dset->under_vol_id, 0, &status) >= 0 &&
+        status == H5VL_REQUEST_STATUS_IN_PROGRESS)
+      return false;
+  return true;
+}
+
+/* whether all the blocks of an asynchronous prefetch landed */
+static bool prefetch_async_done(prefetch_async_t *pf) {
+  return pf->dset == NULL || pf->nlanded == pf->nblock;
+}
+
+/* invoke the callback registered on the request of an asynchronous
+ * prefetch (H5VL_cache_ext_request_notify), once it is done */
+static void notify_prefetch_async(prefetch_async_t *pf) {
+  H5VL_request_notify_t cb = pf->notify;
+  if (cb == NULL || !prefetch_async_done(pf))
+    return;
+  pf->notify = NULL;
+  cb(pf->notify_ctx, pf->failed ? H5VL_REQUEST_STATUS_FAIL
+                                : H5VL_REQUEST_STATUS_SUCCEED);
+}
+
+/* drop a reference to the state of an asynchronous prefetch */
+static void release_prefetch_async(prefetch_async_t *pf) {
+  if (--pf->refcount > 0)
+    return;
+  free(pf);
+}
+
+/* issue the reads of the next block of an asynchronous prefetch */
+static void issue_prefetch_block(prefetch_async_t *pf) {
+  H5VL_cache_ext_t *dset = pf->dset;
+  DSET *d = &dset->H5DRMM->dset;
+  size_t i = pf->nissued++, k;
+  size_t first = i * pf->block;
+  size_t m = (pf->n - first < pf->block) ? pf->n - first : pf->block;
+  int *slots = (int *)malloc(sizeof(int) * m);
+  for (k = 0; k < m; k++)
+    slots[k] = pf->samples[first + k] - d->s_offset;
+  if (read_samples_async(dset, &pf->samples[first], slots, m,
+                         (char *)dset->H5DRMM->mmap->buf, pf->dxpl_id,
+                         &pf->reqs[i]) < 0) {
+    // the samples of the block are read from the file when needed
+    LOG_WARN(-1, "prefetch of %zu sample(s) failed", m);
+    wait_requests(dset, &pf->reqs[i]);
+    pf->failed = true;
+    pf->landed[i] = true;
+    pf->nlanded++;
+  }
+  free(slots);
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    schedule_prefetch_async
+ *
+ * Purpose:     Issue the next blocks of an asynchronous prefetch, so that
+ *              the demand reads only queue behind a few prefetch blocks in
+ *              the under VOL. With prefetch_yield, no block is issued while
+ *              a demand read is in progress on the rank, and the number of
+ *              blocks in flight is halved each time demand reads went to
+ *              the under VOL since the last scheduling, and grows back by
+ *              one block up to prefetch_inflight otherwise. Without
+ *              prefetch_yield, all the blocks are issued at once.
+ *
+ * Return:      None
+ *
+ *-------------------------------------------------------------------------
+ */
+static void schedule_prefetch_async(prefetch_async_t *pf) {
+  cache_storage_t *LS = pf->dset->H5LS;
+  if (!LS->prefetch_yield) {
+    while (pf->nissued < pf->nblock)
+      issue_prefetch_block(pf);
+    return;
+  }
+  if (LS->demand_reads > 0)
+    return;
+  if (pf->misses != LS->demand_misses) {
+    pf->window = (pf->window > 1) ? pf->window / 2 : 1;
+    pf->misses = LS->demand_misses;
+  } else if (pf->window < LS->prefetch_inflight) {
+    pf->window++;
+  }
+  while (pf->nissued < pf->nblock &&
+         pf->nissued - pf->nlanded < (size_t)pf->window)
+    issue_prefetch_block(pf);
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    progress_prefetch_async
+ *
+ * Purpose:     Mark the blocks of the asynchronous prefetch of the dataset
+ *              whose reads completed as resident, so that they are read
+ *              from the cache, in whatever order they land, and issue the
+ *              next blocks (see schedule_prefetch_async). With wait, all
+ *              the remaining blocks are issued and waited for. Once all the
+ *              blocks landed, the cache is synced. The dataset is not
+ *              flagged as cached here, since the ranks complete their
+ *              prefetch at different times: the samples are counted as
+ *              they land (count_cached_samples), and the ranks switch to
+ *              the cache together once the global counter says so.
+ *
+ * Return:      Whether all the blocks landed
+ *
+ *-------------------------------------------------------------------------
+ */
+static bool progress_prefetch_async(H5VL_cache_ext_t *dset, bool wait) {
+  prefetch_async_t *pf = (prefetch_async_t *)dset->prefetch_req;
+  size_t i;
+  if (pf == NULL || pf->nlanded == pf->nblock)
+    return true;
+  while (wait && pf->nissued < pf->nblock)
+    issue_prefetch_block(pf);
+  for (i = 0; i < pf->nissued; i++) {
+    if (pf->landed[i] || (!wait && !test_requests(dset, pf->reqs[i])))
+      continue;
+    size_t first = i * pf->block;
+    size_t m = (pf->n - first < pf->block) ? pf->n - first : pf->block;
+    if (wait_requests(dset, &pf->reqs[i])) {
+      mark_sample_list_resident(dset, &pf->samples[first], m);
+      pf->bytes_done += m * dset->H5DRMM->dset.sample.size;
+    } else {
+      // the samples of the block are read from the file when needed
+      LOG_WARN(-1, "prefetch of %zu sample(s) failed", m);
+      pf->failed = true;
+    }
+    pf->landed[i] = true;
+    pf->nlanded++;
+  }
+  if (pf->nissued < pf->nblock)
+    schedule_prefetch_async(pf);
+  if (pf->nlanded < pf->nblock)
+    return false;
+  if (dset->H5LS->path != NULL)
+    msync(dset->H5DRMM->mmap->buf, dset->H5DRMM->dset.size, MS_SYNC);
+#ifndef NDEBUG
+  LOG_DEBUG(-1, "async prefetch done: %llu bytes",
+            (unsigned long long)pf->bytes_done);
+#endif
+  notify_prefetch_async(pf);
+  return true;
+}
+
+/* make progress on all the asynchronous prefetches of the rank on the cache
+ * storage, e.g., once a demand read is done */
+static void progress_all_prefetch_async(cache_storage_t *LS) {
+  prefetch_async_t *pf;
+  for (pf = LS->prefetch_list; pf != NULL; pf = pf->next)
+    progress_prefetch_async(pf->dset, false);
+}
+
+/* complete the asynchronous prefetch of the dataset and detach it from the
+ * dataset, e.g., when the dataset is closed; its requests keep its outcome */
+static void free_prefetch_async(H5VL_cache_ext_t *dset) {
+  prefetch_async_t *pf = (prefetch_async_t *)dset->prefetch_req;
+  prefetch_async_t **p;
+  if (pf == NULL)
+    return;
+  progress_prefetch_async(dset, true);
+  for (p = &dset->H5LS->prefetch_list; *p != NULL; p = &(*p)->next)
+    if (*p == pf) {
+      *p = pf->next;
+      break;
+    }
+  H5Pclose(pf->dxpl_id);
+  free(pf->samples);
+  free(pf->reqs);
+  free(pf->landed);
+  pf->samples = NULL;
+  pf->reqs = NULL;
+  pf->landed = NULL;
+  pf->dset = NULL;
+  pf->next = NULL;
+  dset->prefetch_req = NULL;
+  notify_prefetch_async(pf);
+  release_prefetch_async(pf);
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    H5VL_cache_ext_dataset_prefetch_async
+ *
+ * Purpose:     Start prefetching the samples of the calling rank touched by
+ *              the selection fspace without waiting for them: the samples
+ *              are read in blocks of prefetch_block_size bytes, issued to
+ *              the under VOL a few at a time (the reads are asynchronous
+ *              with the Async VOL below) as the earlier blocks land, and
+ *              the reads of the dataset take the blocks that already landed
+ *              from the cache. A previous prefetch of the dataset is
+ *              completed first.
+ *
+ * Return:      Success:    0
+ *              Failure:    -1
+ *
+ *-------------------------------------------------------------------------
+ */
+static herr_t H5VL_cache_ext_dataset_prefetch_async(void *obj, hid_t fspace,
+                                                    hid_t plist_id) {
+#ifndef NDEBUG
+  LOG_INFO(-1, "VOL DATASET Prefetch async");
+#endif
+  H5VL_cache_ext_t *dset = (H5VL_cache_ext_t *)obj;
+  if (!dset->read_cache)
+    return SUCCEED;
+  free_prefetch_async(dset);
+  DSET *d = &dset->H5DRMM->dset;
+  prefetch_async_t *pf = (prefetch_async_t *)calloc(1, sizeof(*pf));
+  pf->refcount = 1;
+  pf->dset = dset;
+  pf->n = get_prefetch_samples(dset, fspace, &pf->samples);
+  pf->block = dset->H5LS->prefetch_block_size / d->sample.size;
+  if (pf->block == 0)
+    pf->block = 1;
+  pf->nblock = (pf->n + pf->block - 1) / pf->block;
+  pf->bytes_total = pf->n * d->sample.size;
+  pf->reqs = (request_list_t **)calloc(pf->nblock + 1, sizeof(request_list_t *));
+  pf->landed = (bool *)calloc(pf->nblock + 1, sizeof(bool));
+  pf->window = dset->H5LS->prefetch_inflight;
+  pf->misses = dset->H5LS->demand_misses;
+  // the blocks are issued after the call returns
+  pf->dxpl_id = get_independent_dxpl(plist_id);
+  pf->next = dset->H5LS->prefetch_list;
+  dset->H5LS->prefetch_list = pf;
+  dset->prefetch_req = pf;
+#ifndef NDEBUG
+  LOG_DEBUG(-1, "Number of samples per proc: %zu of %ld; offset: %ld; %zu "
+            "block(s)", pf->n, d->ns_loc, d->s_offset, pf->nblock);
+#endif
+  if (pf->n > 0 && claim_read_cache_space(dset, pf->n) < 0) {
+    LOG_WARN(-1, "Unable to claim space in the cache storage for the "
+                 "prefetch; the samples will be read from the file");
+    pf->nblock = 0;
+    pf->bytes_total = 0;
+    return FAIL;
+  }
+  // the first blocks; the blocks read synchronously (without the Async VOL)
+  // are done
+  progress_prefetch_async(dset, false);
+  return pf->failed ? FAIL : SUCCEED;
+}
+
+/* the request of an asynchronous prefetch, returned to an event set, has no
+ * under request; it holds a reference to the state of the prefetch, so that
+ * it can be waited for and freed after the dataset is closed */
+static bool is_prefetch_request(H5VL_cache_ext_t *o) {
+  return o->under_object == NULL && o->prefetch_req != NULL;
+}
+
+/* create the request of the asynchronous prefetch of a dataset */
+static H5VL_cache_ext_t *new_prefetch_request(H5VL_cache_ext_t *dset) {
+  H5VL_cache_ext_t *req = H5VL_cache_ext_new_obj(NULL, dset->under_vol_id);
+  prefetch_async_t *pf = (prefetch_async_t *)dset->prefetch_req;
+  if (pf != NULL) {
+    pf->refcount++;
+    req->prefetch_req = pf;
+  }
+  return req;
+}
+
+/* wait, for at most timeout nanoseconds, for the reads of the oldest block
+ * of an asynchronous prefetch in flight (the first one is issued if none
+ * is); returns whether they completed */
+static bool wait_prefetch_block(prefetch_async_t *pf, uint64_t timeout) {
+  H5VL_cache_ext_t *dset = pf->dset;
+  H5VL_request_status_t status;
+  request_list_t *r;
+  double t0 = MPI_Wtime();
+  size_t i;
+  for (i = 0; i < pf->nissued && pf->landed[i]; i++)
+    ;
+  if (i == pf->nissued) {
+    if (pf->nissued < pf->nblock)
+      issue_prefetch_block(pf);
+    return true;
+  }
+  for (r = pf->reqs[i]; r != NULL; r = r->next) {
+    double spent = (MPI_Wtime() - t0) * 1e9;
+    uint64_t left = (spent < (double)timeout) ? timeout - (uint64_t)spent : 0;
+    if (r->req != NULL &&
+        H5VLrequest_wait(r->req, dset->under_vol_id, left, &status) >= 0 &&
+        status == H5VL_REQUEST_STATUS_IN_PROGRESS)
+      return false;
+  }
+  return true;
+}
+
+/* wait (with a timeout, in nanoseconds) for the asynchronous prefetch of a
+ * prefetch request; the wait blocks on the reads of the under VOL */
+static herr_t wait_prefetch_request(H5VL_cache_ext_t *o, uint64_t timeout,
+                                    H5VL_request_status_t *status) {
+  prefetch_async_t *pf = (prefetch_async_t *)o->prefetch_req;
+  double t0 = MPI_Wtime();
+  bool done = prefetch_async_done(pf) ||
+              progress_prefetch_async(pf->dset, timeout == INF);
+  while (!done) {
+    double spent = (MPI_Wtime() - t0) * 1e9;
+    if (spent >= (double)timeout ||
+        !wait_prefetch_block(pf, timeout - (uint64_t)spent))
+      break;
+    done = progress_prefetch_async(pf->dset, false);
+  }
+  if (!done)
+    *status = H5VL_REQUEST_STATUS_IN_PROGRESS;
+  else if (pf->failed)
+    *status = H5VL_REQUEST_STATUS_FAIL;
+  else
+    *status = H5VL_REQUEST_STATUS_SUCCEED;
+  return SUCCEED;
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    H5VL_cache_ext_dataset_prefetch_status
+ *
+ * Purpose:     Get the number of bytes of the prefetch of the calling rank
+ *              that landed in the cache, and its total number of bytes,
+ *              after marking the blocks that landed since the last call.
+ *
+ * Return:      Success:    0
+ *              Failure:    -1, some reads of the prefetch failed
+ *
+ *-------------------------------------------------------------------------
+ */
+static herr_t H5VL_cache_ext_dataset_prefetch_status(void *obj,
+                                                     hsize_t *bytes_done,
+                                                     hsize_t *bytes_total) {
+  H5VL_cache_ext_t *dset = (H5VL_cache_ext_t *)obj;
+  prefetch_async_t *pf = (prefetch_async_t *)dset->prefetch_req;
+  *bytes_done = 0;
+  *bytes_total = 0;
+  if (!dset->read_cache || pf == NULL)
+    return SUCCEED;
+  progress_prefetch_async(dset, false);
+  *bytes_done = pf->bytes_done;
+  *bytes_total = pf->bytes_total;
+  return pf->failed ? FAIL : SUCCEED;
+}
+
+
+/*-------------------------------------------------------------------------
+ * Function:    H5VL_cache_ext_dataset_open
+ *
+ * Purpose:     Opens a dataset in a container
+ *
+ * Return:      Success:    Pointer to a dataset object
+ *              Failure:    NULL
+ *
+ *-------------------------------------------------------------------------
+ */
+static void *H5VL_cache_ext_dataset_open(void *obj,
+                                         const H5VL_loc_params_t *loc_params,
+                                         const char *name, hid_t dapl_id,
+                                         hid_t dxpl_id, void **req) {
+  H5VL_cache_ext_t *dset;
+  H5VL_cache_ext_t *o = (H5VL_cache_ext_t *)obj;
+  void *under;
+
+#ifndef NDEBUG
+  LOG_INFO(-1, "VOL DATASET Open");
+#endif
+
+  under = H5VLdataset_open(o->under_object, loc_params, o->under_vol_id, name,
+                           dapl_id, dxpl_id, req);
+  if (under) {
+    dset = H5VL_cache_ext_new_obj(under, o->under_vol_id);
+    /* Inherit Cache information from obj */
+    dset->parent = obj;
+    dset->H5DWMM = o->H5DWMM;
+    dset->write_cache = o->write_cache;
+    dset->read_cache = o->read_cache;
+    dset->num_request_dataset = 0;
+    dset->H5DRMM = NULL;
+    dset->H5LS = o->H5LS;
+    dset->async_pause = o->async_pause;
+    /* setup read cache */
+    if (dset->read_cache || dset->write_cache) {
+      dset->es_id = H5EScreate();
+      dset_args_t *args = (dset_args_t *)malloc(sizeof(dset_args_t)); // freed
+      args->type_id = H5Tcopy(dataset_get_type(
+          dset->under_object, dset->under_vol_id, dxpl_id, NULL));
+      args->space_id = H5Scopy(dataset_get_space(
+          dset->under_object, dset->under_vol_id, dxpl_id, NULL));
+      args->dcpl_id = H5Pcopy(dataset_get_dcpl(
+          dset->under_object, dset->under_vol_id, dxpl_id, NULL));
+      args->lcpl_id = H5Pcreate(H5P_LINK_CREATE);
+      args->name = name;
+      args->loc_params = loc_params;
+      args->dapl_id = H5Pcopy(dapl_id);
+      args->dxpl_id = H5Pcopy(dxpl_id);
+      dset->obj_type = H5I_DATASET;
+      dset->H5LS->cache_io_cls->create_cache((void *)dset, (void *)args, req);
+      H5Pclose(args->lcpl_id);
+      H5Tclose(args->type_id);
+      H5Sclose(args->space_id);
+      H5Pclose(args->dcpl_id);
+      H5Pclose(args->dapl_id);
+      H5Pclose(args->dxpl_id);
+      free(args);
+      if (getenv("DATASET_PREFETCH_AT_OPEN")) {
+        if (dset->read_cache &&
+            !strcmp(getenv("DATASET_PREFETCH_AT_OPEN"), "yes")) {
+#ifndef NDEBUG
+          LOG_DEBUG(-1, "DATASET_PREFETCH_AT_OPEN = yes");
+#endif
+          H5VL_cache_ext_dataset_prefetch_async(dset, H5S_ALL, dxpl_id);
+        }
+      }
+    }
+    /* Check for async request */
+    if (req && *req)
+      *req = H5VL_cache_ext_new_obj(*req, o->under_vol_id);
+
+  } /* end if */
+  else
+    dset = NULL;
+  return (void *)dset;
+} /* end H5VL_cache_ext_dataset_open() */
+
+
+/*
+   Dataset prefetch function: currently, we prefetch the entire dataset into the
+   storage.
+*/
+
+static herr_t H5VL_cache_ext_dataset_prefetch(void *obj, hid_t fspace,
+                                              hid_t plist_id, void **req) {
+#ifndef NDEBUG
+  LOG_INFO(-1, "VOL DATASET Prefetch");
+#endif
+  H5VL_cache_ext_t *dset = (H5VL_cache_ext_t *)obj;
+  herr_t ret_value;
+  if (dset->read_cache) {
+    if (getenv("DATASET_PREFETCH_AT_OPEN")) {
+      if (dset->read_cache &&
+          !strcmp(getenv("DATASET_PREFETCH_AT_OPEN"), "yes")) {
+#ifndef NDEBUG
+        LOG_DEBUG(-1, "prefetched async called");
+#endif
+        return SUCCEED;
+      }
+    }
+    // complete an asynchronous prefetch of the dataset first
+    progress_prefetch_async(dset, true);
+    // only the samples touched by the selection are read, and only their
+    // space is claimed in the cache storage
+    int *samples;
+    size_t n = get_prefetch_samples(dset, fspace, &samples);
+#ifndef NDEBUG
+    LOG_DEBUG(-1, "Number of samples: %zu of %ld; offset: %ld", n,
+              dset->H5DRMM->dset.ns_loc, dset->H5DRMM->dset.s_offset);
+#endif
+    ret_value = SUCCEED;
+    // the ranks read different samples (or none), independently
+    hid_t xfer_id = get_independent_dxpl(plist_id);
+    if (n > 0 && claim_read_cache_space(dset, n) < 0) {
+      LOG_WARN(-1, "Unable to claim space in the cache storage for the "
+                   "prefetch; the samples will be read from the file");
+      ret_value = FAIL;
+      n = 0;
+    }
+    if (dset->H5LS->prefetch_aggregators > 0) {
+      // every rank of the node takes part, even without samples to read
+      if (prefetch_node_aggregated(dset, samples, n, xfer_id) < 0)
+        ret_value = FAIL;
+    } else if (n > 0 && dset->H5DRMM->dset.pipeline != NULL) {
+      // the chunks decoded by the cache are read raw, in groups
+      char *p = (char *)dset->H5DRMM->mmap->buf;
+      int *slots = (int *)malloc(sizeof(int) * n);
+      size_t i, j;
+      for (i = 0; i < n; i++)
+        slots[i] = samples[i] - dset->H5DRMM->dset.s_offset;
+      // read_samples_from_pfs stores the samples back to back
+      for (i = 0; i < n && ret_value >= 0; i = j) {
+        for (j = i + 1; j < n && slots[j] == slots[j - 1] + 1; j++)
+          ;
+        ret_value = read_samples_from_pfs(
+            dset, &samples[i], j - i,
+            p + (size_t)slots[i] * dset->H5DRMM->dset.sample.size,
+            dset->H5DRMM->dset.h5_datatype, xfer_id);
+        if (ret_value >= 0)
+          mark_sample_list_resident(dset, &samples[i], j - i);
+      }
+      free(slots);
+    } else if (n > 0) {
+      ret_value = prefetch_local_samples(dset, samples, n, xfer_id);
+    }
+    H5Pclose(xfer_id);
+    if (ret_value == 0 && dset->H5LS->path != NULL && n > 0)
+      msync(dset->H5DRMM->mmap->buf, dset->H5DRMM->dset.size, MS_SYNC);
+    // a partial selection leaves the other samples to the reads. The ranks
+    // agree on whether the dataset is cached, so that they make the same
+    // collective fences in the reads that follow
+    int cached = ret_value == 0 && (fspace == H5S_ALL ||
+                                    H5Sget_select_type(fspace) == H5S_SEL_ALL);
+    int all_cached;
+    MPI_Allreduce(&cached, &all_cached, 1, MPI_INT, MPI_MIN,
+                  dset->H5DRMM->mpi->comm);
+    if (all_cached) {
+      dset->H5DRMM->io->dset_cached = true;
+      dset->H5DRMM->io->batch_cached = true;
+    }
+    free(samples);
+    return ret_value;
+  } else {
+#ifndef NDEBUG
+    LOG_WARN(-1, "HDF5_CACHE_RD is not set, doing nothing here for "
+                 "dataset_prefetch");
+#endif
+    return 0;
+  }
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    H5VL_cache_ext_dataset_read_to_cache
+ *
+ * Purpose:     Reads data elements from a dataset into a buffer and stores
+ *              a copy to the local storage
+ *
+ * Return:      Success:    0
+ *              Failure:    -1
+ *
+ *-------------------------------------------------------------------------
+ */
+
+static herr_t H5VL_cache_ext_dataset_read_to_cache(
+    size_t count, void *dset[], hid_t mem_type_id[], hid_t mem_space_id[],
+    hid_t file_space_id[], hid_t plist_id, void *buf[], void **req) {
+  void *obj_local;
+  void **obj = &obj_local;
+  size_t i;
+  herr_t ret_value;
+
+#ifndef NDEBUG
+  LOG_INFO(-1, "VOL DATASET Read to cache");
+#endif
+  if (count > 1)
+    if (NULL == (obj = (void **)malloc(count * sizeof(void *))))
+      return -1;
+  // get the under vol object from all the dataset
+  for (i = 0; i < count; i++) {
+    obj[i] = ((H5VL_cache_ext_t *)dset[i])->under_object;
+    if (((H5VL_cache_ext_t *)dset[i])->under_vol_id !=
+        ((H5VL_cache_ext_t *)dset[0])->under_vol_id)
+      return -1;
+  }
+
+  H5VL_cache_ext_t *o = (H5VL_cache_ext_t *)dset[0];
+  if (count == 1 && o->read_cache &&
+      o->H5LS->cache_io_cls->read_data_through_cache != NULL &&
+      o->H5DRMM->dset.pipeline != NULL) {
+    // the chunks that are not cached yet are read raw, decoded in parallel
+    // and stored to the cache
+    ret_value = o->H5LS->cache_io_cls->read_data_through_cache(
+        o, mem_type_id[0], mem_space_id[0], file_space_id[0], plist_id, buf[0],
+        req);
+    if (obj != &obj_local)
+      free(obj);
+    return ret_value;
+  }
+
+  // calling the under H5VLdataset_read
+  ret_value = H5VLdataset_read(
+      count, obj, ((H5VL_cache_ext_t *)dset[0])->under_vol_id, mem_type_id,
+      mem_space_id, file_space_id, plist_id, buf, NULL);
+  /* Saving the read buffer(s) to local storage */
+  if (((H5VL_cache_ext_t *)dset[0])->read_cache)
+    for (i = 0; i < count; i++)
       ((H5VL_cache_ext_t *)dset[i])
           ->H5LS->cache_io_cls->write_data_to_cache2(
               dset[i], mem_type_id[i], mem_space_id[i], file_space_id[i],
@@ -2402,6 +4135,8 @@ static herr_t H5VL_cache_ext_request_wait(void *obj, uint64_t timeout,
 #ifndef NDEBUG
   LOG_INFO(-1, "VOL REQUEST Wait");
 #endif
+  if (is_prefetch_request(o))
+    return wait_prefetch_request(o, timeout, status);
 
   ret_value =
       H5VLrequest_wait(o->under_object, o->under_vol_id, timeout, status);
@@ -2448,42 +4183,76 @@ static herr_t H5VL_cache_ext_dataset_read(size_t count, void *dset[],
   }
 
   H5VL_cache_ext_t *o = (H5VL_cache_ext_t *)dset[0];
+  cache_storage_t *LS = o->H5LS;
+  bool read_cache = false;
+  for (i = 0; i < count; i++)
+    read_cache = read_cache || ((H5VL_cache_ext_t *)dset[i])->read_cache;
 
 #ifndef NDEBUG
   LOG_INFO(-1, "VOL DATASET Read");
 #endif
-  if (o->read_cache) {
-    if (getenv("DATASET_PREFETCH_AT_OPEN") && o->read_cache &&
-        !strcmp(getenv("DATASET_PREFETCH_AT_OPEN"), "yes") &&
-        !o->H5DRMM->io->dset_cached)
-      H5VL_cache_ext_dataset_prefetch_wait(dset);
-#ifndef NDEBUG
-
-    LOG_DEBUG(-1,
-              "%d samples (cached); %zu samples (total); %d "
-              "(dataset cached?)",
-              o->H5DRMM->dset.ns_cached, o->H5DRMM->dset.ns_loc,
-              o->H5DRMM->io->dset_cached);
-#endif
-    if (!o->H5DRMM->io->dset_cached) {
-      ret_value =
-          H5VLdataset_read(count, obj, o->under_vol_id, mem_type_id,
-                           mem_space_id, file_space_id, plist_id, buf, req);
-      for (size_t i = 0; i < count; i++)
-        o->H5LS->cache_io_cls->write_data_to_cache2(
-            dset[i], mem_type_id[i], mem_space_id[i], file_space_id[i],
-            plist_id, buf[i], req);
-    } else {
-      for (size_t i = 0; i < count; i++)
-        ret_value = o->H5LS->cache_io_cls->read_data_from_cache(
-            dset[i], mem_type_id[i], mem_space_id[i], file_space_id[i],
-            plist_id, buf[i], req);
+  // no prefetch block is issued until the demand read is done
+  if (LS != NULL)
+    LS->demand_reads++;
+  if (read_cache) {
+    // each dataset is read according to the state of its own cache. A single
+    // request can be returned, so the reads of several datasets complete
+    // before the call returns
+    void **r = (count == 1) ? req : NULL;
+    ret_value = SUCCEED;
+    for (i = 0; i < count; i++) {
+      H5VL_cache_ext_t *d = (H5VL_cache_ext_t *)dset[i];
+      herr_t ret;
+      if (!d->read_cache) {
+        LS->demand_misses++;
+        ret = H5VLdataset_read(1, &obj[i], d->under_vol_id, &mem_type_id[i],
+                               &mem_space_id[i], &file_space_id[i], plist_id,
+                               &buf[i], r);
+      } else {
+        // the blocks of an asynchronous prefetch that landed are read from
+        // the cache; the others are read through it
+        progress_prefetch_async(d, false);
+#ifndef NDEBUG
+        LOG_DEBUG(-1,
+                  "%d samples (cached); %zu samples (total); %d "
+                  "(dataset cached?)",
+                  d->H5DRMM->dset.ns_cached, d->H5DRMM->dset.ns_loc,
+                  d->H5DRMM->io->dset_cached);
+#endif
+        if (!d->H5DRMM->io->dset_cached &&
+            d->H5LS->cache_io_cls->read_data_through_cache != NULL) {
+          ret = d->H5LS->cache_io_cls->read_data_through_cache(
+              d, mem_type_id[i], mem_space_id[i], file_space_id[i], plist_id,
+              buf[i], r);
+        } else if (!d->H5DRMM->io->dset_cached) {
+          LS->demand_misses++;
+          ret = H5VLdataset_read(1, &obj[i], d->under_vol_id, &mem_type_id[i],
+                                 &mem_space_id[i], &file_space_id[i],
+                                 plist_id, &buf[i], r);
+          d->H5LS->cache_io_cls->write_data_to_cache2(
+              d, mem_type_id[i], mem_space_id[i], file_space_id[i], plist_id,
+              buf[i], r);
+        } else {
+          ret = d->H5LS->cache_io_cls->read_data_from_cache(
+              d, mem_type_id[i], mem_space_id[i], file_space_id[i], plist_id,
+              buf[i], r);
+        }
+      }
+      if (ret < 0)
+        ret_value = FAIL;
     }
   } else {
+    if (LS != NULL)
+      LS->demand_misses++;
     ret_value =
         H5VLdataset_read(count, obj, o->under_vol_id, mem_type_id, mem_space_id,
                          file_space_id, plist_id, buf, req);
   }
+  // the prefetches resume once the demand read is done
+  if (LS != NULL) {
+    LS->demand_reads--;
+    progress_all_prefetch_async(LS);
+  }
   /* Check for async request */
   if (req && *req)
     *req = H5VL_cache_ext_new_obj(*req,
@@ -2493,18 +4262,308 @@ static herr_t H5VL_cache_ext_dataset_read(size_t count, void *dset[],
   return ret_value;
 } /* end H5VL_cache_ext_dataset_read() */
 
-/* Waiting for the dataset write task to finish to free up cache space
+static herr_t merge_tasks_in_queue(task_data_t **task_list, int ntasks);
+
+/* The write buffer is used as a ring: each task holds the pages of its data
+ * from its offset, the tasks are allocated one after the other in the order
+ * of the queue, and wrap around to the beginning of the buffer when the end
+ * is reached. The tasks from current_request (the oldest task not released)
+ * to request_list (the place holder of the next task) hold the range of the
+ * ring from the offset of current_request (head) to mmap->offset (tail). */
+
+/* update the space left in the write buffer from the head and the tail of
+ * the ring; once no task holds the buffer, the ring restarts at offset 0 */
+static void update_write_buffer_space(io_handler_t *wmm) {
+  IO_THREAD *io = wmm->io;
+  hsize_t total = wmm->cache->mspace_per_rank_total;
+  if (io->current_request == io->request_list) {
+    wmm->mmap->offset = 0;
+    wmm->cache->mspace_per_rank_left = total;
+    return;
+  }
+  hsize_t head = io->current_request->offset, tail = wmm->mmap->offset;
+  // when the ring wrapped, the pages after the last task until the end of the
+  // buffer are only reused once the head wraps too
+  wmm->cache->mspace_per_rank_left =
+      (tail > head) ? total - (tail - head) : head - tail;
+}
+
+/* find a contiguous range of size bytes of the write buffer that no task
+ * holds: after the tail, or at the beginning of the buffer before the head */
+static bool get_write_buffer_range(io_handler_t *wmm, hsize_t size,
+                                   hsize_t *start) {
+  IO_THREAD *io = wmm->io;
+  hsize_t total = wmm->cache->mspace_per_rank_total;
+  hsize_t tail = wmm->mmap->offset;
+  *start = 0;
+  if (io->current_request == io->request_list)
+    return size <= total;
+  hsize_t head = io->current_request->offset;
+  if (tail > head) {
+    if (total - tail >= size) {
+      *start = tail;
+      return true;
+    }
+    return size <= head;
+  }
+  // the ring wrapped; it is full if the tail caught up with the head
+  *start = tail;
+  return tail < head && head - tail >= size;
+}
+
+/* drop the pages of the write buffer released by the oldest task, from the
+ * head of the ring to the offset of the next task (or the tail) */
+static void release_write_buffer_pages(H5VL_cache_ext_t *o, task_data_t *t) {
+  io_handler_t *wmm = o->H5DWMM;
+  const H5LS_mmap_class_t *cls = o->H5LS->mmap_cls;
+  hsize_t total = wmm->cache->mspace_per_rank_total;
+  if (cls->release_write_mmap == NULL || !strcmp(o->H5LS->scope, "GLOBAL") ||
+      t->size == 0)
+    return;
+  hsize_t head = t->offset;
+  hsize_t next =
+      (t->next == wmm->io->request_list) ? wmm->mmap->offset : t->next->offset;
+  if (next > head) {
+    cls->release_write_mmap(wmm->mmap, head, next - head);
+  } else {
+    cls->release_write_mmap(wmm->mmap, head, total - head);
+    cls->release_write_mmap(wmm->mmap, 0, next);
+  }
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    release_write_task
+ *
+ * Purpose:     Wait for the oldest task of the write queue of a file to be
+ *              flushed to the storage layer below, release the resources of
+ *              the task and its range of the write buffer.
+ *
+ * Return:      None
+ *
+ *-------------------------------------------------------------------------
+ */
+static void release_write_task(H5VL_cache_ext_t *o) {
+  IO_THREAD *io = o->H5DWMM->io;
+  task_data_t *t = io->current_request;
+  H5VL_request_status_t status;
+  double t0 = MPI_Wtime();
+  if (t->req != NULL) {
+    H5async_start(t->req);
+    H5VLrequest_wait(t->req, o->under_vol_id, INF, &status);
+  }
+  if (t->buf != NULL) {
+    free(t->buf);
+    free(t->merged_buf);
+    t->buf = NULL;
+    for (int i = 0; i < t->count; i++) {
+      H5Tclose(t->mem_type_id[i]);
+      H5Sclose(t->mem_space_id[i]);
+      H5Sclose(t->file_space_id[i]);
+    }
+    H5Pclose(t->xfer_plist_id);
+    free(t->mem_type_id);
+    free(t->mem_space_id);
+    free(t->file_space_id);
+  }
+#ifndef NDEBUG
+  LOG_DEBUG(-1, "Task %d (%ld merged) finished; wait time: %.5f", t->id,
+            t->count, MPI_Wtime() - t0);
+#endif
+  io->num_request--;
+  ((H5VL_cache_ext_t *)t->dataset_obj[0])->num_request_dataset--;
+  release_write_buffer_pages(o, t);
+  io->current_request = t->next;
+  update_write_buffer_space(o->H5DWMM);
+}
+
+/* merge the tasks of the write queue waiting to be fused, and flush them */
+static herr_t flush_fused_write_tasks(H5VL_cache_ext_t *o) {
+  IO_THREAD *io = o->H5DWMM->io;
+  herr_t ret_value;
+  if (io->num_fusion_requests == 0)
+    return SUCCEED;
+  merge_tasks_in_queue(&io->flush_request, io->num_fusion_requests);
+  ret_value = o->H5LS->cache_io_cls->flush_data_from_cache(io->flush_request,
+                                                           NULL);
+  io->num_fusion_requests = 0;
+  io->fusion_data_size = 0.0;
+  io->flush_request = io->flush_request->next;
+  return ret_value;
+}
+
+/* timer of a file, flushing the tasks waiting to be fused once the oldest
+ * one was queued flush_max_age seconds ago, or once no write was made for
+ * flush_idle seconds */
+typedef struct _flush_timer_t {
+  H5VL_cache_ext_t *file;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  bool stop;
+} flush_timer_t;
+
+/* whether the tasks waiting to be fused are due to be flushed */
+static bool fused_write_tasks_due(H5VL_cache_ext_t *o, double now) {
+  IO_THREAD *io = o->H5DWMM->io;
+  cache_storage_t *LS = o->H5LS;
+  if (io->num_fusion_requests == 0)
+    return false;
+  return (LS->flush_max_age > 0 && now - io->fusion_time >= LS->flush_max_age) ||
+         (LS->flush_idle > 0 && now - io->write_time >= LS->flush_idle);
+}
+
+/* whether a transfer property list asks for collective I/O */
+static bool is_collective_transfer(hid_t dxpl_id) {
+  H5FD_mpio_xfer_t mode;
+  return dxpl_id > 0 && H5Pget_dxpl_mpio(dxpl_id, &mode) >= 0 &&
+         mode == H5FD_MPIO_COLLECTIVE;
+}
+
+/* whether some of the tasks waiting to be fused are collective writes; the
+ * timer leaves them to the next write, where the ranks agree on the flush */
+static bool fused_write_tasks_collective(IO_THREAD *io) {
+  task_data_t *t = io->flush_request;
+  int i;
+  for (i = 0; i < io->num_fusion_requests && t != NULL; i++, t = t->next)
+    if (is_collective_transfer(t->xfer_plist_id))
+      return true;
+  return false;
+}
+
+static bool flush_timer_stopped(flush_timer_t *t) {
+  pthread_mutex_lock(&t->lock);
+  bool stop = t->stop;
+  pthread_mutex_unlock(&t->lock);
+  return stop;
+}
+
+/* the write queue is only changed with the global lock of the library held:
+ * by the callbacks of the connector, called from the HDF5 API, and by the
+ * timer, which takes the lock before looking at the queue */
+static void *flush_timer_main(void *arg) {
+  flush_timer_t *t = (flush_timer_t *)arg;
+  cache_storage_t *LS = t->file->H5LS;
+  double period = LS->flush_max_age;
+  if (period <= 0 || (LS->flush_idle > 0 && LS->flush_idle < period))
+    period = LS->flush_idle;
+  // check a few times per period, at most every second
+  period = period / 4;
+  if (period > 1.0)
+    period = 1.0;
+  if (period < 0.001)
+    period = 0.001;
+  while (true) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += (time_t)period;
+    ts.tv_nsec += (long)((period - (time_t)period) * 1e9);
+    if (ts.tv_nsec >= 1000000000L) {
+      ts.tv_sec++;
+      ts.tv_nsec -= 1000000000L;
+    }
+    pthread_mutex_lock(&t->lock);
+    if (!t->stop)
+      pthread_cond_timedwait(&t->cond, &t->lock, &ts);
+    bool stop = t->stop;
+    pthread_mutex_unlock(&t->lock);
+    if (stop)
+      break;
+    hbool_t acquired = false;
+    unsigned int count = 1;
+    while (!acquired && !flush_timer_stopped(t)) {
+      H5TSmutex_acquire(1, &acquired);
+      if (!acquired)
+        usleep(1000);
+    }
+    if (!acquired)
+      break;
+    // the clocks of the ranks differ, a flush on time is only made by the
+    // ranks alone for independent writes
+    if (fused_write_tasks_due(t->file, MPI_Wtime()) &&
+        !fused_write_tasks_collective(t->file->H5DWMM->io)) {
+#ifndef NDEBUG
+      LOG_DEBUG(-1, "flushing %d fused task(s) on time",
+                t->file->H5DWMM->io->num_fusion_requests);
+#endif
+      flush_fused_write_tasks(t->file);
+    }
+    H5TSmutex_release(&count);
+  }
+  return NULL;
+}
 
-   Data will be copied from the write buffer to the cache storage space until
-   the designated cache buffer size is filled. Then we will start flushing the
-   data from the write buffer and wait until all the outstanding request to
-   finish so that we can override the data in the cache buffer.
+/* start the flush timer of a file, if the writes are fused and a maximum
+ * age or idle time is set. The timer takes the global lock of the library
+ * and flushes through MPI-IO from its own thread, so it needs a thread-safe
+ * build of HDF5 and MPI_THREAD_MULTIPLE */
+static void start_flush_timer(H5VL_cache_ext_t *file) {
+  cache_storage_t *LS = file->H5LS;
+  IO_THREAD *io = file->H5DWMM->io;
+  hbool_t threadsafe = false;
+  int provided = MPI_THREAD_SINGLE;
+  io->fusion_time = io->write_time = MPI_Wtime();
+  io->flush_timer = NULL;
+  if (LS->fusion_threshold == 0.0 ||
+      (LS->flush_max_age <= 0 && LS->flush_idle <= 0))
+    return;
+  if (H5is_library_threadsafe(&threadsafe) < 0 || !threadsafe) {
+    LOG_WARN(-1, "HDF5 is not thread-safe, no flush timer; the fused writes "
+                 "are only flushed on time at the next write");
+    return;
+  }
+  if (MPI_Query_thread(&provided) != MPI_SUCCESS ||
+      provided < MPI_THREAD_MULTIPLE) {
+    LOG_WARN(-1, "MPI is not initialized with MPI_THREAD_MULTIPLE, no flush "
+                 "timer; the fused writes are only flushed on time at the "
+                 "next write");
+    return;
+  }
+  flush_timer_t *t = (flush_timer_t *)malloc(sizeof(flush_timer_t));
+  t->file = file;
+  t->stop = false;
+  pthread_mutex_init(&t->lock, NULL);
+  pthread_cond_init(&t->cond, NULL);
+  if (pthread_create(&t->thread, NULL, flush_timer_main, t) != 0) {
+    LOG_WARN(-1, "could not start the flush timer; the fused writes are only "
+                 "flushed by size");
+    pthread_mutex_destroy(&t->lock);
+    pthread_cond_destroy(&t->cond);
+    free(t);
+    return;
+  }
+  io->flush_timer = t;
+}
 
-   Change Log:
-    - May 1, 2023: Huihuo Zheng simplified the algorithm to flush the entire
-   buffer all at once. Further optimization might be possible but might
-   introduce complexity.
+/* stop the flush timer of a file; called with the global lock held */
+static void stop_flush_timer(H5VL_cache_ext_t *file) {
+  flush_timer_t *t = (flush_timer_t *)file->H5DWMM->io->flush_timer;
+  if (t == NULL)
+    return;
+  pthread_mutex_lock(&t->lock);
+  t->stop = true;
+  pthread_cond_signal(&t->cond);
+  pthread_mutex_unlock(&t->lock);
+  pthread_join(t->thread, NULL);
+  pthread_mutex_destroy(&t->lock);
+  pthread_cond_destroy(&t->cond);
+  free(t);
+  file->H5DWMM->io->flush_timer = NULL;
+}
 
+/*-------------------------------------------------------------------------
+ * Function:    free_cache_space_from_dataset
+ *
+ * Purpose:     Make room in the write buffer for a write of size bytes. The
+ *              oldest tasks of the queue are waited for and released one at
+ *              a time, until a contiguous range of the ring is free, so that
+ *              a write only waits for the tasks whose pages it reuses, while
+ *              the later tasks are still being flushed. On success, the
+ *              write goes to the tail of the ring (mmap->offset).
+ *
+ * Return:      Success:    0
+ *              Failure:    -1, the write does not fit in the write buffer
+ *
+ *-------------------------------------------------------------------------
  */
 static herr_t free_cache_space_from_dataset(void *dset, hsize_t size) {
   H5VL_cache_ext_t *o = (H5VL_cache_ext_t *)dset;
@@ -2519,7 +4578,9 @@ static herr_t free_cache_space_from_dataset(void *dset, hsize_t size) {
   if (under_value != H5VL_ASYNC_VALUE) {
     return SUCCEED;
   }
-  if (o->H5DWMM->cache->mspace_per_rank_total < size) {
+  io_handler_t *wmm = o->H5DWMM;
+  hsize_t start, need = round_page(size);
+  if (wmm->cache->mspace_per_rank_total < need) {
 
     LOG_WARN(-1,
              "**WARNING: size of the dataset to be written exceeds "
@@ -2527,79 +4588,208 @@ static herr_t free_cache_space_from_dataset(void *dset, hsize_t size) {
              "the write buffer size specified; "
              "             try to increase HDF5_CACHE_WRITE_BUFFER_SIZE to at "
              "least %d",
-             size * o->H5DWMM->mpi->ppn);
+             size * wmm->mpi->ppn);
 
     return FAIL;
   }
-  if (o->H5DWMM->cache->mspace_per_rank_left > size) {
-    LOG_DEBUG(-1, "left, %ld(l) %ld(s) %ld(o)\n",
-              o->H5DWMM->cache->mspace_per_rank_left, size,
-              o->H5DWMM->mmap->offset);
-    return SUCCEED;
+  while (!get_write_buffer_range(wmm, need, &start)) {
+#ifndef NDEBUG
+    LOG_DEBUG(-1,
+              "request wait(jobid: %d), current available space: "
+              "%.5f GiB ",
+              wmm->io->current_request->id,
+              wmm->cache->mspace_per_rank_left / 1024. / 1024. / 1024);
+#endif
+    // the oldest tasks may still wait to be fused, flush them first
+    if (wmm->io->current_request == wmm->io->flush_request &&
+        flush_fused_write_tasks(o) < 0)
+      return FAIL;
+    release_write_task(o);
+  }
+  wmm->mmap->offset = start;
+  update_write_buffer_space(wmm);
+#ifndef NDEBUG
+  LOG_DEBUG(-1, "left, %ld(l) %ld(s) %ld(o)", wmm->cache->mspace_per_rank_left,
+            size, wmm->mmap->offset);
+#endif
+  return SUCCEED;
+}
+void create_task_place_holder(task_data_t **request_list) {
+  task_data_t *t = *request_list;
+  t->next = (task_data_t *)malloc(sizeof(task_data_t));
+  t->next->req = NULL;
+  t->next->id = t->id + 1;
+  *request_list = t->next;
+  ((task_data_t *)*request_list)->previous = t;
+  (*request_list)->next = NULL;
+}
+
+/* a write whose file selection is a single block: rows [lo, hi] along the
+ * first dimension, and the same extent in the other dimensions */
+typedef struct _write_block_t {
+  int ndims;
+  hsize_t start[H5S_MAX_RANK];
+  hsize_t count[H5S_MAX_RANK];
+  hsize_t lo, hi;     // rows of the block (or of the coalesced blocks)
+  hsize_t row_size;   // bytes of a row in the memory datatype
+  int first;          // first write of the group of coalesced writes
+  int n;              // number of writes in the group
+  size_t offset;      // offset of the group in the staging buffer
+} write_block_t;
+
+/* get the block of a file selection; fails if the selection is not a
+ * single block */
+static herr_t get_write_block(hid_t fspace, hid_t mtype, write_block_t *b) {
+  hsize_t end[H5S_MAX_RANK], np = 1;
+  H5S_sel_type type = H5Sget_select_type(fspace);
+  int i;
+  b->ndims = H5Sget_simple_extent_ndims(fspace);
+  if (b->ndims < 1 || (type != H5S_SEL_HYPERSLABS && type != H5S_SEL_ALL) ||
+      H5Sget_select_bounds(fspace, b->start, end) < 0)
+    return FAIL;
+  for (i = 0; i < b->ndims; i++) {
+    b->count[i] = end[i] - b->start[i] + 1;
+    np *= b->count[i];
+  }
+  if ((hssize_t)np != H5Sget_select_npoints(fspace))
+    return FAIL;
+  b->lo = b->start[0];
+  b->hi = end[0];
+  b->row_size = np / b->count[0] * H5Tget_size(mtype);
+  return SUCCEED;
+}
+
+/* whether a block can be coalesced with a group: same extent in all the
+ * dimensions but the first, and rows adjacent to or overlapping the group */
+static bool is_coalescable(const write_block_t *g, const write_block_t *b) {
+  int i;
+  if (g->ndims != b->ndims || g->row_size != b->row_size)
+    return false;
+  for (i = 1; i < b->ndims; i++)
+    if (g->start[i] != b->start[i] || g->count[i] != b->count[i])
+      return false;
+  return b->lo <= g->hi + 1 && g->lo <= b->hi + 1;
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    coalesce_write_task
+ *
+ * Purpose:     Coalesce the writes of a (merged) task to the same dataset
+ *              whose file selections are blocks of rows adjacent to or
+ *              overlapping each other, with the same extent in the other
+ *              dimensions (e.g., one block of rows per time step): each
+ *              group of such writes becomes a single block, backed by a
+ *              range of one staging buffer (task->merged_buf) where the
+ *              data of the writes is copied in their order, so that the
+ *              later writes win where they overlap. A write is only
+ *              coalesced with the latest group of its dataset, so that the
+ *              order of the writes to the same data is kept.
+ *
+ * Return:      None
+ *
+ *-------------------------------------------------------------------------
+ */
+static void coalesce_write_task(task_data_t *t) {
+  size_t n = t->count, i, k, ngroup = 0, nbytes = 0;
+  write_block_t *blocks = (write_block_t *)malloc(sizeof(write_block_t) * n);
+  write_block_t *groups = (write_block_t *)malloc(sizeof(write_block_t) * n);
+  int *group = (int *)malloc(sizeof(int) * n);
+  bool coalesced = false;
+  for (i = 0; i < n; i++) {
+    bool block = get_write_block(t->file_space_id[i], t->mem_type_id[i],
+                                 &blocks[i]) >= 0;
+    int g = -1;
+    for (k = ngroup; k-- > 0;)
+      if (t->dataset_obj[groups[k].first] == t->dataset_obj[i]) {
+        g = k;
+        break;
+      }
+    if (block && g >= 0 && groups[g].n > 0 &&
+        H5Tequal(t->mem_type_id[groups[g].first], t->mem_type_id[i]) > 0 &&
+        is_coalescable(&groups[g], &blocks[i])) {
+      if (blocks[i].lo < groups[g].lo)
+        groups[g].lo = blocks[i].lo;
+      if (blocks[i].hi > groups[g].hi)
+        groups[g].hi = blocks[i].hi;
+      groups[g].n++;
+      group[i] = g;
+      coalesced = true;
+      continue;
+    }
+    groups[ngroup] = blocks[i];
+    groups[ngroup].first = i;
+    // a write that is not a block is never coalesced
+    groups[ngroup].n = block ? 1 : 0;
+    group[i] = ngroup++;
+  }
+  if (!coalesced) {
+    free(blocks);
+    free(groups);
+    free(group);
+    return;
+  }
+  for (k = 0; k < ngroup; k++)
+    if (groups[k].n > 1) {
+      groups[k].offset = nbytes;
+      nbytes += (groups[k].hi - groups[k].lo + 1) * groups[k].row_size;
+    }
+  char *staging = (char *)malloc(nbytes);
+  for (i = 0; i < n; i++) {
+    write_block_t *g = &groups[group[i]];
+    if (g->n > 1)
+      memcpy(staging + g->offset + (blocks[i].lo - g->lo) * g->row_size,
+             t->buf[i], (blocks[i].hi - blocks[i].lo + 1) * g->row_size);
+  }
+  // the first write of each group stands for the group
+  size_t m = 0;
+  for (i = 0; i < n; i++) {
+    write_block_t *g = &groups[group[i]];
+    if (g->n > 1 && g->first != (int)i) {
+      H5Tclose(t->mem_type_id[i]);
+      H5Sclose(t->mem_space_id[i]);
+      H5Sclose(t->file_space_id[i]);
+      continue;
+    }
+    if (g->n > 1) {
+      hsize_t np = (g->hi - g->lo + 1) * g->row_size /
+                   H5Tget_size(t->mem_type_id[i]);
+      g->start[0] = g->lo;
+      g->count[0] = g->hi - g->lo + 1;
+      H5Sselect_hyperslab(t->file_space_id[i], H5S_SELECT_SET, g->start, NULL,
+                          g->count, NULL);
+      H5Sclose(t->mem_space_id[i]);
+      t->mem_space_id[i] = H5Screate_simple(1, &np, NULL);
+      t->buf[i] = staging + g->offset;
+    }
+    t->dataset_obj[m] = t->dataset_obj[i];
+    t->mem_type_id[m] = t->mem_type_id[i];
+    t->mem_space_id[m] = t->mem_space_id[i];
+    t->file_space_id[m] = t->file_space_id[i];
+    t->buf[m] = t->buf[i];
+    m++;
   }
-  H5VL_request_status_t status;
 #ifndef NDEBUG
-  LOG_DEBUG(-1,
-            "request wait(jobid: %d), current available space: "
-            "%.5f GiB ",
-            o->H5DWMM->io->current_request->id,
-            o->H5DWMM->cache->mspace_per_rank_left / 1024. / 1024. / 1024);
-#endif
-  while ((o->H5DWMM->io->current_request != NULL &&
-          o->H5DWMM->io->current_request->req != NULL)) {
-    H5async_start(o->H5DWMM->io->current_request->req);
-    H5VLrequest_wait(o->H5DWMM->io->current_request->req, o->under_vol_id, INF,
-                     &status);
-    free(o->H5DWMM->io->current_request->buf);
-    for (int i = 0; i < o->H5DWMM->io->current_request->count; i++) {
-      H5Tclose(o->H5DWMM->io->current_request->mem_type_id[i]);
-      H5Sclose(o->H5DWMM->io->current_request->mem_space_id[i]);
-      H5Sclose(o->H5DWMM->io->current_request->file_space_id[i]);
-    }
-    H5Pclose(o->H5DWMM->io->current_request->xfer_plist_id);
-    free(o->H5DWMM->io->current_request->mem_type_id);
-    free(o->H5DWMM->io->current_request->mem_space_id);
-    free(o->H5DWMM->io->current_request->file_space_id);
-#ifndef NDEBUG
-    LOG_DEBUG(-1, "**Task %d (%ld merged) finished",
-              o->H5DWMM->io->current_request->id,
-              o->H5DWMM->io->current_request->count);
-#endif
-    o->H5DWMM->io->num_request--;
-    // for (size_t i = 0; i < o->H5DWMM->io->current_request->count; i++) {
-    H5VL_cache_ext_t *d =
-        (H5VL_cache_ext_t *)o->H5DWMM->io->current_request->dataset_obj[0];
-    d->num_request_dataset--;
-    //}
-    o->H5DWMM->io->current_request = o->H5DWMM->io->current_request->next;
-  }
-  o->H5DWMM->cache->mspace_per_rank_left =
-      o->H5DWMM->cache->mspace_per_rank_total;
-  o->H5DWMM->mmap->offset = 0;
-  if (o->H5DWMM->cache->mspace_per_rank_left >= size)
-    return SUCCEED;
-  else
-    return FAIL;
-}
-void create_task_place_holder(task_data_t **request_list) {
-  task_data_t *t = *request_list;
-  t->next = (task_data_t *)malloc(sizeof(task_data_t));
-  t->next->req = NULL;
-  t->next->id = t->id + 1;
-  *request_list = t->next;
-  ((task_data_t *)*request_list)->previous = t;
-  (*request_list)->next = NULL;
+  LOG_DEBUG(-1, "Coalesced %zu writes into %zu", n, m);
+#endif
+  t->count = m;
+  t->merged_buf = staging;
+  free(blocks);
+  free(groups);
+  free(group);
 }
 
 /*
   This function is to merge many tasks into a single one.
-  This is possible because of multi dataset API
+  This is possible because of multi dataset API. The writes of the merged
+  task to the same dataset are then coalesced (see coalesce_write_task).
 */
 static herr_t merge_tasks_in_queue(task_data_t **task_list, int ntasks) {
   double t0 = MPI_Wtime();
   task_data_t *t_com = (task_data_t *)malloc(sizeof(task_data_t));
   t_com->req = NULL;
   t_com->count = 0;
+  t_com->size = 0;
+  t_com->merged_buf = NULL;
   // find out the total number of requests if it is not given
   task_data_t *r = *task_list;
   if (ntasks == -1) {
@@ -2608,9 +4798,11 @@ static herr_t merge_tasks_in_queue(task_data_t **task_list, int ntasks) {
       ntasks++;
       r = r->next;
     }
+    r = *task_list;
   }
   for (int i = 0; i < ntasks; i++) {
     t_com->count += r->count;
+    t_com->size += r->size;
     r = r->next;
   }
 
@@ -2622,9 +4814,8 @@ static herr_t merge_tasks_in_queue(task_data_t **task_list, int ntasks) {
   t_com->mem_type_id = (hid_t *)malloc(sizeof(hid_t) * t_com->count);
   t_com->buf = (void **)malloc(sizeof(void *) * t_com->count);
   // copy data
-  t_com->next = r;
-  t_com->offset = r->offset; // we assume that the offset is contiguous for the
-                             // nearby write requests.
+  t_com->previous = r->previous;
+  t_com->offset = r->offset; // offset of the first task in the write buffer
   t_com->id = r->id;
 #ifndef NDEBUG
 
@@ -2637,13 +4828,20 @@ static herr_t merge_tasks_in_queue(task_data_t **task_list, int ntasks) {
   for (int i = 0; i < ntasks; i++) {
     for (int j = 0; j < r->count; j++) {
       t_com->dataset_obj[off + j] = r->dataset_obj[j];
-      t_com->file_space_id[off + j] = H5Scopy(r->file_space_id[j]);
-      t_com->mem_space_id[off + j] = H5Scopy(r->mem_space_id[j]);
-      t_com->mem_type_id[off + j] = H5Tcopy(r->mem_type_id[j]);
+      t_com->file_space_id[off + j] = r->file_space_id[j];
+      t_com->mem_space_id[off + j] = r->mem_space_id[j];
+      t_com->mem_type_id[off + j] = r->mem_type_id[j];
       t_com->buf[off + j] = r->buf[j];
     }
-    r = r->next;
     off += r->count;
+    // the selections and the datatypes now belong to the merged task
+    H5Pclose(r->xfer_plist_id);
+    free(r->dataset_obj);
+    free(r->file_space_id);
+    free(r->mem_space_id);
+    free(r->mem_type_id);
+    free(r->buf);
+    r = r->next;
   }
   // free memory of all the nodes of ntasks
   task_data_t *p = ((task_data_t *)*task_list)->next;
@@ -2653,6 +4851,11 @@ static herr_t merge_tasks_in_queue(task_data_t **task_list, int ntasks) {
     free(r);
   }
   t_com->next = p;
+  if (p != NULL)
+    p->previous = *task_list;
+  if (strcmp(((H5VL_cache_ext_t *)t_com->dataset_obj[0])->H5LS->scope,
+             "GLOBAL"))
+    coalesce_write_task(t_com);
   memcpy(*task_list, t_com, sizeof(task_data_t));
   free(t_com);
   double t1 = MPI_Wtime();
@@ -2664,7 +4867,8 @@ static herr_t merge_tasks_in_queue(task_data_t **task_list, int ntasks) {
 }
 /*
   This is to add current task to the request-list, and return a reference to the
-  current request.
+  current request. Fails, leaving the queue as it was, if the data could not be
+  copied to the write buffer.
  */
 static herr_t
 add_current_write_task_to_queue(size_t count, void *dset[], hid_t mem_type_id[],
@@ -2686,6 +4890,15 @@ add_current_write_task_to_queue(size_t count, void *dset[], hid_t mem_type_id[],
         o->H5LS->cache_io_cls->write_data_to_cache(
             dset[i], mem_type_id[i], mem_space_id[i], file_space_id[i],
             plist_id, buf[i], NULL);
+  // the data of the global storage goes to the cache file, not to a buffer
+  if (strcmp(o->H5LS->scope, "GLOBAL"))
+    for (i = 0; i < count; i++)
+      if (o->H5DWMM->io->request_list->buf[i] == NULL) {
+        LOG_WARN(-1, "failed to copy the data to the write buffer");
+        free(o->H5DWMM->io->request_list->buf);
+        o->H5DWMM->io->request_list->buf = NULL;
+        return FAIL;
+      }
 
   hsize_t size = 0;
   for (i = 0; i < count; i++) {
@@ -2695,18 +4908,9 @@ add_current_write_task_to_queue(size_t count, void *dset[], hid_t mem_type_id[],
 
   o->H5DWMM->io->request_list->offset = o->H5DWMM->mmap->offset;
   o->H5DWMM->mmap->offset += round_page(size);
-  o->H5DWMM->cache->mspace_per_rank_left =
-      o->H5DWMM->cache->mspace_per_rank_left - round_page(size);
-#ifndef NDEBUG
-  LOG_DEBUG(-1,
-            "offset, space left (per rank), total storage (per rank) "
-            "%lu, %lu, %lu",
-            o->H5DWMM->mmap->offset, o->H5DWMM->cache->mspace_per_rank_left,
-            o->H5DWMM->cache->mspace_per_rank_total);
-
-#endif
   o->H5DWMM->io->request_list->count = count;
   task_data_t *r = (task_data_t *)o->H5DWMM->io->request_list;
+  r->merged_buf = NULL;
   r->dataset_obj =
       (void **)calloc(count, sizeof(void *)); // freed after request_wait
   r->mem_type_id = (hid_t *)calloc(count, sizeof(hid_t));
@@ -2731,6 +4935,16 @@ add_current_write_task_to_queue(size_t count, void *dset[], hid_t mem_type_id[],
   o->H5DWMM->io->request_list->size = size;
   // create a new task place holder for next job
   create_task_place_holder(&o->H5DWMM->io->request_list);
+  if (strcmp(o->H5LS->scope, "GLOBAL"))
+    update_write_buffer_space(o->H5DWMM);
+#ifndef NDEBUG
+  LOG_DEBUG(-1,
+            "offset, space left (per rank), total storage (per rank) "
+            "%lu, %lu, %lu",
+            o->H5DWMM->mmap->offset, o->H5DWMM->cache->mspace_per_rank_left,
+            o->H5DWMM->cache->mspace_per_rank_total);
+
+#endif
   return SUCCEED;
 }
 
@@ -2797,8 +5011,20 @@ H5VL_cache_ext_dataset_write(size_t count, void *dset[], hid_t mem_type_id[],
         ((H5VL_cache_ext_t *)dset[0])->H5DWMM->mmap->offset +
             ((H5VL_cache_ext_t *)dset[0])->H5DWMM->cache->mspace_per_rank_left,
         ((H5VL_cache_ext_t *)dset[0])->H5DWMM->cache->mspace_per_rank_total);
-    ret_value = add_current_write_task_to_queue(
-        count, dset, mem_type_id, mem_space_id, file_space_id, plist_id, buf);
+    if (add_current_write_task_to_queue(count, dset, mem_type_id,
+                                        mem_space_id, file_space_id, plist_id,
+                                        buf) < 0) {
+      // the writes queued before are flushed first, to keep them in order
+      flush_fused_write_tasks(o);
+      ret_value = H5VLdataset_write(count, obj, o->under_vol_id, mem_type_id,
+                                    mem_space_id, file_space_id, plist_id, buf,
+                                    req);
+      if (req && *req)
+        *req = H5VL_cache_ext_new_obj(*req, o->under_vol_id);
+      if (obj != &obj_local)
+        free(obj);
+      return ret_value;
+    }
 #ifndef NDEBUG
 
     LOG_DEBUG(-1, "added task %d to queue",
@@ -2811,7 +5037,20 @@ H5VL_cache_ext_dataset_write(size_t count, void *dset[], hid_t mem_type_id[],
           o->H5DWMM->io->flush_request, req); // flush data for current task;
       o->H5DWMM->io->flush_request = o->H5DWMM->io->flush_request->next;
     } else {
-      if (o->H5DWMM->io->fusion_data_size + size >= o->H5LS->fusion_threshold) {
+      // the fused tasks are flushed by size, or by the age of the oldest
+      double now = MPI_Wtime();
+      if (o->H5DWMM->io->num_fusion_requests == 0)
+        o->H5DWMM->io->fusion_time = now;
+      int flush =
+          o->H5DWMM->io->fusion_data_size + size >= o->H5LS->fusion_threshold ||
+          fused_write_tasks_due(o, now);
+      // the clocks of the ranks differ: for collective writes, the ranks
+      // agree on the flush, so that they make the same collective writes
+      if ((o->H5LS->flush_max_age > 0 || o->H5LS->flush_idle > 0) &&
+          is_collective_transfer(plist_id))
+        MPI_Allreduce(MPI_IN_PLACE, &flush, 1, MPI_INT, MPI_MAX,
+                      o->H5DWMM->mpi->comm);
+      if (flush) {
         if (o->H5DWMM->io->num_fusion_requests > 0)
           merge_tasks_in_queue(&o->H5DWMM->io->flush_request,
                                o->H5DWMM->io->num_fusion_requests + 1);
@@ -2825,6 +5064,7 @@ H5VL_cache_ext_dataset_write(size_t count, void *dset[], hid_t mem_type_id[],
         o->H5DWMM->io->fusion_data_size += size;
       }
     }
+    o->H5DWMM->io->write_time = MPI_Wtime();
   } else {
     ret_value = H5VLdataset_write(
         count, obj, ((H5VL_cache_ext_t *)dset[0])->under_vol_id, mem_type_id,
@@ -2932,6 +5172,8 @@ static herr_t H5VL_cache_ext_dataset_optional(void *obj,
 #endif
   /* Sanity check */
   assert(-1 != H5VL_cache_dataset_prefetch_op_g);
+  assert(-1 != H5VL_cache_dataset_prefetch_schedule_op_g);
+  assert(-1 != H5VL_cache_dataset_prefetch_status_op_g);
   assert(-1 != H5VL_cache_dataset_read_to_cache_op_g);
   assert(-1 != H5VL_cache_dataset_read_from_cache_op_g);
   assert(-1 != H5VL_cache_dataset_mmap_remap_op_g);
@@ -2944,8 +5186,28 @@ static herr_t H5VL_cache_ext_dataset_optional(void *obj,
   if (args->op_type == H5VL_cache_dataset_prefetch_op_g) {
     H5VL_cache_ext_dataset_prefetch_args_t *opt_args = args->args;
 
-    ret_value = H5VL_cache_ext_dataset_prefetch(obj, opt_args->file_space_id,
-                                                dxpl_id, req);
+    // with an event set (H5Dprefetch_async), the prefetch goes on in the
+    // background, and its request completes once all its blocks landed
+    if (req == NULL || !o->read_cache)
+      ret_value = H5VL_cache_ext_dataset_prefetch(obj, opt_args->file_space_id,
+                                                  dxpl_id, req);
+    else {
+      ret_value = H5VL_cache_ext_dataset_prefetch_async(
+          obj, opt_args->file_space_id, dxpl_id);
+      if (o->prefetch_req != NULL)
+        *req = new_prefetch_request(o);
+      return ret_value;
+    }
+  } else if (args->op_type == H5VL_cache_dataset_prefetch_status_op_g) {
+    H5VL_cache_ext_dataset_prefetch_status_args_t *opt_args = args->args;
+
+    ret_value = H5VL_cache_ext_dataset_prefetch_status(
+        obj, opt_args->bytes_done, opt_args->bytes_total);
+  } else if (args->op_type == H5VL_cache_dataset_prefetch_schedule_op_g) {
+    H5VL_cache_ext_dataset_prefetch_schedule_args_t *opt_args = args->args;
+
+    ret_value = H5VL_cache_ext_dataset_prefetch_schedule(
+        obj, opt_args->indices, opt_args->n, opt_args->batch_size, dxpl_id);
   } else if (args->op_type == H5VL_cache_dataset_read_to_cache_op_g) {
     H5VL_cache_ext_dataset_read_to_cache_args_t *opt_args = args->args;
 
@@ -3034,53 +5296,10 @@ static herr_t H5VL_cache_ext_dataset_wait(void *dset) {
   }
 
   if (o->write_cache) {
-    double available = o->H5DWMM->cache->mspace_per_rank_left;
-    H5VL_request_status_t status;
     while ((o->num_request_dataset > 0) &&
            (o->H5DWMM->io->current_request != NULL &&
-            o->H5DWMM->io->current_request->req != NULL)) {
-      double t0 = MPI_Wtime();
-      assert(o->H5DWMM->io->current_request->req != NULL);
-#ifndef NDEBUG
-
-      LOG_DEBUG(-1, "Waiting for Task %d to finish",
-                o->H5DWMM->io->current_request->id);
-
-      H5async_start(o->H5DWMM->io->current_request->req);
-      H5VLrequest_wait(o->H5DWMM->io->current_request->req, o->under_vol_id,
-                       INF, &status);
-#endif
-      if (o->H5DWMM->io->current_request->buf != NULL &&
-          (strcmp(o->H5LS->scope, "GLOBAL"))) {
-        free(o->H5DWMM->io->current_request->buf);
-        o->H5DWMM->io->current_request->buf = NULL;
-        for (int i = 0; i < o->H5DWMM->io->current_request->count; i++) {
-          H5Tclose(o->H5DWMM->io->current_request->mem_type_id[i]);
-          H5Sclose(o->H5DWMM->io->current_request->mem_space_id[i]);
-          H5Sclose(o->H5DWMM->io->current_request->file_space_id[i]);
-        }
-        H5Pclose(o->H5DWMM->io->current_request->xfer_plist_id);
-        free(o->H5DWMM->io->current_request->mem_type_id);
-        free(o->H5DWMM->io->current_request->mem_space_id);
-        free(o->H5DWMM->io->current_request->file_space_id);
-      }
-      double t1 = MPI_Wtime();
-#ifndef NDEBUG
-      LOG_DEBUG(-1, "H5VLreqeust_wait time (jobid: %d): %f",
-                o->H5DWMM->io->current_request->id, t1 - t0);
-
-      LOG_DEBUG(-1, "Tasks %d(%ld merged) finished",
-                o->H5DWMM->io->current_request->id,
-                o->H5DWMM->io->current_request->count);
-#endif
-      o->H5DWMM->io->num_request--;
-      // for (size_t i = 0; i < o->H5DWMM->io->current_request->count; i++) {
-      H5VL_cache_ext_t *d =
-          (H5VL_cache_ext_t *)o->H5DWMM->io->current_request->dataset_obj[0];
-      d->num_request_dataset--;
-      //}
-      o->H5DWMM->io->current_request = o->H5DWMM->io->current_request->next;
-    }
+            o->H5DWMM->io->current_request->req != NULL))
+      release_write_task(o);
   }
   if (o->write_cache || o->read_cache) {
     double t0 = MPI_Wtime();
@@ -3105,51 +5324,10 @@ static herr_t H5VL_cache_ext_file_wait(void *file) {
   LOG_INFO(-1, "File wait");
 #endif
   if (o->write_cache) {
-    if (o->H5DWMM->io->num_fusion_requests > 0) {
-      merge_tasks_in_queue(&o->H5DWMM->io->flush_request,
-                           o->H5DWMM->io->num_fusion_requests);
-      o->H5LS->cache_io_cls->flush_data_from_cache(
-          o->H5DWMM->io->flush_request, NULL); // flush data for current task;
-      o->H5DWMM->io->num_fusion_requests = 0;
-      o->H5DWMM->io->fusion_data_size = 0.0;
-      o->H5DWMM->io->flush_request = o->H5DWMM->io->flush_request->next;
-    }
-    double available = o->H5DWMM->cache->mspace_per_rank_left;
-    H5VL_request_status_t status;
+    flush_fused_write_tasks(o);
     while ((o->H5DWMM->io->current_request != NULL) &&
-           (o->H5DWMM->io->num_request > 0)) {
-#ifndef NDEBUG
-      LOG_DEBUG(-1, "Waiting for job %d (%ld merged) to finish",
-                o->H5DWMM->io->current_request->id,
-                o->H5DWMM->io->current_request->count);
-#endif
-      H5async_start(o->H5DWMM->io->current_request->req);
-      H5VLrequest_wait(o->H5DWMM->io->current_request->req, o->under_vol_id,
-                       INF, &status);
-
-      free(o->H5DWMM->io->current_request->buf);
-      for (int i = 0; i < o->H5DWMM->io->current_request->count; i++) {
-        H5Tclose(o->H5DWMM->io->current_request->mem_type_id[i]);
-        H5Sclose(o->H5DWMM->io->current_request->mem_space_id[i]);
-        H5Sclose(o->H5DWMM->io->current_request->file_space_id[i]);
-      }
-      H5Pclose(o->H5DWMM->io->current_request->xfer_plist_id);
-      free(o->H5DWMM->io->current_request->mem_type_id);
-      free(o->H5DWMM->io->current_request->mem_space_id);
-      free(o->H5DWMM->io->current_request->file_space_id);
-#ifndef NDEBUG
-      LOG_DEBUG(-1, "Task %d (%lu merged) finished",
-                o->H5DWMM->io->current_request->id,
-                o->H5DWMM->io->current_request->count);
-#endif
-      o->H5DWMM->io->num_request--;
-      // for (size_t i = 0; i < o->H5DWMM->io->current_request->count; i++) {
-      H5VL_cache_ext_t *d =
-          (H5VL_cache_ext_t *)o->H5DWMM->io->current_request->dataset_obj[0];
-      d->num_request_dataset--;
-      //}
-      o->H5DWMM->io->current_request = o->H5DWMM->io->current_request->next;
-    }
+           (o->H5DWMM->io->num_request > 0))
+      release_write_task(o);
   }
   return 0;
 }
@@ -4765,8 +6943,7 @@ static void *H5VL_cache_ext_object_open(void *obj,
 #ifndef NDEBUG
             LOG_DEBUG(-1, "DATASET_PREFETCH_AT_OPEN = yes");
 #endif
-            H5VL_cache_ext_dataset_prefetch_async(
-                new_obj, args->space_id, dxpl_id, new_obj->prefetch_req);
+            H5VL_cache_ext_dataset_prefetch_async(new_obj, H5S_ALL, dxpl_id);
           }
         }
       }
@@ -5020,6 +7197,15 @@ static herr_t H5VL_cache_ext_request_notify(void *obj, H5VL_request_notify_t cb,
 #ifndef NDEBUG
   LOG_INFO(-1, "VOL REQUEST Notify");
 #endif
+  // the callback is invoked by the progress of the prefetch once all its
+  // blocks landed (or right away if they already did)
+  if (is_prefetch_request(o)) {
+    prefetch_async_t *pf = (prefetch_async_t *)o->prefetch_req;
+    pf->notify = cb;
+    pf->notify_ctx = ctx;
+    notify_prefetch_async(pf);
+    return SUCCEED;
+  }
 
   ret_value = H5VLrequest_notify(o->under_object, o->under_vol_id, cb, ctx);
 
@@ -5046,6 +7232,13 @@ static herr_t H5VL_cache_ext_request_cancel(void *obj,
 #ifndef NDEBUG
   LOG_INFO(-1, "VOL REQUEST Cancel");
 #endif
+  // the reads of a prefetch in flight can't be taken back
+  if (is_prefetch_request(o)) {
+    wait_prefetch_request(o, 0, status);
+    if (*status == H5VL_REQUEST_STATUS_IN_PROGRESS)
+      *status = H5VL_REQUEST_STATUS_CANT_CANCEL;
+    return SUCCEED;
+  }
 
   ret_value = H5VLrequest_cancel(o->under_object, o->under_vol_id, status);
 
@@ -5070,6 +7263,15 @@ H5VL_cache_ext_request_specific(void *obj, H5VL_request_specific_args_t *args) {
   LOG_INFO(-1, "VOL REQUEST Specific");
 #endif
   H5VL_cache_ext_t *o = (H5VL_cache_ext_t *)obj;
+  if (is_prefetch_request(o)) {
+    if (args->op_type == H5VL_REQUEST_GET_ERR_STACK)
+      args->args.get_err_stack.err_stack_id = H5Ecreate_stack();
+    else if (args->op_type == H5VL_REQUEST_GET_EXEC_TIME) {
+      *args->args.get_exec_time.exec_ts = 0;
+      *args->args.get_exec_time.exec_time = 0;
+    }
+    return SUCCEED;
+  }
 
   ret_value = H5VLrequest_specific(o->under_object, o->under_vol_id, args);
 
@@ -5094,6 +7296,8 @@ static herr_t H5VL_cache_ext_request_optional(void *obj,
 #ifndef NDEBUG
   LOG_INFO(-1, "VOL REQUEST Optional");
 #endif
+  if (is_prefetch_request(o))
+    return FAIL;
 
   ret_value = H5VLrequest_optional(o->under_object, o->under_vol_id, args);
 
@@ -5118,6 +7322,11 @@ static herr_t H5VL_cache_ext_request_free(void *obj) {
 #ifndef NDEBUG
   LOG_INFO(-1, "VOL REQUEST Free");
 #endif
+  // the prefetch itself goes on, and is completed by the dataset
+  if (is_prefetch_request(o)) {
+    release_prefetch_async((prefetch_async_t *)o->prefetch_req);
+    return H5VL_cache_ext_free_obj(o);
+  }
 
   ret_value = H5VLrequest_free(o->under_object, o->under_vol_id);
 
@@ -5448,6 +7657,7 @@ static herr_t create_file_cache_on_local_storage(void *obj, void *file_args,
 #endif
     }
 
+    file->H5DWMM->mmap->durability = file->H5LS->write_durability;
     file->H5LS->mmap_cls->create_write_mmap(file->H5DWMM->mmap,
                                             file->H5LS->write_buffer_size);
 
@@ -5465,6 +7675,7 @@ static herr_t create_file_cache_on_local_storage(void *obj, void *file_args,
     file->H5LS->cache_list = file->H5LS->cache_list->next;
     file->H5DWMM->io->offset_current = 0;
     file->H5DWMM->mmap->offset = 0;
+    start_flush_timer(file);
   }
 
   if (file->read_cache) {
@@ -5516,8 +7727,14 @@ static herr_t remove_file_cache_on_local_storage(void *file, void **req) {
   H5VL_cache_ext_t *o = (H5VL_cache_ext_t *)file;
   herr_t ret_value;
   if (o->write_cache) {
+    stop_flush_timer(o);
+    // the staged data is made durable once, when the file is closed
+    if (o->H5DWMM->mmap->durability == DURABILITY_CLOSE &&
+        o->H5LS->mmap_cls->sync_write_mmap != NULL)
+      o->H5LS->mmap_cls->sync_write_mmap(o->H5DWMM->mmap);
     H5VL_cache_ext_file_wait(file);
-    o->H5LS->mmap_cls->remove_write_mmap(o->H5DWMM->mmap, 0);
+    o->H5LS->mmap_cls->remove_write_mmap(o->H5DWMM->mmap,
+                                         o->H5LS->write_buffer_size);
     if (H5LSremove_cache(o->H5LS, o->H5DWMM->cache) != SUCCEED) {
 
       LOG_ERROR(-1, "Could not remove cache %s", o->H5DWMM->cache->path);
@@ -5533,7 +7750,7 @@ static herr_t remove_file_cache_on_local_storage(void *file, void **req) {
     o->H5DWMM = NULL;
   }
   if (o->read_cache && (!o->write_cache)) {
-    if (o->H5LS->io_node)
+    if (o->H5LS->io_node && !o->H5LS->persistent)
       o->H5LS->mmap_cls->removeCacheFolder(
           o->H5DRMM->cache->path); // remove the file
     /* free o->H5DRMM object. Notice that H5DWMM->cache has already been freed
@@ -5547,6 +7764,142 @@ static herr_t remove_file_cache_on_local_storage(void *file, void **req) {
   return SUCCEED;
 }
 
+/* name of the manifest of the cache of the rank, next to its cache file */
+static void get_manifest_name(io_handler_t *dmm, char *name) {
+  char *ext;
+  strcpy(name, dmm->mmap->fname);
+  ext = strrchr(name, '.');
+  strcpy((ext != NULL) ? ext : name + strlen(name), ".manifest");
+}
+
+/* checksum of the resident samples of the rank */
+static uint64_t checksum_resident_samples(io_handler_t *dmm) {
+  unsigned char *flags = get_residency_flags(dmm);
+  const char *p = (const char *)dmm->mmap->buf;
+  size_t ss = dmm->dset.sample.size, i;
+  uint64_t sum = 0;
+  for (i = 0; i < dmm->dset.ns_loc; i++)
+    if (flags[i])
+      sum = sum * 31 + checksum_fletcher32(p + i * ss, ss);
+  return sum;
+}
+
+/* manifest describing the cache of the rank for a dataset of a file; the
+ * modification time of the file is taken at open, so that a cache written
+ * by a job that modified the file is not adopted */
+static CACHE_MANIFEST *new_cache_manifest(H5VL_cache_ext_t *dset,
+                                          const char *file, const char *name) {
+  DSET *d = &dset->H5DRMM->dset;
+  CACHE_MANIFEST *m = (CACHE_MANIFEST *)calloc(1, sizeof(CACHE_MANIFEST));
+  char path[PATH_MAX];
+  struct stat sb;
+  // the jobs may open the file by different names (relative, links)
+  if (realpath(file, path) != NULL)
+    file = path;
+  memcpy(m->magic, CACHE_MANIFEST_MAGIC, sizeof(m->magic));
+  strncpy(m->file, file, sizeof(m->file) - 1);
+  strncpy(m->dset, name, sizeof(m->dset) - 1);
+  if (stat(file, &sb) == 0) {
+    m->file_mtime = sb.st_mtime;
+    m->file_size = sb.st_size;
+  }
+  m->nproc = dset->H5DRMM->mpi->nproc;
+  m->rank = dset->H5DRMM->mpi->rank;
+  m->ndims = d->ndims;
+  m->chunked = d->chunked;
+  memcpy(m->dims, d->dims, sizeof(hsize_t) * d->ndims);
+  if (d->chunked)
+    memcpy(m->chunk_dims, d->chunk_dims, sizeof(hsize_t) * d->ndims);
+  m->esize = d->esize;
+  m->ns_loc = d->ns_loc;
+  m->s_offset = d->s_offset;
+  return m;
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    adopt_persistent_cache
+ *
+ * Purpose:     Adopt the samples left in the cache file of the rank by a
+ *              previous job (HDF5_CACHE_PERSISTENT), if its manifest
+ *              matches the file, the dataset and the layout of the cache
+ *              and the checksum of the samples is correct. The manifest is
+ *              removed, as the cache changes from now on; it is written
+ *              again when the cache is closed. Collective.
+ *
+ * Return:      Number of samples adopted by the rank
+ *
+ *-------------------------------------------------------------------------
+ */
+static int64_t adopt_persistent_cache(H5VL_cache_ext_t *dset, const char *file,
+                                      const char *name) {
+  io_handler_t *dmm = dset->H5DRMM;
+  unsigned char *flags = get_residency_flags(dmm);
+  CACHE_MANIFEST old;
+  char mname[300];
+  int64_t nres = 0, total;
+  size_t i;
+  dmm->dset.manifest = new_cache_manifest(dset, file, name);
+  get_manifest_name(dmm, mname);
+  // the cache file left by the job (if any) is adopted, or overwritten
+  H5LSrelease_retained_cache(dset->H5LS, dmm->cache->path);
+  FILE *fp = fopen(mname, "rb");
+  if (fp != NULL) {
+    if (fread(&old, sizeof(old), 1, fp) == 1 &&
+        !memcmp(&old, dmm->dset.manifest, offsetof(CACHE_MANIFEST, checksum)) &&
+        fread(flags, 1, dmm->dset.ns_loc, fp) == dmm->dset.ns_loc &&
+        checksum_resident_samples(dmm) == old.checksum) {
+      for (i = 0; i < dmm->dset.ns_loc; i++)
+        nres += (flags[i] != 0);
+      if (claim_read_cache_space(dset, nres) < 0) {
+        LOG_WARN(-1, "cache storage is full; cache %s not adopted",
+                 dmm->mmap->fname);
+        memset(flags, 0, dmm->dset.ns_loc);
+        nres = 0;
+      }
+    } else {
+      LOG_WARN(-1, "cache %s does not match its manifest; not adopted",
+               dmm->mmap->fname);
+      memset(flags, 0, dmm->dset.ns_loc);
+    }
+    fclose(fp);
+    remove(mname);
+  }
+  read_cache_sync(dset);
+  count_cached_samples(dset, nres);
+  MPI_Allreduce(&nres, &total, 1, MPI_INT64_T, MPI_SUM, dmm->mpi->comm);
+  if (total >= (int64_t)dmm->dset.ns_glob) {
+    dmm->io->dset_cached = true;
+    dmm->io->batch_cached = true;
+  }
+#ifndef NDEBUG
+  LOG_DEBUG(-1, "adopted %ld sample(s) from %s", (long)nres, dmm->mmap->fname);
+#endif
+  return nres;
+}
+
+/* write the manifest of the persistent cache of the rank; to be called once
+ * the window is freed, so that the samples cached by the other ranks have
+ * landed */
+static herr_t write_cache_manifest(H5VL_cache_ext_t *dset) {
+  io_handler_t *dmm = dset->H5DRMM;
+  CACHE_MANIFEST *m = dmm->dset.manifest;
+  char mname[300];
+  herr_t ret_value = SUCCEED;
+  get_manifest_name(dmm, mname);
+  msync(dmm->mmap->buf, dmm->dset.win_size, MS_SYNC);
+  m->checksum = checksum_resident_samples(dmm);
+  FILE *fp = fopen(mname, "wb");
+  if (fp == NULL || fwrite(m, sizeof(CACHE_MANIFEST), 1, fp) != 1 ||
+      fwrite(get_residency_flags(dmm), 1, dmm->dset.ns_loc, fp) !=
+          dmm->dset.ns_loc) {
+    LOG_WARN(-1, "unable to write the manifest %s", mname);
+    ret_value = FAIL;
+  }
+  if (fp != NULL)
+    fclose(fp);
+  return ret_value;
+}
+
 /*-------------------------------------------------------------------------
  * Function:    create_dataset_cache_on_local_storage
  *
@@ -5611,8 +7964,9 @@ static herr_t create_dataset_cache_on_local_storage(void *obj, void *dset_args,
     // dataset_get_wrapper(dset->under_object, dset->under_vol_id,
     // H5VL_DATASET_GET_SPACE, H5P_DATASET_XFER_DEFAULT, NULL, &fspace);
     int ndims = H5Sget_simple_extent_ndims(args->space_id);
-    hsize_t *gdims = (hsize_t *)malloc(ndims * sizeof(hsize_t));
+    hsize_t *gdims = dset->H5DRMM->dset.dims;
     H5Sget_simple_extent_dims(args->space_id, gdims, NULL);
+    dset->H5DRMM->dset.ndims = ndims;
     hsize_t dim = 1; // compute the size of a single sample
     int i;
     for (i = 1; i < ndims; i++)
@@ -5621,10 +7975,54 @@ static herr_t create_dataset_cache_on_local_storage(void *obj, void *dset_args,
     dset->H5DRMM->dset.sample.nel = dim;
     dset->H5DRMM->dset.sample.dim = ndims - 1;
     dset->H5DRMM->dset.ns_glob = gdims[0];
+    dset->H5DRMM->dset.chunked = false;
+    dset->H5DRMM->dset.pipeline = NULL;
+    memset(&dset->H5DRMM->dset.ra, 0, sizeof(READ_AHEAD));
+    dset->H5DRMM->dset.schedule = NULL;
+    // in the CHUNK unit, the samples of the cache are the chunks of the
+    // dataset, distributed in the order of the chunk grid
+    if (dset->H5LS->read_unit == READ_UNIT_CHUNK &&
+        H5Pget_layout(args->dcpl_id) == H5D_CHUNKED &&
+        H5Pget_chunk(args->dcpl_id, ndims, dset->H5DRMM->dset.chunk_dims) ==
+            ndims) {
+      dset->H5DRMM->dset.chunked = true;
+      dset->H5DRMM->dset.sample.nel = 1;
+      dset->H5DRMM->dset.ns_glob = 1;
+      for (i = 0; i < ndims; i++) {
+        hsize_t cd = dset->H5DRMM->dset.chunk_dims[i];
+        dset->H5DRMM->dset.nchunks[i] = (gdims[i] + cd - 1) / cd;
+        dset->H5DRMM->dset.sample.nel *= cd;
+        dset->H5DRMM->dset.ns_glob *= dset->H5DRMM->dset.nchunks[i];
+      }
+      dset->H5DRMM->dset.sample.dim = ndims;
+#ifndef NDEBUG
+      LOG_DEBUG(-1, "Read cache by chunks: %zu chunks of %zu elements",
+                dset->H5DRMM->dset.ns_glob, dset->H5DRMM->dset.sample.nel);
+#endif
+      // decode the filtered chunks in the cache, so that the cache holds
+      // decoded chunks and HDF5 does not run the filters serially
+      if (dset->H5LS->decode_threads > 0 && H5Pget_nfilters(args->dcpl_id) > 0) {
+        dset->H5DRMM->dset.pipeline =
+            (FILTER_PIPELINE *)malloc(sizeof(FILTER_PIPELINE));
+        if (get_filter_pipeline(args->dcpl_id, dset->H5DRMM->dset.pipeline) <
+            0) {
+          LOG_WARN(-1, "the filters of %s are decoded by HDF5", name);
+          free(dset->H5DRMM->dset.pipeline);
+          dset->H5DRMM->dset.pipeline = NULL;
+        }
+      }
+    } else if (dset->H5LS->read_unit == READ_UNIT_CHUNK) {
+      LOG_WARN(-1, "dataset %s is not chunked, caching it by samples", name);
+    }
     dset->H5DRMM->dset.ns_cached = 0;
-    parallel_dist(gdims[0], dset->H5DRMM->mpi->nproc, dset->H5DRMM->mpi->rank,
-                  &dset->H5DRMM->dset.ns_loc, &dset->H5DRMM->dset.s_offset);
-    free(gdims);
+    dset->H5DRMM->dset.ns_claimed = 0;
+    dset->H5DRMM->dset.ns_put_claimed = 0;
+    dset->H5DRMM->dset.ns_pending = 0;
+    dset->H5DRMM->dset.batch.list = NULL;
+    dset->H5DRMM->dset.batch.size = 0;
+    parallel_dist(dset->H5DRMM->dset.ns_glob, dset->H5DRMM->mpi->nproc,
+                  dset->H5DRMM->mpi->rank, &dset->H5DRMM->dset.ns_loc,
+                  &dset->H5DRMM->dset.s_offset);
     dset->H5DRMM->dset.sample.size =
         dset->H5DRMM->dset.esize * dset->H5DRMM->dset.sample.nel;
     dset->H5DRMM->dset.size =
@@ -5632,20 +8030,39 @@ static herr_t create_dataset_cache_on_local_storage(void *obj, void *dset_args,
 #ifndef NDEBUG
     LOG_DEBUG(dset->H5DRMM->mpi->rank, "Claim space");
 #endif
-    if (H5LSclaim_space(dset->H5LS,
-                        dset->H5DRMM->dset.size * dset->H5DRMM->mpi->ppn, HARD,
-                        dset->H5LS->replacement_policy) == SUCCEED) {
+    // on the SSD, the space of the samples is claimed as they are cached
+    // (see claim_read_cache_space), and the storage only needs room for a
+    // sample here; the node memory is allocated as a whole, and claimed so
+    bool memory = !strcmp(dset->H5LS->type, "MEMORY");
+    hsize_t claim = memory ? dset->H5DRMM->dset.size * dset->H5DRMM->mpi->ppn
+                           : 0;
+    if ((memory && H5LSclaim_space(dset->H5LS, claim, HARD,
+                                   dset->H5LS->replacement_policy) ==
+                       SUCCEED) ||
+        (!memory && dset->H5LS->mspace_left >
+                        dset->H5DRMM->dset.sample.size *
+                            dset->H5DRMM->mpi->ppn)) {
       dset->H5DRMM->cache = (cache_t *)malloc(sizeof(cache_t));
+      dset->H5DRMM->cache->purpose = READ;
 
-      // set cache size
-
+      // set cache size; the window still has a slot for every sample of the
+      // rank, which takes storage only once written (sparse file)
       dset->H5DRMM->cache->mspace_per_rank_total = dset->H5DRMM->dset.size;
       dset->H5DRMM->cache->mspace_per_rank_left =
           dset->H5DRMM->cache->mspace_per_rank_total;
 
-      dset->H5DRMM->cache->mspace_total =
-          dset->H5DRMM->dset.size * dset->H5DRMM->mpi->ppn;
-      dset->H5DRMM->cache->mspace_left = dset->H5DRMM->cache->mspace_total;
+      dset->H5DRMM->cache->mspace_total = claim;
+      dset->H5DRMM->cache->mspace_left = 0;
+      if (memory) {
+        dset->H5DRMM->cache->mspace_per_rank_left = 0;
+        dset->H5DRMM->dset.ns_claimed = dset->H5DRMM->dset.ns_loc;
+      }
+      dset->H5DRMM->dset.put_pending =
+          (int64_t *)calloc(dset->H5DRMM->mpi->nproc, sizeof(int64_t));
+      dset->H5DRMM->dset.put_sent =
+          (int64_t *)calloc(dset->H5DRMM->mpi->nproc, sizeof(int64_t));
+      dset->H5DRMM->dset.owner_full =
+          (int64_t *)calloc(dset->H5DRMM->mpi->nproc, sizeof(int64_t));
 
       if (dset->H5LS->path != NULL) {
         strcpy(dset->H5DRMM->cache->path, p->H5DRMM->cache->path); // create
@@ -5668,29 +8085,38 @@ static herr_t create_dataset_cache_on_local_storage(void *obj, void *dset_args,
 
       H5LSregister_cache(dset->H5LS, dset->H5DRMM->cache, obj);
       dset->H5LS->cache_list = dset->H5LS->cache_list->next;
-      // create mmap window
-      hsize_t ss = round_page(dset->H5DRMM->dset.size);
-
-      dset->H5LS->mmap_cls->create_read_mmap(dset->H5DRMM->mmap, ss);
+      // create mmap window; the samples are followed by the cache metadata
+      get_read_cache_layout(dset->H5DRMM, dset->H5DRMM->mpi->rank,
+                            &dset->H5DRMM->dset.meta_offset,
+                            &dset->H5DRMM->dset.win_size);
+      hsize_t ss = dset->H5DRMM->dset.win_size;
+
+      if (!strcmp(dset->H5LS->type, "MEMORY"))
+        // node shared memory, so that the ranks on the same node can read
+        // the cache directly
+        MPI_Win_allocate_shared(ss, 1, MPI_INFO_NULL,
+                                dset->H5DRMM->mpi->node_comm,
+                                &dset->H5DRMM->mmap->buf,
+                                &dset->H5DRMM->mpi->shm_win);
+      else
+        dset->H5LS->mmap_cls->create_read_mmap(dset->H5DRMM->mmap, ss);
+      memset((char *)dset->H5DRMM->mmap->buf + dset->H5DRMM->dset.meta_offset,
+             0, ss - dset->H5DRMM->dset.meta_offset);
 
-      // create a new MPI data type based on the size of the element.
-      MPI_Datatype type[1] = {MPI_BYTE};
-      int blocklen[1] = {dset->H5DRMM->dset.esize};
-      MPI_Aint disp[1] = {0};
-      MPI_Type_create_struct(1, blocklen, disp, type,
-                             &dset->H5DRMM->dset.mpi_datatype);
-      MPI_Type_commit(&dset->H5DRMM->dset.mpi_datatype);
       // create MPI windows for both main threead and I/O thread.
 #ifndef NDEBUG
       LOG_DEBUG(dset->H5DRMM->mpi->rank, "Created MMAP 0 ");
 #endif
       // madvise(dset->H5DRMM->mmap->buf, ss, MADV_FREE);
-      MPI_Win_create(dset->H5DRMM->mmap->buf, ss, dset->H5DRMM->dset.esize,
-                     MPI_INFO_NULL, dset->H5DRMM->mpi->comm,
-                     &dset->H5DRMM->mpi->win);
+      create_read_cache_window(dset);
+      attach_node_read_caches(dset);
 #ifndef NDEBUG
       LOG_DEBUG(dset->H5DRMM->mpi->rank, "Created MMAP 1");
 #endif
+      dset->H5DRMM->dset.manifest = NULL;
+      if (dset->H5LS->persistent && dset->H5LS->path != NULL &&
+          !strcmp(dset->H5LS->mmap_cls->type, "SSD"))
+        adopt_persistent_cache(dset, fname, name);
     } else {
 
       LOG_WARN(-1, "Unable to allocate space to the "
@@ -5795,11 +8221,33 @@ static herr_t remove_dataset_cache_on_local_storage(void *dset, void **req) {
     o->H5DWMM = NULL;
   }
   if (o->read_cache) {
-    hsize_t ss = round_page(o->H5DRMM->dset.size);
-    o->H5LS->mmap_cls->remove_read_mmap(o->H5DRMM->mmap, ss);
-    if (ss > 0)
-      MPI_Win_free(&o->H5DRMM->mpi->win);
-    if (H5LSremove_cache(o->H5LS, o->H5DRMM->cache) != SUCCEED) {
+    hsize_t ss = o->H5DRMM->dset.win_size;
+    bool keep = strcmp(o->H5LS->type, "MEMORY") &&
+                o->H5DRMM->dset.manifest != NULL;
+    free_read_ahead(o);
+    free_prefetch_schedule(o);
+    free_prefetch_async(o);
+    detach_node_read_caches(o);
+    free_read_cache_window(o);
+    if (!strcmp(o->H5LS->type, "MEMORY")) {
+      MPI_Win_free(&o->H5DRMM->mpi->shm_win);
+    } else if (o->H5DRMM->dset.manifest != NULL) {
+      // keep the cache file and its manifest for the next jobs
+      write_cache_manifest(o);
+      munmap(o->H5DRMM->mmap->buf, ss);
+      close(o->H5DRMM->mmap->fd);
+      free(o->H5DRMM->dset.manifest);
+    } else {
+      o->H5LS->mmap_cls->remove_read_mmap(o->H5DRMM->mmap, ss);
+    }
+    free(o->H5DRMM->dset.batch.list);
+    free(o->H5DRMM->dset.pipeline);
+    free(o->H5DRMM->dset.put_pending);
+    free(o->H5DRMM->dset.put_sent);
+    free(o->H5DRMM->dset.owner_full);
+    // the space of a persistent cache stays claimed while its file exists
+    if ((keep ? H5LSretain_cache(o->H5LS, o->H5DRMM->cache)
+              : H5LSremove_cache(o->H5LS, o->H5DRMM->cache)) != SUCCEED) {
 
       LOG_WARN(-1, "UNABLE TO REMOVE CACHE: %s", o->H5DRMM->cache->path);
     }
@@ -5809,10 +8257,423 @@ static herr_t remove_dataset_cache_on_local_storage(void *dset, void **req) {
   return ret_value;
 } /* end H5VL_cache_ext_dataset_cache_remove() */
 
+/*-------------------------------------------------------------------------
+ * Function:    get_batch_segments
+ *
+ * Purpose:     Map a batch of samples, stored back to back in a local
+ *              buffer, to their location in the dataset cache. The segments
+ *              are sorted by owner rank and by offset in the owner window,
+ *              and a sample listed twice is only kept once, since the
+ *              target datatype of a single MPI_Put must not overlap.
+ *
+ * Return:      the number of segments
+ *
+ *-------------------------------------------------------------------------
+ */
+static size_t get_batch_segments(io_handler_t *dmm, BATCH *b, RMA_SEG **segs) {
+  RMA_SEG *s = (RMA_SEG *)malloc(sizeof(RMA_SEG) * (b->size + 1));
+  size_t local;
+  int i;
+  for (i = 0; i < b->size; i++) {
+    get_sample_owner(dmm->dset.ns_glob, dmm->mpi->nproc, b->list[i],
+                     &s[i].rank, &local);
+    s[i].disp = local * dmm->dset.sample.size;
+    s[i].pos = (MPI_Aint)i * dmm->dset.sample.size;
+    s[i].len = dmm->dset.sample.size;
+    s[i].block = b->list[i];
+  }
+  sort_rma_segments(s, b->size);
+  *segs = s;
+  return unique_rma_segments(s, b->size);
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    get_point_segments
+ *
+ * Purpose:     Map a point selection to byte ranges in the dataset cache.
+ *              The coordinates are fetched in batches and linearized
+ *              directly, without going through a selection iterator, and
+ *              points that follow each other both in the buffer and in the
+ *              same sample are coalesced into a single segment. The
+ *              segments are returned in the order of the buffer.
+ *
+ * Return:      Success:    the number of segments
+ *              Failure:    -1
+ *
+ *-------------------------------------------------------------------------
+ */
+static ssize_t get_point_segments(io_handler_t *dmm, hid_t file_space_id,
+                                  RMA_SEG **segs) {
+  size_t ss = dmm->dset.sample.size;
+  size_t esize = dmm->dset.esize, n = 0, local;
+  hsize_t start, j;
+  int ndims = dmm->dset.ndims;
+  hssize_t npoints = H5Sget_select_elem_npoints(file_space_id);
+  if (npoints < 0)
+    return FAIL;
+  hsize_t *coords = (hsize_t *)malloc(sizeof(hsize_t) * SEL_SEQ_BATCH * ndims);
+  RMA_SEG *s = (RMA_SEG *)malloc(sizeof(RMA_SEG) * (npoints + 1));
+  for (start = 0; start < npoints; start += SEL_SEQ_BATCH) {
+    hsize_t m = npoints - start;
+    if (m > SEL_SEQ_BATCH)
+      m = SEL_SEQ_BATCH;
+    if (H5Sget_select_elem_pointlist(file_space_id, start, m, coords) < 0) {
+      free(coords);
+      free(s);
+      return FAIL;
+    }
+    for (j = 0; j < m; j++) {
+      size_t sample, within;
+      locate_element(&dmm->dset, &coords[j * ndims], &sample, &within);
+      if (n > 0 && s[n - 1].block == sample &&
+          s[n - 1].disp % ss + s[n - 1].len == within) {
+        s[n - 1].len += esize;
+        continue;
+      }
+      get_sample_owner(dmm->dset.ns_glob, dmm->mpi->nproc, sample, &s[n].rank,
+                       &local);
+      s[n].disp = local * ss + within;
+      s[n].pos = (start + j) * esize;
+      s[n].len = esize;
+      s[n].block = sample;
+      n++;
+    }
+  }
+  free(coords);
+  *segs = s;
+  return n;
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    get_selection_segments
+ *
+ * Purpose:     Map a selection of the dataset to byte ranges in the dataset
+ *              cache. The selection is walked with a selection iterator in
+ *              the order in which its elements are stored in the buffer, and
+ *              each sequence is split at the sample (or chunk) boundaries,
+ *              so that any N-dimensional hyperslab can be served from the
+ *              cache, not only whole samples along the first dimension.
+ *              Point selections
+ *              go through get_point_segments. The segments are returned in
+ *              the order of the buffer.
+ *
+ * Return:      Success:    the number of segments
+ *              Failure:    -1
+ *
+ *-------------------------------------------------------------------------
+ */
+static ssize_t get_selection_segments(io_handler_t *dmm, hid_t file_space_id,
+                                      RMA_SEG **segs) {
+  size_t ss = dmm->dset.sample.size, esize = dmm->dset.esize;
+  size_t cap = SEL_SEQ_BATCH, n = 0, nseq, nbytes, i;
+  hsize_t off[SEL_SEQ_BATCH];
+  size_t len[SEL_SEQ_BATCH];
+  MPI_Aint pos = 0;
+  if (H5Sget_select_type(file_space_id) == H5S_SEL_POINTS)
+    return get_point_segments(dmm, file_space_id, segs);
+  hid_t iter = H5Ssel_iter_create(file_space_id, dmm->dset.esize, 0);
+  if (iter < 0)
+    return FAIL;
+  RMA_SEG *s = (RMA_SEG *)malloc(sizeof(RMA_SEG) * cap);
+  do {
+    if (H5Ssel_iter_get_seq_list(iter, SEL_SEQ_BATCH, SIZE_MAX, &nseq, &nbytes,
+                                 off, len) < 0) {
+      H5Ssel_iter_close(iter);
+      free(s);
+      return FAIL;
+    }
+    for (i = 0; i < nseq; i++) {
+      hsize_t e = off[i] / esize;
+      size_t l = len[i];
+      while (l > 0) {
+        size_t sample, within, run, local;
+        locate_element_run(&dmm->dset, e, &sample, &within, &run);
+        size_t m = (l < run * esize) ? l : run * esize;
+        e += m / esize;
+        // rows of a chunk that follow each other in the buffer and in the
+        // chunk are merged
+        if (n > 0 && s[n - 1].block == sample &&
+            s[n - 1].disp % ss + s[n - 1].len == within) {
+          s[n - 1].len += m;
+          pos += m;
+          l -= m;
+          continue;
+        }
+        if (n == cap) {
+          cap *= 2;
+          s = (RMA_SEG *)realloc(s, sizeof(RMA_SEG) * cap);
+        }
+        get_sample_owner(dmm->dset.ns_glob, dmm->mpi->nproc, sample,
+                         &s[n].rank, &local);
+        s[n].disp = local * ss + within;
+        s[n].pos = pos;
+        s[n].len = m;
+        s[n].block = sample;
+        n++;
+        pos += m;
+        l -= m;
+      }
+    }
+  } while (nseq == SEL_SEQ_BATCH);
+  H5Ssel_iter_close(iter);
+  *segs = s;
+  return n;
+}
+
+/* sorted list of the samples touched by a list of segments */
+static void get_segment_samples(RMA_SEG *segs, size_t nseg, BATCH *b) {
+  size_t i;
+  b->list = (int *)malloc(sizeof(int) * (nseg + 1));
+  for (i = 0; i < nseg; i++)
+    b->list[i] = segs[i].block;
+  b->size = sort_unique_samples(b->list, nseg);
+}
+
+/* whether the segments (in the order of the buffer) hold whole samples in
+ * increasing order, i.e., the buffer has the same layout as the samples read
+ * back to back */
+static bool is_sorted_whole_samples(io_handler_t *dmm, RMA_SEG *segs,
+                                    size_t nseg) {
+  size_t i;
+  for (i = 0; i < nseg; i++)
+    if (segs[i].len != dmm->dset.sample.size ||
+        (i > 0 && segs[i].block <= segs[i - 1].block))
+      return false;
+  return true;
+}
+
+/* append a byte range to a block list, extending the last block if the range
+ * continues it; blocks are capped so that their length fits in an int */
+static void append_rma_block(MPI_Aint off, size_t len, int *nblock, int *blen,
+                             MPI_Aint *bdisp) {
+  while (len > 0) {
+    size_t l = len;
+    int k = *nblock - 1;
+    if (k >= 0 && bdisp[k] + blen[k] == off && blen[k] < RMA_MAX_BLOCK) {
+      if (l > RMA_MAX_BLOCK - blen[k])
+        l = RMA_MAX_BLOCK - blen[k];
+      blen[k] += l;
+    } else {
+      if (l > RMA_MAX_BLOCK)
+        l = RMA_MAX_BLOCK;
+      bdisp[*nblock] = off;
+      blen[*nblock] = l;
+      (*nblock)++;
+    }
+    off += l;
+    len -= l;
+  }
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    rma_segments
+ *
+ * Purpose:     Move the segments between buf and the cache windows with a
+ *              single RMA call per target rank. Runs of adjacent segments
+ *              are merged and described by a pair of hindexed datatypes: one
+ *              for the local buffer and one for the target window. For
+ *              RMA_OP_SWAP, the bytes of buf replace the target bytes
+ *              atomically and the previous values are returned in result
+ *              (same layout as buf). For RMA_OP_FETCH, the target bytes are
+ *              read atomically into result (buf is not used), so that they
+ *              can be read while other ranks swap them. Has to be called
+ *              inside an access epoch.
+ *
+ * Return:      Success:    0
+ *              Failure:    -1
+ *
+ *-------------------------------------------------------------------------
+ */
+static herr_t rma_segments(io_handler_t *dmm, RMA_SEG *segs, size_t nseg,
+                           char *buf, char *result, rma_op_t op) {
+  size_t i = 0;
+  while (i < nseg) {
+    size_t j = i;
+    size_t nbytes = 0;
+    while (j < nseg && segs[j].rank == segs[i].rank) {
+      nbytes += segs[j].len;
+      j++;
+    }
+    int cap = (j - i) + nbytes / RMA_MAX_BLOCK + 1;
+    int *olen = (int *)malloc(sizeof(int) * cap);
+    int *tlen = (int *)malloc(sizeof(int) * cap);
+    MPI_Aint *odisp = (MPI_Aint *)malloc(sizeof(MPI_Aint) * cap);
+    MPI_Aint *tdisp = (MPI_Aint *)malloc(sizeof(MPI_Aint) * cap);
+    int no = 0, nt = 0;
+    size_t k;
+    for (k = i; k < j; k++) {
+      append_rma_block(segs[k].pos, segs[k].len, &no, olen, odisp);
+      append_rma_block(segs[k].disp, segs[k].len, &nt, tlen, tdisp);
+    }
+    MPI_Datatype otype, ttype;
+    // accumulate operations require a non-opaque basic type
+    MPI_Datatype base = (op == RMA_OP_SWAP || op == RMA_OP_FETCH)
+                            ? MPI_UNSIGNED_CHAR
+                            : MPI_BYTE;
+    MPI_Type_create_hindexed(no, olen, odisp, base, &otype);
+    MPI_Type_create_hindexed(nt, tlen, tdisp, base, &ttype);
+    MPI_Type_commit(&otype);
+    MPI_Type_commit(&ttype);
+#ifndef NDEBUG
+    LOG_DEBUG(-1, "RMA op %d: %zu bytes in %d block(s) on rank %d", (int)op,
+              nbytes, nt, segs[i].rank);
+#endif
+    if (op == RMA_OP_PUT)
+      MPI_Put(buf, 1, otype, segs[i].rank, 0, 1, ttype, dmm->mpi->win);
+    else if (op == RMA_OP_GET)
+      MPI_Get(buf, 1, otype, segs[i].rank, 0, 1, ttype, dmm->mpi->win);
+    else if (op == RMA_OP_SWAP)
+      MPI_Get_accumulate(buf, 1, otype, result, 1, otype, segs[i].rank, 0, 1,
+                         ttype, MPI_REPLACE, dmm->mpi->win);
+    else
+      MPI_Get_accumulate(NULL, 0, MPI_UNSIGNED_CHAR, result, 1, otype,
+                         segs[i].rank, 0, 1, ttype, MPI_NO_OP, dmm->mpi->win);
+    MPI_Type_free(&otype);
+    MPI_Type_free(&ttype);
+    free(olen);
+    free(tlen);
+    free(odisp);
+    free(tdisp);
+    i = j;
+  }
+  return SUCCEED;
+}
+
+/* map the residency flags of a batch of samples, stored back to back in a
+ * local buffer (one byte per sample), to their location in the windows */
+static size_t get_residency_segments(io_handler_t *dmm, BATCH *b,
+                                     RMA_SEG **segs) {
+  RMA_SEG *s = (RMA_SEG *)malloc(sizeof(RMA_SEG) * (b->size + 1));
+  hsize_t meta_offset, win_size;
+  size_t local;
+  int i;
+  for (i = 0; i < b->size; i++) {
+    get_sample_owner(dmm->dset.ns_glob, dmm->mpi->nproc, b->list[i],
+                     &s[i].rank, &local);
+    get_read_cache_layout(dmm, s[i].rank, &meta_offset, &win_size);
+    s[i].disp = meta_offset + META_NSLOTS * sizeof(int64_t) + local;
+    s[i].pos = i;
+    s[i].len = 1;
+  }
+  sort_rma_segments(s, b->size);
+  *segs = s;
+  return b->size;
+}
+
+/* fetch the residency flags described by segs into flags. In the PASSIVE
+ * mode, the flags are swapped atomically by the other ranks at any time, so
+ * they are read atomically, including those of the ranks of the node; in the
+ * FENCE mode, they are not updated during the epoch and are read directly.
+ * Has to be called inside an access epoch. */
+static void fetch_residency_flags(H5VL_cache_ext_t *dset, RMA_SEG *segs,
+                                  size_t nseg, unsigned char *flags) {
+  if (dset->H5LS->rma_mode == RMA_PASSIVE) {
+    rma_segments(dset->H5DRMM, segs, nseg, NULL, (char *)flags,
+                 RMA_OP_FETCH);
+    return;
+  }
+  nseg = copy_node_local_segments(dset, segs, nseg, (char *)flags);
+  rma_segments(dset->H5DRMM, segs, nseg, (char *)flags, NULL, RMA_OP_GET);
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    put_samples_to_cache
+ *
+ * Purpose:     Store whole samples into the caches of their owners and set
+ *              their residency flags. segs describes the bytes of the
+ *              samples in src (sorted and unique) and b lists the samples
+ *              (sorted and unique). flags is a buffer of 2 * b->size bytes,
+ *              which receives the previous value of the residency flags in
+ *              its second half; it has to stay valid until the epoch is
+ *              completed. Has to be called inside an access epoch.
+ *
+ * Return:      Success:    0
+ *              Failure:    -1
+ *
+ *-------------------------------------------------------------------------
+ */
+static herr_t put_samples_to_cache(H5VL_cache_ext_t *dset, RMA_SEG *segs,
+                                   size_t nseg, char *src, BATCH *b,
+                                   unsigned char *flags) {
+  io_handler_t *dmm = dset->H5DRMM;
+  RMA_SEG *rsegs;
+  size_t nr;
+  rma_segments(dmm, segs, nseg, src, NULL, RMA_OP_PUT);
+  // the data has to be in place before the flags are set
+  read_cache_flush(dset);
+  memset(flags, 1, 2 * b->size);
+  // the flag of a sample listed twice is swapped once; the previous value of
+  // the other copy reads as set, so that the sample is only counted once
+  nr = get_residency_segments(dmm, b, &rsegs);
+  nr = unique_rma_segments(rsegs, nr);
+  rma_segments(dmm, rsegs, nr, (char *)flags, (char *)&flags[b->size],
+               RMA_OP_SWAP);
+  free(rsegs);
+  return SUCCEED;
+}
+
+/* keep the segments of the samples that are selected as a whole; the
+ * segments are sorted and made unique, so that the segments of a sample are
+ * adjacent. Return the number of segments left. */
+static size_t keep_whole_samples(io_handler_t *dmm, RMA_SEG *segs,
+                                 size_t nseg) {
+  size_t i = 0, j, k, n = 0;
+  sort_rma_segments(segs, nseg);
+  nseg = unique_rma_segments(segs, nseg);
+  while (i < nseg) {
+    size_t nbytes = 0;
+    for (j = i; j < nseg && segs[j].block == segs[i].block; j++)
+      nbytes += segs[j].len;
+    if (nbytes == get_sample_bytes(&dmm->dset, segs[i].block))
+      for (k = i; k < j; k++)
+        segs[n++] = segs[k];
+    i = j;
+  }
+  return n;
+}
+
+/* number of samples whose residency flag was not set before */
+static int64_t count_new_samples(unsigned char *flags, int n) {
+  int64_t nnew = 0;
+  int i;
+  for (i = 0; i < n; i++)
+    nnew += (flags[n + i] == 0);
+  return nnew;
+}
+
+/* resolve H5S_ALL: the whole dataset is selected in the file, and the
+ * memory has the shape of the file selection. The file space returned has
+ * to be closed if it differs from file_space_id. */
+static void get_selection_spaces(DSET *d, hid_t mem_space_id,
+                                 hid_t file_space_id, hid_t *mspace,
+                                 hid_t *fspace) {
+  *fspace = file_space_id;
+  if (file_space_id == H5S_ALL)
+    *fspace = H5Screate_simple(d->ndims, d->dims, NULL);
+  *mspace = (mem_space_id == H5S_ALL) ? *fspace : mem_space_id;
+}
+
+/* whether the selected elements can be moved between buf and the cache as
+ * they are: the memory type is the datatype of the dataset (in which the
+ * cache stores the samples) and the memory selection is contiguous; offset
+ * is then the byte offset of the selection in buf */
+static bool is_direct_transfer(DSET *d, hid_t mem_type_id, hid_t mspace,
+                               hsize_t *offset) {
+  *offset = 0;
+#ifdef H5S_BLOCK
+  if (mspace == H5S_BLOCK)
+    return H5Tequal(mem_type_id, d->h5_datatype) > 0;
+#endif
+  return H5Tequal(mem_type_id, d->h5_datatype) > 0 &&
+         is_contiguous_selection(mspace, d->esize, offset);
+}
+
 /*-------------------------------------------------------------------------
  * Function:    write_data_to_local_storage2
  *
- * Purpose:     cache function for storing read dataset to the local storage
+ * Purpose:     cache function for storing read dataset to the local storage.
+ *              Only the samples that are selected as a whole are cached; a
+ *              partial sample cannot be served from the cache later.
  *
  * Return:      NULL
  *
@@ -5826,74 +8687,71 @@ static void *write_data_to_local_storage2(void *dset, hid_t mem_type_id,
 #ifndef NDEBUG
   LOG_INFO(-1, "caching data to local storage using MPI_Put");
 #endif
-  hsize_t bytes = get_buf_size(mem_space_id, mem_type_id);
-  get_samples_from_filespace(file_space_id, &o->H5DRMM->dset.batch,
-                             &o->H5DRMM->dset.contig_read);
-  o->H5DRMM->mmap->tmp_buf = (void *)buf;
-  o->H5DRMM->io->batch_cached = false;
   io_handler_t *dmm = (io_handler_t *)o->H5DRMM;
+  RMA_SEG *segs = NULL;
+  hid_t mspace, fspace;
+  hsize_t offset = 0;
+  char *stage = NULL;
+  get_selection_spaces(&dmm->dset, mem_space_id, file_space_id, &mspace,
+                       &fspace);
+  ssize_t nsel = get_selection_segments(dmm, fspace, &segs);
+  size_t nseg = keep_whole_samples(dmm, segs, (nsel > 0) ? nsel : 0);
+  // the cache stores the elements back to back, in the dataset datatype
+  if (nseg > 0 && !is_direct_transfer(&dmm->dset, mem_type_id, mspace,
+                                      &offset)) {
+    stage = (char *)malloc(H5Sget_select_npoints(fspace) * dmm->dset.esize);
+    if (gather_from_memory(buf, mem_type_id, mspace, stage,
+                           dmm->dset.h5_datatype) < 0) {
+      LOG_WARN(-1, "unable to convert the data to the dataset datatype; "
+                   "not caching it");
+      nseg = 0;
+    }
+  }
+  if (fspace != file_space_id)
+    H5Sclose(fspace);
+  free(dmm->dset.batch.list);
+  get_segment_samples(segs, nseg, &dmm->dset.batch);
+  dmm->mmap->tmp_buf = (stage != NULL) ? stage : (char *)buf + offset;
+  dmm->io->batch_cached = false;
   if (!dmm->io->batch_cached) {
     char *p_mem = (char *)dmm->mmap->tmp_buf;
+    BATCH *b = &dmm->dset.batch;
+    unsigned char *flags = (unsigned char *)malloc(2 * b->size + 1);
 #ifndef NDEBUG
     LOG_DEBUG(-1, "MPI_Win_fence mode_no_precede");
 #endif
 
-    MPI_Win_fence(MPI_MODE_NOPRECEDE, dmm->mpi->win);
-    int batch_size = dmm->dset.batch.size;
-    if (dmm->dset.contig_read) {
-      int dest = dmm->dset.batch.list[0];
-      int src = dest / dmm->dset.ns_loc;
-      assert(src < dmm->mpi->nproc);
-      MPI_Aint offset =
-          round_page((dest % dmm->dset.ns_loc) * dmm->dset.sample.nel);
-#ifndef NDEBUG
-      LOG_DEBUG(-1, "MPI_put");
-#endif
-
-      MPI_Put(p_mem, dmm->dset.sample.nel * batch_size, dmm->dset.mpi_datatype,
-              src, offset, dmm->dset.sample.nel * batch_size,
-              dmm->dset.mpi_datatype, dmm->mpi->win);
-      // madvise(p_mem, batch_size * dmm->dset.sample.size, MADV_FREE);
-#ifndef NDEBUG
-      LOG_DEBUG(-1, "MPI_put done");
-#endif
-    } else {
-      int i = 0;
-      for (i = 0; i < batch_size; i++) {
-        int dest = dmm->dset.batch.list[i];
-        int src = dest / dmm->dset.ns_loc;
-        assert(src < dmm->mpi->nproc);
-        MPI_Aint offset =
-            round_page((dest % dmm->dset.ns_loc) * dmm->dset.sample.nel);
+    read_cache_epoch_start(o, MPI_MODE_NOPRECEDE);
+    send_cached_sample_count(o);
 #ifndef NDEBUG
-        LOG_DEBUG(-1, "MPI_put");
+    LOG_DEBUG(-1, "MPI_put");
 #endif
-
-        MPI_Put(&p_mem[i * dmm->dset.sample.size], dmm->dset.sample.nel,
-                dmm->dset.mpi_datatype, src, offset, dmm->dset.sample.nel,
-                dmm->dset.mpi_datatype, dmm->mpi->win);
-        // madvise(&p_mem[i*dmm->dset.sample.size], dmm->dset.sample.size,
-        // MADV_FREE);
+    // the epoch is collective in the FENCE mode, even without samples to
+    // put. The samples are only cached by the owners that had space left at
+    // the previous put; their state is fetched for the next one
+    nseg = drop_full_owners(o, segs, nseg, b);
+    bool put = b->size > 0;
+    if (put)
+      put_samples_to_cache(o, segs, nseg, p_mem, b, flags);
+    fetch_owner_state(o, b);
 #ifndef NDEBUG
-        LOG_DEBUG(-1, "MPI_put done");
+    LOG_DEBUG(-1, "MPI_put done");
 #endif
-      }
-    }
-    MPI_Win_fence(MPI_MODE_NOSUCCEED, dmm->mpi->win);
+    read_cache_epoch_end(o, MPI_MODE_NOSUCCEED, true);
 #ifndef NDEBUG
     LOG_DEBUG(-1, "MPI_Win_fence mode_no_precede");
 #endif
     H5LSrecord_cache_access(dmm->cache);
     dmm->io->batch_cached = true;
-    dmm->dset.ns_cached += dmm->dset.batch.size;
-    bool dset_cached;
-    if (dmm->dset.ns_cached >= dmm->dset.ns_loc) {
-      dmm->io->dset_cached = true;
+    if (put) {
+      count_cached_samples(o, count_new_samples(flags, b->size));
+      count_put_samples(o, b, flags);
     }
-    MPI_Allreduce(&dmm->io->dset_cached, &dset_cached, 1, MPI_C_BOOL, MPI_LAND,
-                  dmm->mpi->comm);
-    dmm->io->dset_cached = dset_cached;
+    claim_put_samples_space(o);
+    free(flags);
   }
+  free(stage);
+  free(segs);
   return NULL;
 }
 
@@ -5912,7 +8770,12 @@ static void *write_data_to_local_storage(void *dset, hid_t mem_type_id,
 /*-------------------------------------------------------------------------
  * Function:    read_data_from_storage
  *
- * Purpose:     Reads data elements from a dataset cache into a buffer.
+ * Purpose:     Reads data elements from a dataset cache into a buffer. The
+ *              selection can be any hyperslab of the dataset; it is mapped
+ *              to byte ranges in the caches of the owners. The cache holds
+ *              the elements in the datatype of the dataset; they are
+ *              converted to the memory datatype and scattered to the memory
+ *              selection once they are fetched.
  *
  * Return:      Success:    0
  *              Failure:    -1
@@ -5924,45 +8787,274 @@ static herr_t read_data_from_local_storage(void *dset, hid_t mem_type_id,
                                            hid_t file_space_id, hid_t plist_id,
                                            void *buf, void **req) {
   H5VL_cache_ext_t *o = (H5VL_cache_ext_t *)dset;
-  herr_t ret_value;
+  DSET *d = &o->H5DRMM->dset;
+  herr_t ret_value = SUCCEED;
+  hid_t mspace, fspace;
+  hsize_t offset;
 
 #ifndef NDEBUG
   LOG_INFO(-1, "VOL DATASET Read from cache");
 #endif
-  bool contig = false;
-  BATCH b;
-  get_samples_from_filespace(file_space_id, &b, &contig);
-  MPI_Win_fence(MPI_MODE_NOPUT | MPI_MODE_NOPRECEDE, o->H5DRMM->mpi->win);
-  char *p_mem = (char *)buf;
-  int batch_size = b.size;
-  if (!contig) {
-    int i = 0;
-    for (i = 0; i < batch_size; i++) {
-      int dest = b.list[i];
-      int src = dest / o->H5DRMM->dset.ns_loc;
-      MPI_Aint offset = round_page((dest % o->H5DRMM->dset.ns_loc) *
-                                   o->H5DRMM->dset.sample.nel);
-      MPI_Get(&p_mem[i * o->H5DRMM->dset.sample.size],
-              o->H5DRMM->dset.sample.nel, o->H5DRMM->dset.mpi_datatype, src,
-              offset, o->H5DRMM->dset.sample.nel, o->H5DRMM->dset.mpi_datatype,
-              o->H5DRMM->mpi->win);
-    }
+  get_selection_spaces(d, mem_space_id, file_space_id, &mspace, &fspace);
+  // the data is fetched in the dataset datatype; if it can't go to buf as
+  // it is, it is staged and scattered to the memory selection afterwards
+  bool direct = is_direct_transfer(d, mem_type_id, mspace, &offset);
+  char *dst = (char *)buf + offset;
+  if (!direct)
+    dst = (char *)malloc(H5Sget_select_npoints(fspace) * d->esize + 1);
+  RMA_SEG *segs = NULL;
+  ssize_t nsel = get_selection_segments(o->H5DRMM, fspace, &segs);
+  size_t nseg = 0;
+  if (nsel < 0) {
+    LOG_ERROR(-1, "failed to map the selection to the cache");
+    ret_value = FAIL;
   } else {
-    int dest = b.list[0];
-    int src = dest / o->H5DRMM->dset.ns_loc;
-    MPI_Aint offset = round_page((dest % o->H5DRMM->dset.ns_loc) *
-                                 o->H5DRMM->dset.sample.nel);
-    MPI_Get(p_mem, o->H5DRMM->dset.sample.nel * batch_size,
-            o->H5DRMM->dset.mpi_datatype, src, offset,
-            o->H5DRMM->dset.sample.nel * batch_size,
-            o->H5DRMM->dset.mpi_datatype, o->H5DRMM->mpi->win);
-  }
-  MPI_Win_fence(MPI_MODE_NOSUCCEED, o->H5DRMM->mpi->win);
+    nseg = nsel;
+    sort_rma_segments(segs, nseg);
+  }
+  // the epoch is completed even on failure, it is collective in FENCE mode
+  read_cache_epoch_start(o, MPI_MODE_NOPUT | MPI_MODE_NOPRECEDE);
+  // samples owned by ranks on the same node are copied directly
+  nseg = copy_node_local_segments(o, segs, nseg, dst);
+  rma_segments(o->H5DRMM, segs, nseg, dst, NULL, RMA_OP_GET);
+  read_cache_epoch_end(o, MPI_MODE_NOSUCCEED, false);
+  if (!direct) {
+    if (ret_value >= 0 && scatter_to_memory(dst, d->h5_datatype, buf,
+                                            mem_type_id, mspace) < 0) {
+      LOG_ERROR(-1, "failed to convert the data to the memory datatype");
+      ret_value = FAIL;
+    }
+    free(dst);
+  }
+  if (fspace != file_space_id)
+    H5Sclose(fspace);
+  free(segs);
   H5LSrecord_cache_access(o->H5DRMM->cache);
-  ret_value = 0;
   return ret_value;
 } /* end  */
 
+/* read missing samples into dst, back to back: the samples fetched ahead
+ * or staged by the prefetch schedule are copied, the others are read from
+ * the under VOL */
+static herr_t read_missing_samples(H5VL_cache_ext_t *dset, BATCH *miss,
+                                   char *dst, hid_t plist_id) {
+  DSET *d = &dset->H5DRMM->dset;
+  size_t ss = d->sample.size;
+  herr_t ret_value = SUCCEED;
+  int i, n = 0;
+  int *rest = (int *)malloc(sizeof(int) * (miss->size + 1));
+  int *slots = (int *)malloc(sizeof(int) * (miss->size + 1));
+  for (i = 0; i < miss->size; i++) {
+    char *staged = get_staged_sample(dset, miss->list[i]);
+    if (staged != NULL) {
+      memcpy(dst + (size_t)i * ss, staged, ss);
+    } else {
+      rest[n] = miss->list[i];
+      slots[n++] = i;
+    }
+  }
+  if (n == miss->size) {
+    ret_value = read_samples_from_pfs(dset, miss->list, miss->size, dst,
+                                      d->h5_datatype, plist_id);
+  } else if (n > 0) {
+    char *tmp = (char *)malloc((size_t)n * ss);
+    ret_value =
+        read_samples_from_pfs(dset, rest, n, tmp, d->h5_datatype, plist_id);
+    for (i = 0; i < n; i++)
+      memcpy(dst + (size_t)slots[i] * ss, tmp + (size_t)i * ss, ss);
+    free(tmp);
+  }
+  free(rest);
+  free(slots);
+  return ret_value;
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    read_data_through_local_storage
+ *
+ * Purpose:     Reads data elements from a dataset that is partially cached.
+ *              The residency flags of the samples touched by the selection
+ *              are fetched first; the parts of the selection that fall in
+ *              cached samples (hits) are read from the cache. The samples
+ *              that are not cached (misses) are read as a whole from the
+ *              under VOL, the selected parts are copied into the buffer and
+ *              the samples are stored to the cache. The missing samples
+ *              may have been fetched ahead (see issue_read_ahead) or staged
+ *              by the prefetch schedule, in which case they are not read
+ *              again. As in
+ *              read_data_from_local_storage, the data is staged in the
+ *              dataset datatype when it can't be read into buf as it is.
+ *
+ *              In the FENCE mode, this uses two epochs on all the ranks:
+ *              the first one fetches the flags (and adds the pending count
+ *              of cached samples to the counter), the second one moves the
+ *              data and reads the counter, so that all the ranks switch to
+ *              read_data_from_local_storage after the same read.
+ *
+ * Return:      Success:    0
+ *              Failure:    -1
+ *
+ *-------------------------------------------------------------------------
+ */
+static herr_t read_data_through_local_storage(void *dset, hid_t mem_type_id,
+                                              hid_t mem_space_id,
+                                              hid_t file_space_id,
+                                              hid_t plist_id, void *buf,
+                                              void **req) {
+  H5VL_cache_ext_t *o = (H5VL_cache_ext_t *)dset;
+  io_handler_t *dmm = o->H5DRMM;
+  herr_t ret_value = SUCCEED;
+  size_t ss = dmm->dset.sample.size;
+  BATCH b, miss;
+  RMA_SEG *segs = NULL, *rsegs;
+  size_t nseg = 0, nr, i, nhit = 0, nmiss = 0;
+  hid_t mspace, fspace;
+  hsize_t offset;
+#ifndef NDEBUG
+  LOG_INFO(-1, "VOL DATASET Read through cache");
+#endif
+  get_selection_spaces(&dmm->dset, mem_space_id, file_space_id, &mspace,
+                       &fspace);
+  bool direct = is_direct_transfer(&dmm->dset, mem_type_id, mspace, &offset);
+  char *out = (char *)buf + offset;
+  if (!direct)
+    out = (char *)malloc(H5Sget_select_npoints(fspace) * dmm->dset.esize + 1);
+  ssize_t nsel = get_selection_segments(dmm, fspace, &segs);
+  if (nsel < 0) {
+    LOG_ERROR(-1, "failed to map the selection to the cache");
+    ret_value = FAIL;
+  } else {
+    nseg = nsel;
+  }
+  get_segment_samples(segs, nseg, &b);
+  unsigned char *resident = (unsigned char *)malloc(b.size + 1);
+
+  // epoch 1: residency flags of the samples
+  nr = get_residency_segments(dmm, &b, &rsegs);
+  read_cache_epoch_start(o, MPI_MODE_NOPRECEDE);
+  send_cached_sample_count(o);
+  fetch_residency_flags(o, rsegs, nr, resident);
+  fetch_owner_state(o, &b);
+  // in the FENCE mode, this fence also starts the next epoch
+  read_cache_epoch_end(o, 0, false);
+  free(rsegs);
+
+  // split the samples and the segments into hits and misses
+  miss.list = (int *)malloc(sizeof(int) * (b.size + 1));
+  miss.size = 0;
+  for (i = 0; i < b.size; i++)
+    if (!resident[i])
+      miss.list[miss.size++] = b.list[i];
+  RMA_SEG *hits = (RMA_SEG *)malloc(sizeof(RMA_SEG) * (nseg + 1));
+  RMA_SEG *misses = (RMA_SEG *)malloc(sizeof(RMA_SEG) * (nseg + 1));
+  for (i = 0; i < nseg; i++) {
+    if (resident[find_sample(b.list, b.size, segs[i].block)])
+      hits[nhit++] = segs[i];
+    else
+      misses[nmiss++] = segs[i];
+  }
+#ifndef NDEBUG
+  LOG_DEBUG(-1, "%d hits; %d misses", b.size - miss.size, miss.size);
+#endif
+
+  // read the missing samples from the under VOL, unless they were fetched
+  // ahead by the previous reads. The ranks miss different samples (or
+  // none), so they read them independently
+  hid_t xfer_id = get_independent_dxpl(plist_id);
+  char *src = out;
+  char *tmp = NULL;
+  int nahead = 0;
+  wait_read_ahead(o);
+  advance_prefetch_schedule(o, &b);
+  for (i = 0; i < miss.size; i++)
+    nahead += (get_staged_sample(o, miss.list[i]) != NULL);
+  if (miss.size > nahead)
+    o->H5LS->demand_misses++;
+  if (direct && miss.size > 0 && nhit == 0 && nahead == 0 &&
+      is_sorted_whole_samples(dmm, segs, nseg)) {
+    // the buffer holds the samples back to back, read them in place
+    ret_value = H5VLdataset_read(1, &o->under_object, o->under_vol_id,
+                                 &mem_type_id, &mem_space_id, &file_space_id,
+                                 xfer_id, &buf, NULL);
+  } else if (miss.size > 0) {
+    tmp = (char *)malloc(miss.size * ss);
+    ret_value = read_missing_samples(o, &miss, tmp, xfer_id);
+    // the samples are returned in increasing order
+    for (i = 0; i < nmiss; i++) {
+      int k = find_sample(miss.list, miss.size, misses[i].block);
+      memcpy(out + misses[i].pos, tmp + (size_t)k * ss + misses[i].disp % ss,
+             misses[i].len);
+    }
+    src = tmp;
+  }
+  free(misses);
+  RMA_SEG *put;
+  size_t nput = get_batch_segments(dmm, &miss, &put);
+  // the misses are only cached by the owners that have space left; the
+  // samples keep their place in src
+  nput = drop_full_owners(o, put, nput, &miss);
+
+  // epoch 2: read the hits, cache the misses and read the counter
+  unsigned char *flags = (unsigned char *)malloc(2 * miss.size + 1);
+  int64_t total = 0;
+  sort_rma_segments(hits, nhit);
+  nhit = copy_node_local_segments(o, hits, nhit, out);
+  rma_segments(dmm, hits, nhit, out, NULL, RMA_OP_GET);
+  if (nput > 0 && ret_value >= 0)
+    put_samples_to_cache(o, put, nput, src, &miss, flags);
+  // in the PASSIVE mode, the counter is updated atomically at any time, and
+  // every rank reads it (atomically) so that each one learns that the
+  // dataset is cached without a collective call
+  if (o->H5LS->rma_mode == RMA_FENCE)
+    MPI_Get(&total, 1, MPI_INT64_T, 0, cached_counter_disp(dmm), 1,
+            MPI_INT64_T, dmm->mpi->win);
+  else
+    MPI_Fetch_and_op(NULL, &total, MPI_INT64_T, 0, cached_counter_disp(dmm),
+                     MPI_NO_OP, dmm->mpi->win);
+  read_cache_epoch_end(o, MPI_MODE_NOSUCCEED, true);
+  if (nput > 0 && ret_value >= 0) {
+    count_cached_samples(o, count_new_samples(flags, miss.size));
+    count_put_samples(o, &miss, flags);
+  }
+  claim_put_samples_space(o);
+  if (total >= dmm->dset.ns_glob)
+    dmm->io->dset_cached = true;
+  H5LSrecord_cache_access(dmm->cache);
+  if (!direct) {
+    if (ret_value >= 0 && scatter_to_memory(out, dmm->dset.h5_datatype, buf,
+                                            mem_type_id, mspace) < 0) {
+      LOG_ERROR(-1, "failed to convert the data to the memory datatype");
+      ret_value = FAIL;
+    }
+    free(out);
+  }
+  if (fspace != file_space_id)
+    H5Sclose(fspace);
+  // stage the next batches of the schedule
+  if (dmm->io->dset_cached)
+    free_prefetch_schedule(o);
+  else
+    refill_prefetch_schedule(o);
+  // fetch the samples of the next reads if they can be predicted
+  if (o->H5LS->read_ahead_depth > 0) {
+    if (!dmm->io->dset_cached && update_read_pattern(&dmm->dset.ra, &b))
+      issue_read_ahead(o, &b, xfer_id);
+    else
+      free_read_ahead(o);
+  }
+
+  H5Pclose(xfer_id);
+  free(flags);
+  free(put);
+  free(tmp);
+  free(hits);
+  free(segs);
+  free(miss.list);
+  free(resident);
+  free(b.list);
+  return ret_value;
+} /* end read_data_through_local_storage() */
+
 static herr_t flush_data_from_local_storage(void *current_request, void **req) {
 #ifndef NDEBUG
   LOG_INFO(-1, "VOL flush data from local storage");
@@ -6115,6 +9207,7 @@ static herr_t create_file_cache_on_global_storage(void *obj, void *file_args,
     file->H5LS->cache_list = file->H5LS->cache_list->next;
     file->H5DWMM->io->offset_current = 0;
     file->H5DWMM->mmap->offset = 0;
+    start_flush_timer(file);
     file->H5DWMM->io->request_list->id = 0;
     file->H5DWMM->io->current_request = file->H5DWMM->io->request_list;
     file->H5DWMM->io->first_request = file->H5DWMM->io->request_list;
@@ -6469,6 +9562,7 @@ static herr_t remove_file_cache_on_global_storage(void *file, void **req) {
   H5VL_cache_ext_t *o = (H5VL_cache_ext_t *)file;
   herr_t ret_value;
   if (o->write_cache) {
+    stop_flush_timer(o);
     H5VL_cache_ext_file_wait(file);
     H5Fclose(o->hd_glob);
     MPI_Barrier(o->H5DWMM->mpi->comm);
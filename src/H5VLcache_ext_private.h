@@ -31,6 +31,8 @@
 /* Names for dynamically registered operations */
 #define H5VL_CACHE_EXT_DYN_DREAD_TO_CACHE "anl.gov.cache.dread_to_cache"
 #define H5VL_CACHE_EXT_DYN_DPREFETCH "anl.gov.cache.dprefetch"
+#define H5VL_CACHE_EXT_DYN_DPREFETCH_SCHEDULE "anl.gov.cache.dprefetch_schedule"
+#define H5VL_CACHE_EXT_DYN_DPREFETCH_STATUS "anl.gov.cache.dprefetch_status"
 #define H5VL_CACHE_EXT_DYN_DREAD_FROM_CACHE "anl.gov.cache.dread_from_cache"
 #define H5VL_CACHE_EXT_DYN_DCACHE_REMOVE "anl.gov.cache.dcache_remove"
 #define H5VL_CACHE_EXT_DYN_DCACHE_CREATE "anl.gov.cache.dcache_create"
@@ -62,6 +64,19 @@ typedef struct H5VL_cache_ext_dataset_prefetch_args_t {
   hid_t file_space_id;
 } H5VL_cache_ext_dataset_prefetch_args_t;
 
+/* H5VL_CACHE_EXT_DYN_DPREFETCH_SCHEDULE */
+typedef struct H5VL_cache_ext_dataset_prefetch_schedule_args_t {
+  const hsize_t *indices;
+  size_t n;
+  size_t batch_size;
+} H5VL_cache_ext_dataset_prefetch_schedule_args_t;
+
+/* H5VL_CACHE_EXT_DYN_DPREFETCH_STATUS */
+typedef struct H5VL_cache_ext_dataset_prefetch_status_args_t {
+  hsize_t *bytes_done;
+  hsize_t *bytes_total;
+} H5VL_cache_ext_dataset_prefetch_status_args_t;
+
 /* H5VL_CACHE_EXT_DYN_DREAD_FROM_CACHE */
 typedef struct H5VL_cache_ext_dataset_read_from_cache_args_t {
   hid_t mem_type_id;
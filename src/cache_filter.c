@@ -0,0 +1,357 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright (c) 2023, UChicago Argonne, LLC.                                *
+ * All Rights Reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5 Cache VOL connector.  The full copyright notice *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the LICENSE file, which can be found at the root of the source code       *
+ * distribution tree.                                                        *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "cache_filter.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+
+// Debug
+#include "debug.h"
+
+#ifndef SUCCEED
+#define SUCCEED 0
+#endif
+
+#ifndef FAIL
+#define FAIL -1
+#endif
+
+/*
+  Get the filter pipeline of a chunked dataset. Only the filters that the
+  cache knows how to decode are accepted: deflate (if built with zlib),
+  shuffle and fletcher32. For any other filter (e.g., szip), the chunks have
+  to be decoded by HDF5.
+ */
+herr_t get_filter_pipeline(hid_t dcpl_id, FILTER_PIPELINE *pipeline) {
+  int i, nfilters = H5Pget_nfilters(dcpl_id);
+  if (nfilters <= 0 || nfilters > MAX_NUM_FILTERS)
+    return FAIL;
+  pipeline->nfilters = nfilters;
+  for (i = 0; i < nfilters; i++) {
+    unsigned int flags, config;
+    pipeline->nparms[i] = MAX_NUM_FILTER_PARMS;
+    pipeline->id[i] =
+        H5Pget_filter2(dcpl_id, i, &flags, &pipeline->nparms[i],
+                       pipeline->parms[i], 0, NULL, &config);
+    switch (pipeline->id[i]) {
+#ifdef USE_ZLIB
+    case H5Z_FILTER_DEFLATE:
+#endif
+    case H5Z_FILTER_FLETCHER32:
+      break;
+    case H5Z_FILTER_SHUFFLE:
+      if (pipeline->nparms[i] < 1)
+        return FAIL;
+      break;
+    default:
+#ifndef NDEBUG
+      LOG_DEBUG(-1, "filter %d is not decoded by the cache",
+                (int)pipeline->id[i]);
+#endif
+      return FAIL;
+    }
+  }
+  return SUCCEED;
+}
+
+/* same algorithm as H5_checksum_fletcher32 */
+uint32_t checksum_fletcher32(const void *_data, size_t _len) {
+  const uint8_t *data = (const uint8_t *)_data;
+  size_t len = _len / 2;
+  uint32_t sum1 = 0, sum2 = 0;
+  while (len) {
+    size_t tlen = len > 360 ? 360 : len;
+    len -= tlen;
+    do {
+      sum1 += (uint32_t)(((uint16_t)data[0]) << 8) | ((uint16_t)data[1]);
+      data += 2;
+      sum2 += sum1;
+    } while (--tlen);
+    sum1 = (sum1 & 0xffff) + (sum1 >> 16);
+    sum2 = (sum2 & 0xffff) + (sum2 >> 16);
+  }
+  if (_len % 2) {
+    sum1 += (uint32_t)(((uint16_t)*data) << 8);
+    sum2 += sum1;
+    sum1 = (sum1 & 0xffff) + (sum1 >> 16);
+    sum2 = (sum2 & 0xffff) + (sum2 >> 16);
+  }
+  sum1 = (sum1 & 0xffff) + (sum1 >> 16);
+  sum2 = (sum2 & 0xffff) + (sum2 >> 16);
+  return (sum2 << 16) | sum1;
+}
+
+/* check the checksum stored (little endian) at the end of a chunk; like
+ * HDF5, also accept the checksum with the bytes of each 16-bit word
+ * swapped, written by old versions of the library */
+static bool check_fletcher32(const unsigned char *buf, size_t nbytes) {
+  const unsigned char *p = buf + nbytes - 4;
+  uint32_t stored = (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+                    ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+  uint32_t sum = checksum_fletcher32(buf, nbytes - 4);
+  uint32_t reversed = ((sum & 0x00ff00ff) << 8) | ((sum >> 8) & 0x00ff00ff);
+  return stored == sum || stored == reversed;
+}
+
+/* inverse of the shuffle filter: gather the bytes of each element */
+static void unshuffle(const unsigned char *src, size_t nbytes, size_t esize,
+                      unsigned char *dst) {
+  size_t nel = nbytes / esize, i, j;
+  if (esize <= 1 || nel <= 1) {
+    memcpy(dst, src, nbytes);
+    return;
+  }
+  for (j = 0; j < esize; j++) {
+    const unsigned char *s = src + j * nel;
+    unsigned char *d = dst + j;
+    for (i = 0; i < nel; i++, d += esize)
+      *d = s[i];
+  }
+  // the bytes that do not make a whole element are not shuffled
+  memcpy(dst + nel * esize, src + nel * esize, nbytes - nel * esize);
+}
+
+/* undo the filters of a chunk, in the reverse order of the pipeline; the
+ * intermediate results go to two scratch buffers of cap bytes */
+static herr_t decode_chunk(const FILTER_PIPELINE *p, DECODE_TASK *t,
+                           unsigned char *scratch[2], size_t cap) {
+  const unsigned char *cur = (const unsigned char *)t->raw;
+  size_t size = t->raw_size;
+  int i, k = 0;
+  for (i = p->nfilters - 1; i >= 0; i--) {
+    unsigned char *out = scratch[k];
+    if (t->filter_mask & (1u << i))
+      continue;
+    switch (p->id[i]) {
+#ifdef USE_ZLIB
+    case H5Z_FILTER_DEFLATE: {
+      uLongf n = cap;
+      if (uncompress(out, &n, cur, size) != Z_OK)
+        return FAIL;
+      size = n;
+      break;
+    }
+#endif
+    case H5Z_FILTER_SHUFFLE:
+      if (size > cap)
+        return FAIL;
+      unshuffle(cur, size, p->parms[i][0], out);
+      break;
+    case H5Z_FILTER_FLETCHER32:
+      if (size < 4 || !check_fletcher32(cur, size))
+        return FAIL;
+      // the checksum is dropped in place
+      size -= 4;
+      continue;
+    default:
+      return FAIL;
+    }
+    cur = out;
+    k = 1 - k;
+  }
+  if (size != t->dst_size)
+    return FAIL;
+  memcpy(t->dst, cur, size);
+  return SUCCEED;
+}
+
+typedef struct _decode_job_t {
+  const FILTER_PIPELINE *pipeline;
+  DECODE_TASK *tasks;
+  size_t n;
+  size_t next;  // next task to decode
+  size_t ndone; // number of tasks decoded
+  size_t cap;   // size of the scratch buffers
+  struct _decode_job_t *next_job;
+} decode_job_t;
+
+struct _DECODE_POOL {
+  pthread_mutex_t lock;
+  pthread_cond_t work; // a job was queued, or the pool is freed
+  pthread_cond_t done; // the tasks of a job are all decoded
+  decode_job_t *queue; // jobs with tasks that are not started yet
+  pthread_t *threads;
+  int nthreads; // worker threads (the callers decode as well)
+  bool stop;
+};
+
+// scratch buffers of a thread, grown as needed
+typedef struct _decode_scratch_t {
+  unsigned char *buf[2];
+  size_t cap;
+} decode_scratch_t;
+
+static void grow_scratch(decode_scratch_t *s, size_t cap) {
+  if (s->cap >= cap)
+    return;
+  s->buf[0] = (unsigned char *)realloc(s->buf[0], cap);
+  s->buf[1] = (unsigned char *)realloc(s->buf[1], cap);
+  s->cap = cap;
+}
+
+/* take the next task of a job; the job leaves the queue once all its tasks
+ * are started. Called with the lock held. */
+static size_t take_task(DECODE_POOL *pool, decode_job_t *job) {
+  size_t i = job->next++;
+  if (job->next == job->n) {
+    decode_job_t **q = &pool->queue;
+    while (*q != NULL && *q != job)
+      q = &(*q)->next_job;
+    if (*q != NULL)
+      *q = job->next_job;
+  }
+  return i;
+}
+
+/* decode task i of a job. Called with the lock held, which is released
+ * while decoding. */
+static void run_task(DECODE_POOL *pool, decode_job_t *job, size_t i,
+                     decode_scratch_t *s) {
+  pthread_mutex_unlock(&pool->lock);
+  grow_scratch(s, job->cap);
+  job->tasks[i].ret = decode_chunk(job->pipeline, &job->tasks[i], s->buf,
+                                   job->cap);
+  pthread_mutex_lock(&pool->lock);
+  if (++job->ndone == job->n)
+    pthread_cond_broadcast(&pool->done);
+}
+
+static void *decode_worker(void *arg) {
+  DECODE_POOL *pool = (DECODE_POOL *)arg;
+  decode_scratch_t s = {{NULL, NULL}, 0};
+  pthread_mutex_lock(&pool->lock);
+  while (!pool->stop) {
+    decode_job_t *job = pool->queue;
+    if (job == NULL) {
+      pthread_cond_wait(&pool->work, &pool->lock);
+      continue;
+    }
+    run_task(pool, job, take_task(pool, job), &s);
+  }
+  pthread_mutex_unlock(&pool->lock);
+  free(s.buf[0]);
+  free(s.buf[1]);
+  return NULL;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:    decode_pool_create
+ *
+ * Purpose:     Start a pool of nthreads threads decoding raw chunks, the
+ *              threads calling decode_chunks included. The threads are kept
+ *              until the pool is freed, and wait for chunks to decode in
+ *              the meantime.
+ *
+ * Return:      Success:    the pool
+ *              Failure:    NULL
+ *
+ *---------------------------------------------------------------------------
+ */
+DECODE_POOL *decode_pool_create(int nthreads) {
+  DECODE_POOL *pool = (DECODE_POOL *)calloc(1, sizeof(DECODE_POOL));
+  int t;
+  if (pool == NULL)
+    return NULL;
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->work, NULL);
+  pthread_cond_init(&pool->done, NULL);
+  pool->threads = (pthread_t *)malloc(sizeof(pthread_t) * (nthreads + 1));
+  for (t = 1; t < nthreads; t++)
+    if (pthread_create(&pool->threads[pool->nthreads], NULL, decode_worker,
+                       pool) == 0)
+      pool->nthreads++;
+  return pool;
+}
+
+/* stop the threads of the pool and free it */
+void decode_pool_free(DECODE_POOL *pool) {
+  int t;
+  if (pool == NULL)
+    return;
+  pthread_mutex_lock(&pool->lock);
+  pool->stop = true;
+  pthread_cond_broadcast(&pool->work);
+  pthread_mutex_unlock(&pool->lock);
+  for (t = 0; t < pool->nthreads; t++)
+    pthread_join(pool->threads[t], NULL);
+  pthread_cond_destroy(&pool->work);
+  pthread_cond_destroy(&pool->done);
+  pthread_mutex_destroy(&pool->lock);
+  free(pool->threads);
+  free(pool);
+}
+
+/*---------------------------------------------------------------------------
+ * Function:    decode_chunks
+ *
+ * Purpose:     Decode a list of raw chunks into their destination buffers
+ *              with the threads of the pool; the calling thread decodes
+ *              chunks of the list as well, and returns once they are all
+ *              decoded. The result of each chunk is stored in its task, so
+ *              that the caller can fall back to HDF5 for the chunks that
+ *              failed.
+ *
+ * Return:      Success:    0
+ *              Failure:    -1, at least one chunk was not decoded
+ *
+ *---------------------------------------------------------------------------
+ */
+herr_t decode_chunks(DECODE_POOL *pool, const FILTER_PIPELINE *pipeline,
+                     DECODE_TASK *tasks, size_t n) {
+  decode_job_t job;
+  decode_scratch_t s = {{NULL, NULL}, 0};
+  decode_job_t **q;
+  size_t i;
+  herr_t ret_value = SUCCEED;
+  if (n == 0)
+    return SUCCEED;
+  job.pipeline = pipeline;
+  job.tasks = tasks;
+  job.n = n;
+  job.next = 0;
+  job.ndone = 0;
+  job.cap = 0;
+  job.next_job = NULL;
+  for (i = 0; i < n; i++) {
+    if (tasks[i].raw_size > job.cap)
+      job.cap = tasks[i].raw_size;
+    if (tasks[i].dst_size > job.cap)
+      job.cap = tasks[i].dst_size;
+  }
+  // room for a checksum that is removed after decompression
+  job.cap += 4;
+  if (pool == NULL) {
+    // the pool could not be started; decode the chunks on this thread
+    grow_scratch(&s, job.cap);
+    for (i = 0; i < n; i++)
+      tasks[i].ret = decode_chunk(pipeline, &tasks[i], s.buf, job.cap);
+  } else {
+    pthread_mutex_lock(&pool->lock);
+    for (q = &pool->queue; *q != NULL; q = &(*q)->next_job)
+      ;
+    *q = &job;
+    pthread_cond_broadcast(&pool->work);
+    while (job.next < job.n)
+      run_task(pool, &job, take_task(pool, &job), &s);
+    while (job.ndone < job.n)
+      pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+  }
+  free(s.buf[0]);
+  free(s.buf[1]);
+  for (i = 0; i < n; i++)
+    if (tasks[i].ret < 0)
+      ret_value = FAIL;
+  return ret_value;
+}
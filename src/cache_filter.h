@@ -0,0 +1,62 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright (c) 2023, UChicago Argonne, LLC.                                *
+ * All Rights Reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5 Cache VOL connector.  The full copyright notice *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the LICENSE file, which can be found at the root of the source code       *
+ * distribution tree.                                                        *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*
+  Decoding of raw (filtered) chunks by the cache, so that the chunks of a
+  compressed dataset can be decompressed by several threads and cached
+  decoded.
+ */
+#ifndef CACHE_FILTER_H_
+#define CACHE_FILTER_H_
+#include "hdf5.h"
+#include <stdint.h>
+
+#define MAX_NUM_FILTERS 32
+#define MAX_NUM_FILTER_PARMS 8
+
+// filter pipeline of a chunked dataset, in the order used for writing
+typedef struct _FILTER_PIPELINE {
+  int nfilters;
+  H5Z_filter_t id[MAX_NUM_FILTERS];
+  size_t nparms[MAX_NUM_FILTERS];
+  unsigned int parms[MAX_NUM_FILTERS][MAX_NUM_FILTER_PARMS];
+} FILTER_PIPELINE;
+
+// a raw chunk to decode into its slot in the cache
+typedef struct _DECODE_TASK {
+  uint32_t filter_mask; // filters skipped for this chunk
+  void *raw;            // raw chunk, as stored in the file
+  size_t raw_size;      // size of the raw chunk
+  void *dst;            // decoded chunk
+  size_t dst_size;      // size of the decoded chunk
+  herr_t ret;           // result of the decoding
+} DECODE_TASK;
+
+// threads decoding raw chunks, kept between the reads
+typedef struct _DECODE_POOL DECODE_POOL;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+// get the filter pipeline of a dataset; fails if a filter can't be decoded
+herr_t get_filter_pipeline(hid_t dcpl_id, FILTER_PIPELINE *pipeline);
+// fletcher32 checksum of a buffer, as computed by HDF5
+uint32_t checksum_fletcher32(const void *data, size_t len);
+// start a pool of nthreads threads (the callers included) decoding chunks
+DECODE_POOL *decode_pool_create(int nthreads);
+// stop the threads of a pool and free it
+void decode_pool_free(DECODE_POOL *pool);
+// decode a list of raw chunks with the threads of a pool
+herr_t decode_chunks(DECODE_POOL *pool, const FILTER_PIPELINE *pipeline,
+                     DECODE_TASK *tasks, size_t n);
+#ifdef __cplusplus
+}
+#endif
+#endif // CACHE_FILTER_H_
@@ -23,6 +23,8 @@ int RANK = 0;
 int NPROC = 1;
 
 static int H5VL_new_api_dataset_prefetch_op_g = -1;
+static int H5VL_new_api_dataset_prefetch_schedule_op_g = -1;
+static int H5VL_new_api_dataset_prefetch_status_op_g = -1;
 static int H5VL_new_api_dataset_read_to_cache_op_g = -1;
 static int H5VL_new_api_dataset_read_from_cache_op_g = -1;
 static int H5VL_new_api_dataset_mmap_remap_op_g = -1;
@@ -40,6 +42,8 @@ static int H5VL_new_api_dataset_cache_async_op_start_op_g = -1;
 
 static void cache_ext_reset(void *_ctx) {
   H5VL_new_api_dataset_prefetch_op_g = -1;
+  H5VL_new_api_dataset_prefetch_schedule_op_g = -1;
+  H5VL_new_api_dataset_prefetch_status_op_g = -1;
   H5VL_new_api_dataset_read_to_cache_op_g = -1;
   H5VL_new_api_dataset_read_from_cache_op_g = -1;
   H5VL_new_api_dataset_mmap_remap_op_g = -1;
@@ -104,6 +108,17 @@ static int cache_ext_setup(void) {
                              &H5VL_new_api_dataset_prefetch_op_g) < 0) {
     return (-1);
   }
+  if (H5VLfind_opt_operation(H5VL_SUBCLS_DATASET,
+                             H5VL_CACHE_EXT_DYN_DPREFETCH_SCHEDULE,
+                             &H5VL_new_api_dataset_prefetch_schedule_op_g) <
+      0) {
+    return (-1);
+  }
+  if (H5VLfind_opt_operation(H5VL_SUBCLS_DATASET,
+                             H5VL_CACHE_EXT_DYN_DPREFETCH_STATUS,
+                             &H5VL_new_api_dataset_prefetch_status_op_g) < 0) {
+    return (-1);
+  }
   if (H5VLfind_opt_operation(H5VL_SUBCLS_DATASET,
                              H5VL_CACHE_EXT_DYN_DREAD_FROM_CACHE,
                              &H5VL_new_api_dataset_read_from_cache_op_g) < 0) {
@@ -358,6 +373,88 @@ herr_t H5Dprefetch_async(const char *app_file, const char *app_func,
   return 0;
 } /* end H5Dpefetch_asyc() */
 
+/*-------------------------------------------------------------------------
+ * Function:    H5Dprefetch_schedule
+ *
+ * Purpose:     Register the samples that the calling rank will read next,
+ *              in the order of the reads, grouped into batches of
+ *              batch_size samples (e.g., the shuffled indices of the next
+ *              epoch of a training). The cache stages the upcoming batches
+ *              a few batches ahead of the reads.
+ *
+ * Return:      Success:    0
+ *              Failure:    -1
+ *
+ *-------------------------------------------------------------------------
+ */
+herr_t H5Dprefetch_schedule(const char *app_file, const char *app_func,
+                            unsigned app_line, hid_t dset_id,
+                            const hsize_t *indices, size_t n,
+                            size_t batch_size, hid_t plist_id, hid_t es_id) {
+  H5VL_optional_args_t
+      vol_cb_args; /* Wrapper for invoking optional operation */
+  H5VL_cache_ext_dataset_prefetch_schedule_args_t opt_args;
+
+  if (cache_ext_setup() < 0) {
+    cache_ext_new_h5api_op_unfound_msg(__FUNCTION__, app_file, app_line);
+    return (-1);
+  }
+  assert(0 < H5VL_new_api_dataset_prefetch_schedule_op_g);
+
+  /* Set up args for invoking optional callback */
+  opt_args.indices = indices;
+  opt_args.n = n;
+  opt_args.batch_size = batch_size;
+  vol_cb_args.op_type = H5VL_new_api_dataset_prefetch_schedule_op_g;
+  vol_cb_args.args = &opt_args;
+
+  if (H5VLdataset_optional_op_wrap(app_file, app_func, app_line, dset_id,
+                                   &vol_cb_args, plist_id, es_id) < 0)
+    return (-1);
+
+  return 0;
+} /* end H5Dprefetch_schedule() */
+
+/*-------------------------------------------------------------------------
+ * Function:    H5Dprefetch_status
+ *
+ * Purpose:     Query the progress of the prefetch of the dataset on the
+ *              calling rank: bytes_done bytes of the bytes_total bytes
+ *              prefetched by the rank have landed in the cache (and can be
+ *              read from it). Both are 0 if nothing was prefetched.
+ *
+ * Return:      Success:    0
+ *              Failure:    -1
+ *
+ *-------------------------------------------------------------------------
+ */
+herr_t H5Dprefetch_status(const char *app_file, const char *app_func,
+                          unsigned app_line, hid_t dset_id,
+                          hsize_t *bytes_done, hsize_t *bytes_total) {
+  H5VL_optional_args_t
+      vol_cb_args; /* Wrapper for invoking optional operation */
+  H5VL_cache_ext_dataset_prefetch_status_args_t opt_args;
+
+  if (cache_ext_setup() < 0) {
+    cache_ext_new_h5api_op_unfound_msg(__FUNCTION__, app_file, app_line);
+    return (-1);
+  }
+  assert(0 < H5VL_new_api_dataset_prefetch_status_op_g);
+
+  /* Set up args for invoking optional callback */
+  opt_args.bytes_done = bytes_done;
+  opt_args.bytes_total = bytes_total;
+  vol_cb_args.op_type = H5VL_new_api_dataset_prefetch_status_op_g;
+  vol_cb_args.args = &opt_args;
+
+  if (H5VLdataset_optional_op_wrap(app_file, app_func, app_line, dset_id,
+                                   &vol_cb_args, H5P_DATASET_XFER_DEFAULT,
+                                   H5ES_NONE) < 0)
+    return (-1);
+
+  return 0;
+} /* end H5Dprefetch_status() */
+
 /*-------------------------------------------------------------------------
  * Function:    H5Dread_from_cache
  *
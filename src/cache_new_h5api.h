@@ -49,6 +49,13 @@ herr_t H5Dprefetch(const char *app_file, const char *app_func,
 herr_t H5Dprefetch_async(const char *app_file, const char *app_func,
                          unsigned app_line, hid_t dset_id, hid_t file_space_id,
                          hid_t dxpl_id, hid_t es_id);
+herr_t H5Dprefetch_schedule(const char *app_file, const char *app_func,
+                            unsigned app_line, hid_t dset_id,
+                            const hsize_t *indices, size_t n,
+                            size_t batch_size, hid_t dxpl_id, hid_t es_id);
+herr_t H5Dprefetch_status(const char *app_file, const char *app_func,
+                          unsigned app_line, hid_t dset_id,
+                          hsize_t *bytes_done, hsize_t *bytes_total);
 herr_t H5Dread_to_cache(const char *app_file, const char *app_func,
                         unsigned app_line, hid_t dset_id, hid_t mem_type_id,
                         hid_t memspace_id, hid_t file_space_id, hid_t dxpl_id,
@@ -108,6 +115,10 @@ H5_DLL hid_t H5VL_cache_ext_register(void);
 #define H5Dprefetch(...) H5Dprefetch(__FILE__, __func__, __LINE__, __VA_ARGS__)
 #define H5Dprefetch_async(...)                                                 \
   H5Dprefetch_async(__FILE__, __func__, __LINE__, __VA_ARGS__)
+#define H5Dprefetch_schedule(...)                                              \
+  H5Dprefetch_schedule(__FILE__, __func__, __LINE__, __VA_ARGS__)
+#define H5Dprefetch_status(...)                                                \
+  H5Dprefetch_status(__FILE__, __func__, __LINE__, __VA_ARGS__)
 #define H5Dread_to_cache(...)                                                  \
   H5Dread_to_cache(__FILE__, __func__, __LINE__, __VA_ARGS__)
 #define H5Dread_to_cache_async(...)                                            \
@@ -12,12 +12,16 @@
 #include "stdlib.h"
 #include "string.h"
 #include "unistd.h"
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
 #include <stdio.h>
 // POSIX I/O
 #include "cache_utils.h"
 #include "hdf5.h"
 #include "sys/stat.h"
 #include <dirent.h>
+#include <pthread.h>
 #include <sys/mman.h>
 #include <sys/statvfs.h>
 #include <sys/types.h>
@@ -29,6 +33,16 @@
 */
 #define MAXDIM 32
 #define PAGESIZE sysconf(_SC_PAGE_SIZE)
+#ifndef SUCCEED
+#define SUCCEED 0
+#endif
+#ifndef FAIL
+#define FAIL -1
+#endif
+// segment lists shorter than this are sorted with a single qsort
+#define RMA_SORT_BUCKET_MIN 4096
+// sample runs selected one by one before the selections are merged
+#define SAMPLE_RUN_MERGE_MIN 64
 
 void int2char(int a, char str[255]) { sprintf(str, "%d", a); }
 
@@ -55,7 +69,7 @@ void parallel_dist(size_t gdim, int nproc, int rank, size_t *ldim,
                    size_t *start) {
   *ldim = gdim / nproc;
   *start = *ldim * rank;
-  if (rank < gdim % nproc) {
+  if ((size_t)rank < gdim % nproc) {
     *ldim += 1;
     *start += rank;
   } else {
@@ -64,25 +78,241 @@ void parallel_dist(size_t gdim, int nproc, int rank, size_t *ldim,
 }
 
 /*
-  Given a sample list, perform hyperslab selection for filespace;
+  Inverse of parallel_dist: find the rank that holds the global sample and the
+  index of the sample within that rank.
  */
-void set_hyperslab_from_samples(int *samples, int nsample, hid_t *fspace) {
-  static hsize_t gdims[MAXDIM], count[MAXDIM], sample[MAXDIM], offset[MAXDIM];
-  int ndims = H5Sget_simple_extent_dims(*fspace, gdims, NULL);
-  sample[0] = 1;
-  count[0] = 1;
-  offset[0] = samples[0]; // set the offset
+void get_sample_owner(size_t gdim, int nproc, size_t sample, int *rank,
+                      size_t *local) {
+  size_t q = gdim / nproc;
+  size_t r = gdim % nproc;
+  size_t boundary = r * (q + 1);
+  if (sample < boundary) {
+    *rank = sample / (q + 1);
+    *local = sample % (q + 1);
+  } else {
+    *rank = r + (sample - boundary) / q;
+    *local = (sample - boundary) % q;
+  }
+}
+
+static int compare_rma_segments(const void *a, const void *b) {
+  const RMA_SEG *x = (const RMA_SEG *)a;
+  const RMA_SEG *y = (const RMA_SEG *)b;
+  if (x->rank != y->rank)
+    return (x->rank < y->rank) ? -1 : 1;
+  if (x->disp != y->disp)
+    return (x->disp < y->disp) ? -1 : 1;
+  return (x->pos < y->pos) ? -1 : (x->pos > y->pos);
+}
+
+static int compare_rma_disp(const void *a, const void *b) {
+  const RMA_SEG *x = (const RMA_SEG *)a;
+  const RMA_SEG *y = (const RMA_SEG *)b;
+  if (x->disp != y->disp)
+    return (x->disp < y->disp) ? -1 : 1;
+  return (x->pos < y->pos) ? -1 : (x->pos > y->pos);
+}
+
+/* whether the segments are already in (rank, disp, pos) order */
+static bool rma_segments_sorted(const RMA_SEG *segs, size_t n) {
+  size_t i;
+  for (i = 1; i < n; i++)
+    if (compare_rma_segments(&segs[i - 1], &segs[i]) > 0)
+      return false;
+  return true;
+}
+
+/*
+  Sort the segments so that all the segments targeting the same rank are
+  adjacent and appear in the order of their offset in the window. Large lists
+  (e.g., one segment per selected point) are bucketed by rank with a counting
+  sort first, so that only the segments of each rank are compared.
+ */
+void sort_rma_segments(RMA_SEG *segs, size_t n) {
+  size_t i, start;
+  int r, nrank = 0;
+  if (rma_segments_sorted(segs, n))
+    return;
+  for (i = 0; i < n; i++)
+    if (segs[i].rank >= nrank)
+      nrank = segs[i].rank + 1;
+  if (n < RMA_SORT_BUCKET_MIN || nrank < 2) {
+    qsort(segs, n, sizeof(RMA_SEG), compare_rma_segments);
+    return;
+  }
+  size_t *count = (size_t *)calloc(nrank + 1, sizeof(size_t));
+  RMA_SEG *tmp = (RMA_SEG *)malloc(sizeof(RMA_SEG) * n);
+  for (i = 0; i < n; i++)
+    count[segs[i].rank + 1]++;
+  for (r = 0; r < nrank; r++)
+    count[r + 1] += count[r];
+  for (i = 0; i < n; i++)
+    tmp[count[segs[i].rank]++] = segs[i];
+  memcpy(segs, tmp, sizeof(RMA_SEG) * n);
+  // count[r] is now the end of the bucket of rank r
+  start = 0;
+  for (r = 0; r < nrank; r++) {
+    if (!rma_segments_sorted(&segs[start], count[r] - start))
+      qsort(&segs[start], count[r] - start, sizeof(RMA_SEG), compare_rma_disp);
+    start = count[r];
+  }
+  free(count);
+  free(tmp);
+}
+
+/*
+  Remove the segments of a sorted list that target the same location as the
+  previous segment, so that a location is not updated twice in one epoch.
+  Return the number of segments left.
+ */
+size_t unique_rma_segments(RMA_SEG *segs, size_t n) {
+  size_t i, m = 0;
+  for (i = 0; i < n; i++)
+    if (m == 0 || segs[i].rank != segs[m - 1].rank ||
+        segs[i].disp != segs[m - 1].disp)
+      segs[m++] = segs[i];
+  return m;
+}
+
+static int compare_samples(const void *a, const void *b) {
+  int x = *(const int *)a;
+  int y = *(const int *)b;
+  return (x > y) - (x < y);
+}
+
+/*
+  Sort the samples in increasing order and remove the duplicates. Return the
+  number of unique samples.
+ */
+int sort_unique_samples(int *samples, int n) {
+  int i, m = 0;
+  qsort(samples, n, sizeof(int), compare_samples);
+  for (i = 0; i < n; i++)
+    if (m == 0 || samples[i] != samples[m - 1])
+      samples[m++] = samples[i];
+  return m;
+}
+
+/*
+  Binary search of a sample in a sorted list of samples.
+ */
+int find_sample(const int *samples, int n, int sample) {
+  int lo = 0, hi = n - 1;
+  while (lo <= hi) {
+    int mid = lo + (hi - lo) / 2;
+    if (samples[mid] == sample)
+      return mid;
+    if (samples[mid] < sample)
+      lo = mid + 1;
+    else
+      hi = mid - 1;
+  }
+  return -1;
+}
+
+/* select the samples [start, start + count) of a dataspace */
+static void select_sample_run(hid_t space, H5S_seloper_t op, hsize_t start,
+                              hsize_t count, int ndims, const hsize_t *gdims) {
+  hsize_t offset[MAXDIM], block[MAXDIM];
   int i;
+  offset[0] = start;
+  block[0] = count;
   for (i = 1; i < ndims; i++) {
     offset[i] = 0;
-    sample[i] = gdims[i];
-    count[i] = 1;
+    block[i] = gdims[i];
+  }
+  H5Sselect_hyperslab(space, op, offset, NULL, block, NULL);
+}
+
+/* build the selection of the runs [lo, hi) on a copy of space; the two
+ * halves are built separately and merged, so that the cost of merging the
+ * runs stays O(n log n) instead of growing with each run added */
+static hid_t select_sample_runs(hid_t space, const hsize_t *start,
+                                const hsize_t *count, size_t lo, size_t hi,
+                                int ndims, const hsize_t *gdims) {
+  size_t i;
+  if (hi - lo <= SAMPLE_RUN_MERGE_MIN) {
+    hid_t s = H5Scopy(space);
+    select_sample_run(s, H5S_SELECT_SET, start[lo], count[lo], ndims, gdims);
+    for (i = lo + 1; i < hi; i++)
+      select_sample_run(s, H5S_SELECT_OR, start[i], count[i], ndims, gdims);
+    return s;
+  }
+  size_t mid = lo + (hi - lo) / 2;
+  hid_t left = select_sample_runs(space, start, count, lo, mid, ndims, gdims);
+  hid_t right = select_sample_runs(space, start, count, mid, hi, ndims, gdims);
+  hid_t s = H5Scombine_select(left, H5S_SELECT_OR, right);
+  H5Sclose(left);
+  H5Sclose(right);
+  return s;
+}
+
+/*
+  Given a sample list, perform hyperslab selection for filespace. The
+  samples are sorted (on a copy, if they are not sorted already) and the
+  runs of consecutive samples are selected as single blocks. Runs of the
+  same length at a constant distance are selected with a single strided
+  hyperslab; any other list of runs is built in one pass (see
+  select_sample_runs).
+ */
+void set_hyperslab_from_samples(int *samples, int nsample, hid_t *fspace) {
+  hsize_t gdims[MAXDIM];
+  int ndims = H5Sget_simple_extent_dims(*fspace, gdims, NULL);
+  int *sorted = samples;
+  int i, n = nsample;
+  size_t nrun = 0, k;
+  if (nsample <= 0) {
+    H5Sselect_none(*fspace);
+    return;
+  }
+  for (i = 1; i < nsample; i++)
+    if (samples[i] <= samples[i - 1])
+      break;
+  if (i < nsample) {
+    sorted = (int *)malloc(sizeof(int) * nsample);
+    memcpy(sorted, samples, sizeof(int) * nsample);
+    n = sort_unique_samples(sorted, nsample);
   }
-  H5Sselect_hyperslab(*fspace, H5S_SELECT_SET, offset, NULL, sample, count);
-  for (i = 1; i < nsample; i++) {
-    offset[0] = samples[i];
-    H5Sselect_hyperslab(*fspace, H5S_SELECT_OR, offset, NULL, sample, count);
+  hsize_t *start = (hsize_t *)malloc(sizeof(hsize_t) * n);
+  hsize_t *count = (hsize_t *)malloc(sizeof(hsize_t) * n);
+  for (i = 0; i < n; i++) {
+    if (nrun > 0 && start[nrun - 1] + count[nrun - 1] == (hsize_t)sorted[i]) {
+      count[nrun - 1]++;
+      continue;
+    }
+    start[nrun] = sorted[i];
+    count[nrun++] = 1;
+  }
+  // regular pattern: runs of the same length at a constant stride
+  bool regular = (nrun > 1);
+  for (k = 1; k < nrun && regular; k++)
+    regular = (count[k] == count[0] &&
+               start[k] - start[k - 1] == start[1] - start[0]);
+  if (nrun == 1) {
+    select_sample_run(*fspace, H5S_SELECT_SET, start[0], count[0], ndims,
+                      gdims);
+  } else if (regular) {
+    hsize_t offset[MAXDIM], stride[MAXDIM], cnt[MAXDIM], block[MAXDIM];
+    offset[0] = start[0];
+    stride[0] = start[1] - start[0];
+    cnt[0] = nrun;
+    block[0] = count[0];
+    for (i = 1; i < ndims; i++) {
+      offset[i] = 0;
+      stride[i] = 1;
+      cnt[i] = 1;
+      block[i] = gdims[i];
+    }
+    H5Sselect_hyperslab(*fspace, H5S_SELECT_SET, offset, stride, cnt, block);
+  } else {
+    hid_t s = select_sample_runs(*fspace, start, count, 0, nrun, ndims, gdims);
+    H5Sselect_copy(*fspace, s);
+    H5Sclose(s);
   }
+  free(start);
+  free(count);
+  if (sorted != samples)
+    free(sorted);
 }
 /*
   Get the indices of the samples that have been selected from filespace, and
@@ -118,6 +348,330 @@ void get_samples_from_filespace(hid_t fspace, BATCH *samples, bool *contig) {
   free(block_buf);
 }
 
+static pthread_key_t seq_scratch_key;
+static pthread_once_t seq_scratch_once = PTHREAD_ONCE_INIT;
+
+static void create_seq_scratch_key(void) {
+  pthread_key_create(&seq_scratch_key, free);
+}
+
+/*
+  Get the scratch space of the calling thread for the sequence lists of a
+  selection iterator. It is allocated on first use and reused by all the
+  copies done by the thread, so that walking a selection in batches of
+  SEQ_LIST_BATCH sequences takes a fixed amount of memory, whatever the size
+  of the selection. It is freed when the thread exits.
+ */
+SEQ_SCRATCH *get_seq_scratch(void) {
+  SEQ_SCRATCH *scratch;
+  pthread_once(&seq_scratch_once, create_seq_scratch_key);
+  scratch = (SEQ_SCRATCH *)pthread_getspecific(seq_scratch_key);
+  if (scratch == NULL) {
+    scratch = (SEQ_SCRATCH *)malloc(sizeof(SEQ_SCRATCH));
+    if (scratch != NULL && pthread_setspecific(seq_scratch_key, scratch)) {
+      free(scratch);
+      scratch = NULL;
+    }
+  }
+  return scratch;
+}
+
+/*
+  Conversion kernels for the common pairs of numeric types. The loops are
+  written so that the compiler can vectorize them.
+ */
+/* values out of the range of float become +/-inf, as with H5Tconvert */
+static void convert_double_float(void *dst, const void *src, size_t n) {
+  float *restrict d = (float *)dst;
+  const double *restrict s = (const double *)src;
+  size_t i;
+  for (i = 0; i < n; i++)
+    d[i] = (s[i] > FLT_MAX)    ? HUGE_VALF
+           : (s[i] < -FLT_MAX) ? -HUGE_VALF
+                               : (float)s[i];
+}
+
+static void convert_float_double(void *dst, const void *src, size_t n) {
+  double *restrict d = (double *)dst;
+  const float *restrict s = (const float *)src;
+  size_t i;
+  for (i = 0; i < n; i++)
+    d[i] = s[i];
+}
+
+static void convert_int_double(void *dst, const void *src, size_t n) {
+  double *restrict d = (double *)dst;
+  const int *restrict s = (const int *)src;
+  size_t i;
+  for (i = 0; i < n; i++)
+    d[i] = s[i];
+}
+
+static void convert_int_float(void *dst, const void *src, size_t n) {
+  float *restrict d = (float *)dst;
+  const int *restrict s = (const int *)src;
+  size_t i;
+  for (i = 0; i < n; i++)
+    d[i] = (float)s[i];
+}
+
+static void convert_uchar_float(void *dst, const void *src, size_t n) {
+  float *restrict d = (float *)dst;
+  const unsigned char *restrict s = (const unsigned char *)src;
+  size_t i;
+  for (i = 0; i < n; i++)
+    d[i] = s[i];
+}
+
+static void swap_bytes_2(void *dst, const void *src, size_t n) {
+  uint16_t *restrict d = (uint16_t *)dst;
+  const uint16_t *restrict s = (const uint16_t *)src;
+  size_t i;
+  for (i = 0; i < n; i++)
+    d[i] = __builtin_bswap16(s[i]);
+}
+
+static void swap_bytes_4(void *dst, const void *src, size_t n) {
+  uint32_t *restrict d = (uint32_t *)dst;
+  const uint32_t *restrict s = (const uint32_t *)src;
+  size_t i;
+  for (i = 0; i < n; i++)
+    d[i] = __builtin_bswap32(s[i]);
+}
+
+static void swap_bytes_8(void *dst, const void *src, size_t n) {
+  uint64_t *restrict d = (uint64_t *)dst;
+  const uint64_t *restrict s = (const uint64_t *)src;
+  size_t i;
+  for (i = 0; i < n; i++)
+    d[i] = __builtin_bswap64(s[i]);
+}
+
+/* whether two types only differ by their byte order */
+static bool is_swapped_type(hid_t src_type, hid_t dst_type) {
+  H5T_class_t c = H5Tget_class(src_type);
+  H5T_order_t order = H5Tget_order(dst_type);
+  bool ret_value;
+  if ((c != H5T_INTEGER && c != H5T_FLOAT) || c != H5Tget_class(dst_type) ||
+      H5Tget_size(src_type) != H5Tget_size(dst_type) ||
+      H5Tget_order(src_type) == order ||
+      (order != H5T_ORDER_LE && order != H5T_ORDER_BE))
+    return false;
+  hid_t t = H5Tcopy(src_type);
+  ret_value = (H5Tset_order(t, order) >= 0 && H5Tequal(t, dst_type) > 0);
+  H5Tclose(t);
+  return ret_value;
+}
+
+/*
+  Get a kernel converting elements from src_type to dst_type, NULL if the
+  pair of types is not handled by a kernel (the conversion then has to go
+  through H5Tconvert).
+ */
+convert_kernel_t get_convert_kernel(hid_t src_type, hid_t dst_type) {
+  if (H5Tequal(src_type, H5T_NATIVE_DOUBLE) > 0) {
+    if (H5Tequal(dst_type, H5T_NATIVE_FLOAT) > 0)
+      return convert_double_float;
+  } else if (H5Tequal(src_type, H5T_NATIVE_FLOAT) > 0) {
+    if (H5Tequal(dst_type, H5T_NATIVE_DOUBLE) > 0)
+      return convert_float_double;
+  } else if (H5Tequal(src_type, H5T_NATIVE_INT) > 0) {
+    if (H5Tequal(dst_type, H5T_NATIVE_DOUBLE) > 0)
+      return convert_int_double;
+    if (H5Tequal(dst_type, H5T_NATIVE_FLOAT) > 0)
+      return convert_int_float;
+  } else if (H5Tequal(src_type, H5T_NATIVE_UCHAR) > 0) {
+    if (H5Tequal(dst_type, H5T_NATIVE_FLOAT) > 0)
+      return convert_uchar_float;
+  }
+  if (is_swapped_type(src_type, dst_type)) {
+    switch (H5Tget_size(src_type)) {
+    case 2:
+      return swap_bytes_2;
+    case 4:
+      return swap_bytes_4;
+    case 8:
+      return swap_bytes_8;
+    }
+  }
+  return NULL;
+}
+
+/*
+  Whether the selection of space is a single contiguous range of elements of
+  esize bytes; offset is then the byte offset of the range in the buffer.
+ */
+bool is_contiguous_selection(hid_t space, size_t esize, hsize_t *offset) {
+  hssize_t npoints = H5Sget_select_npoints(space);
+  size_t nseq, nbytes, len;
+  bool ret_value;
+  if (npoints < 0)
+    return false;
+  *offset = 0;
+  if (npoints == 0)
+    return true;
+  hid_t iter = H5Ssel_iter_create(space, esize, 0);
+  if (iter < 0)
+    return false;
+  ret_value = (H5Ssel_iter_get_seq_list(iter, 1, SIZE_MAX, &nseq, &nbytes,
+                                        offset, &len) >= 0 &&
+               nseq == 1 && len == (size_t)npoints * esize);
+  H5Ssel_iter_close(iter);
+  return ret_value;
+}
+
+/* convert n elements to a buffer that H5Tconvert can work in, i.e., large
+ * enough for n elements of the larger of the two types; returns NULL if the
+ * conversion failed. Compound conversions get a zeroed background buffer,
+ * so that the members only in dst_type are zero. */
+static char *convert_elements(const void *src, hid_t src_type, hid_t dst_type,
+                              size_t n) {
+  size_t ssize = H5Tget_size(src_type), dsize = H5Tget_size(dst_type);
+  char *tmp = (char *)malloc(n * ((ssize > dsize) ? ssize : dsize) + 1);
+  char *bkg = NULL;
+  herr_t ret;
+  if (tmp == NULL)
+    return NULL;
+  if (H5Tget_class(src_type) == H5T_COMPOUND ||
+      H5Tget_class(dst_type) == H5T_COMPOUND) {
+    bkg = (char *)calloc(n, dsize);
+    if (bkg == NULL) {
+      free(tmp);
+      return NULL;
+    }
+  }
+  memcpy(tmp, src, n * ssize);
+  ret = H5Tconvert(src_type, dst_type, n, tmp, bkg, H5P_DEFAULT);
+  free(bkg);
+  if (ret < 0) {
+    free(tmp);
+    return NULL;
+  }
+  return tmp;
+}
+
+/*
+  Move the elements of a selection between a packed buffer (the elements
+  back to back, in the order of the selection) and a memory buffer with the
+  selection of space, converting them from src_type to dst_type. The
+  selection is walked in batches of sequences, so that the memory used does
+  not depend on the size of the selection.
+ */
+static herr_t copy_selection(char *packed, char *mem, hid_t space,
+                             size_t mem_esize, bool to_mem, hid_t src_type,
+                             hid_t dst_type) {
+  SEQ_SCRATCH *scratch = get_seq_scratch();
+  hsize_t *off;
+  size_t *len;
+  size_t nseq, nbytes, i, p = 0;
+  size_t ssize = H5Tget_size(src_type), dsize = H5Tget_size(dst_type);
+  size_t packed_esize = to_mem ? ssize : dsize;
+  convert_kernel_t kernel = NULL;
+  if (H5Tequal(src_type, dst_type) <= 0 &&
+      NULL == (kernel = get_convert_kernel(src_type, dst_type)))
+    return FAIL;
+  if (scratch == NULL)
+    return FAIL;
+  off = scratch->off;
+  len = scratch->len;
+  hid_t iter = H5Ssel_iter_create(space, mem_esize, 0);
+  if (iter < 0)
+    return FAIL;
+  do {
+    if (H5Ssel_iter_get_seq_list(iter, SEQ_LIST_BATCH, SIZE_MAX, &nseq,
+                                 &nbytes, off, len) < 0) {
+      H5Ssel_iter_close(iter);
+      return FAIL;
+    }
+    for (i = 0; i < nseq; i++) {
+      size_t n = len[i] / mem_esize;
+      char *m = mem + off[i];
+      if (kernel == NULL)
+        memcpy(to_mem ? m : packed + p, to_mem ? packed + p : m, len[i]);
+      else if (to_mem)
+        kernel(m, packed + p, n);
+      else
+        kernel(packed + p, m, n);
+      p += n * packed_esize;
+    }
+  } while (nseq == SEQ_LIST_BATCH);
+  H5Ssel_iter_close(iter);
+  return SUCCEED;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:    scatter_to_memory
+ *
+ * Purpose:     Copy the elements of src, stored back to back in src_type,
+ *              to the selection of mem_space in buf, converting them to
+ *              mem_type. Common numeric pairs (and byte swaps) go through
+ *              a conversion kernel; other pairs are converted with
+ *              H5Tconvert first.
+ *
+ * Return:      Success:    0
+ *              Failure:    -1
+ *
+ *---------------------------------------------------------------------------
+ */
+herr_t scatter_to_memory(const void *src, hid_t src_type, void *buf,
+                         hid_t mem_type, hid_t mem_space) {
+  hssize_t npoints = H5Sget_select_npoints(mem_space);
+  size_t esize = H5Tget_size(mem_type);
+  herr_t ret_value;
+  if (npoints <= 0)
+    return (npoints < 0) ? FAIL : SUCCEED;
+  if (H5Tequal(src_type, mem_type) > 0 ||
+      get_convert_kernel(src_type, mem_type) != NULL)
+    return copy_selection((char *)src, (char *)buf, mem_space, esize, true,
+                          src_type, mem_type);
+  char *tmp = convert_elements(src, src_type, mem_type, npoints);
+  if (tmp == NULL)
+    return FAIL;
+  ret_value = copy_selection(tmp, (char *)buf, mem_space, esize, true,
+                             mem_type, mem_type);
+  free(tmp);
+  return ret_value;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:    gather_from_memory
+ *
+ * Purpose:     Inverse of scatter_to_memory: copy the elements of the
+ *              selection of mem_space in buf to dst, back to back, and
+ *              convert them from mem_type to dst_type.
+ *
+ * Return:      Success:    0
+ *              Failure:    -1
+ *
+ *---------------------------------------------------------------------------
+ */
+herr_t gather_from_memory(const void *buf, hid_t mem_type, hid_t mem_space,
+                          void *dst, hid_t dst_type) {
+  hssize_t npoints = H5Sget_select_npoints(mem_space);
+  size_t esize = H5Tget_size(mem_type);
+  herr_t ret_value;
+  if (npoints <= 0)
+    return (npoints < 0) ? FAIL : SUCCEED;
+  if (H5Tequal(mem_type, dst_type) > 0 ||
+      get_convert_kernel(mem_type, dst_type) != NULL)
+    return copy_selection((char *)dst, (char *)buf, mem_space, esize, false,
+                          mem_type, dst_type);
+  char *tmp = (char *)malloc(npoints * esize + 1);
+  ret_value = copy_selection(tmp, (char *)buf, mem_space, esize, false,
+                             mem_type, mem_type);
+  if (ret_value >= 0) {
+    char *conv = convert_elements(tmp, mem_type, dst_type, npoints);
+    if (conv == NULL) {
+      ret_value = FAIL;
+    } else {
+      memcpy(dst, conv, npoints * H5Tget_size(dst_type));
+      free(conv);
+    }
+  }
+  free(tmp);
+  return ret_value;
+}
+
 /*
    Create directory recursively by providing a path.
 */
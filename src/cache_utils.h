@@ -24,6 +24,18 @@
 #define MAXDIM 32
 #endif
 
+// number of sequences fetched at a time when walking a selection
+#define SEQ_LIST_BATCH 1024
+
+// per-thread scratch space for the sequence lists of a selection iterator
+typedef struct _SEQ_SCRATCH {
+  hsize_t off[SEQ_LIST_BATCH];
+  size_t len[SEQ_LIST_BATCH];
+} SEQ_SCRATCH;
+
+// convert n elements from src to dst
+typedef void (*convert_kernel_t)(void *dst, const void *src, size_t n);
+
 #define newobj(a, b) b * = (b *)malloc(sizeof(b))
 // The meta data for I/O thread to perform parallel write
 
@@ -42,6 +54,29 @@ void get_samples_from_filespace(hid_t fspace, BATCH *samples, bool *contiguous);
 hsize_t get_buf_size(hid_t mspace, hid_t tid);
 void parallel_dist(size_t dim, int nproc, int rank, size_t *ldim,
                    size_t *start);
+// get the rank holding a sample under parallel_dist and its local index there
+void get_sample_owner(size_t gdim, int nproc, size_t sample, int *rank,
+                      size_t *local);
+// sort RMA segments by target rank and window offset
+void sort_rma_segments(RMA_SEG *segs, size_t n);
+// drop sorted segments targeting the same location as the previous one
+size_t unique_rma_segments(RMA_SEG *segs, size_t n);
+// sort a list of samples and remove the duplicates
+int sort_unique_samples(int *samples, int n);
+// index of a sample in a sorted list, -1 if not found
+int find_sample(const int *samples, int n, int sample);
+// scratch space of the calling thread for selection sequence lists
+SEQ_SCRATCH *get_seq_scratch(void);
+// kernel converting between two types, NULL if the pair is not handled
+convert_kernel_t get_convert_kernel(hid_t src_type, hid_t dst_type);
+// whether a selection is a single contiguous range of elements
+bool is_contiguous_selection(hid_t space, size_t esize, hsize_t *offset);
+// copy packed elements to a memory selection, with type conversion
+herr_t scatter_to_memory(const void *src, hid_t src_type, void *buf,
+                         hid_t mem_type, hid_t mem_space);
+// copy the elements of a memory selection to a packed buffer
+herr_t gather_from_memory(const void *buf, hid_t mem_type, hid_t mem_space,
+                          void *dst, hid_t dst_type);
 void int2char(int a, char str[255]);
 void mkdirRecursive(const char *path, mode_t mode);
 herr_t rmdirRecursive(const char *path);
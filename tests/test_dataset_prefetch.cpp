@@ -0,0 +1,220 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright (c) 2023, UChicago Argonne, LLC.                                *
+ * All Rights Reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5 Cache VOL connector.  The full copyright notice *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the LICENSE file, which can be found at the root of the source code       *
+ * distribution tree.                                                        *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+//
+// This test example is for testing the asynchronous prefetch
+// (H5Dprefetch_async and H5Dprefetch_status): the request of the prefetch is
+// waited for before and after the dataset is closed, and the dataset is read
+// collectively (through the cache and from the cache) while the prefetch is
+// in progress and after it completes. The synchronous prefetch (H5Dprefetch)
+// is tested last.
+#include "cache_new_h5api.h"
+#include "hdf5.h"
+#include "mpi.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include <stdlib.h>
+#include <string.h>
+
+// each row (sample) of the dataset holds its index
+static int check_rows(const int *buf, hsize_t first, hsize_t nrows,
+                      hsize_t d2) {
+  int nerr = 0;
+  for (hsize_t i = 0; i < nrows; i++)
+    for (hsize_t j = 0; j < d2; j++)
+      if (buf[i * d2 + j] != (int)(first + i))
+        nerr++;
+  return nerr;
+}
+
+// read the rows of rank r collectively, and check them
+static int read_rows(hid_t dset, int r, hsize_t *ldims, hid_t memspace,
+                     hid_t dxf_id, int *buf) {
+  hid_t fspace = H5Dget_space(dset);
+  hsize_t offset[2] = {r * ldims[0], 0};
+  hsize_t count[2] = {1, 1};
+  H5Sselect_hyperslab(fspace, H5S_SELECT_SET, offset, NULL, count, ldims);
+  memset(buf, 0, ldims[0] * ldims[1] * sizeof(int));
+  herr_t ret = H5Dread(dset, H5T_NATIVE_INT, memspace, fspace, dxf_id, buf);
+  H5Sclose(fspace);
+  if (ret < 0)
+    return 1;
+  return check_rows(buf, offset[0], ldims[0], ldims[1]);
+}
+
+// start the prefetch of the rows of the calling rank
+static herr_t prefetch_rows(hid_t dset, int rank, hsize_t *ldims,
+                            hid_t dxf_id, hid_t es_id) {
+  hid_t fspace = H5Dget_space(dset);
+  hsize_t offset[2] = {rank * ldims[0], 0};
+  hsize_t count[2] = {1, 1};
+  H5Sselect_hyperslab(fspace, H5S_SELECT_SET, offset, NULL, count, ldims);
+  herr_t ret = H5Dprefetch_async(dset, fspace, dxf_id, es_id);
+  H5Sclose(fspace);
+  return ret;
+}
+
+int main(int argc, char **argv) {
+  size_t d1 = 512;
+  size_t d2 = 256;
+  hsize_t ldims[2] = {d1, d2};
+  MPI_Comm comm = MPI_COMM_WORLD;
+  MPI_Info info = MPI_INFO_NULL;
+  int rank, nproc, provided;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
+  MPI_Comm_size(comm, &nproc);
+  MPI_Comm_rank(comm, &rank);
+  hsize_t gdims[2] = {d1 * nproc, d2};
+  if (rank == 0) {
+    printf("****HDF5 Testing Dataset Prefetch*****\n");
+    printf("=============================================\n");
+    printf(" Buf dim: %llu x %llu\n", ldims[0], ldims[1]);
+    printf("   nproc: %d\n", nproc);
+    printf("=============================================\n");
+  }
+  int nerr = 0;
+  hid_t plist_id = H5Pcreate(H5P_FILE_ACCESS);
+  H5Pset_fapl_mpio(plist_id, comm, info);
+  char f[255];
+  strcpy(f, "parallel_file_prefetch.h5");
+  hid_t memspace = H5Screate_simple(2, ldims, NULL);
+  int *data = (int *)malloc(ldims[0] * ldims[1] * sizeof(int));
+  for (hsize_t i = 0; i < ldims[0]; i++)
+    for (hsize_t j = 0; j < ldims[1]; j++)
+      data[i * ldims[1] + j] = rank * ldims[0] + i;
+  hid_t dxf_id = H5Pcreate(H5P_DATASET_XFER);
+  H5Pset_dxpl_mpio(dxf_id, H5FD_MPIO_COLLECTIVE);
+
+  // write the dataset without the read cache
+  if (rank == 0)
+    printf("Creating file %s \n", f);
+  hid_t file_id = H5Fcreate(f, H5F_ACC_TRUNC, H5P_DEFAULT, plist_id);
+  hid_t filespace = H5Screate_simple(2, gdims, NULL);
+  hsize_t offset[2] = {rank * ldims[0], 0};
+  hsize_t count[2] = {1, 1};
+  H5Sselect_hyperslab(filespace, H5S_SELECT_SET, offset, NULL, count, ldims);
+  hid_t dset = H5Dcreate(file_id, "dset_test", H5T_NATIVE_INT, filespace,
+                         H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  H5Dwrite(dset, H5T_NATIVE_INT, memspace, filespace, dxf_id, data);
+  H5Dclose(dset);
+  H5Sclose(filespace);
+  H5Fclose(file_id);
+
+  // reopen it with the read cache
+  setenv("HDF5_CACHE_RD", "yes", 1);
+  file_id = H5Fopen(f, H5F_ACC_RDONLY, plist_id);
+  int shift = (rank + 1) % nproc;
+  size_t num_inprogress;
+  hbool_t error_occured;
+  hsize_t bytes_done, bytes_total;
+
+  // 1) wait for the prefetch, then read the dataset collectively: the rows
+  // of the rank and of the next rank are all read from the cache
+  if (rank == 0)
+    printf("Prefetch, wait, then read\n");
+  dset = H5Dopen(file_id, "dset_test", H5P_DEFAULT);
+  hid_t es_id = H5EScreate();
+  if (prefetch_rows(dset, rank, ldims, dxf_id, es_id) < 0)
+    nerr++;
+  if (H5Dprefetch_status(dset, &bytes_done, &bytes_total) < 0 ||
+      bytes_total != ldims[0] * ldims[1] * sizeof(int) ||
+      bytes_done > bytes_total)
+    nerr++;
+  H5ESwait(es_id, H5ES_WAIT_FOREVER, &num_inprogress, &error_occured);
+  if (num_inprogress != 0 || error_occured)
+    nerr++;
+  if (H5Dprefetch_status(dset, &bytes_done, &bytes_total) < 0 ||
+      bytes_done != bytes_total)
+    nerr++;
+  for (int e = 0; e < 2; e++) {
+    nerr += read_rows(dset, rank, ldims, memspace, dxf_id, data);
+    nerr += read_rows(dset, shift, ldims, memspace, dxf_id, data);
+  }
+  H5ESclose(es_id);
+  H5Dclose(dset);
+
+  // 2) read the dataset collectively while the prefetch is in progress, then
+  // wait for the prefetch and read it again
+  if (rank == 0)
+    printf("Prefetch, read, wait, then read\n");
+  dset = H5Dopen(file_id, "dset_test", H5P_DEFAULT);
+  es_id = H5EScreate();
+  if (prefetch_rows(dset, rank, ldims, dxf_id, es_id) < 0)
+    nerr++;
+  nerr += read_rows(dset, shift, ldims, memspace, dxf_id, data);
+  H5ESwait(es_id, H5ES_WAIT_FOREVER, &num_inprogress, &error_occured);
+  if (num_inprogress != 0 || error_occured)
+    nerr++;
+  nerr += read_rows(dset, rank, ldims, memspace, dxf_id, data);
+  nerr += read_rows(dset, shift, ldims, memspace, dxf_id, data);
+  H5ESclose(es_id);
+  H5Dclose(dset);
+
+  // 3) close the dataset before waiting for the prefetch: the request
+  // outlives the dataset, and can still be waited for and freed
+  if (rank == 0)
+    printf("Prefetch, close, then wait\n");
+  dset = H5Dopen(file_id, "dset_test", H5P_DEFAULT);
+  es_id = H5EScreate();
+  if (prefetch_rows(dset, rank, ldims, dxf_id, es_id) < 0)
+    nerr++;
+  H5Dclose(dset);
+  H5ESwait(es_id, H5ES_WAIT_FOREVER, &num_inprogress, &error_occured);
+  if (num_inprogress != 0 || error_occured)
+    nerr++;
+  H5ESclose(es_id);
+
+  // 4) a second prefetch of the dataset completes the first one, and both
+  // requests complete
+  if (rank == 0)
+    printf("Prefetch twice, then wait\n");
+  dset = H5Dopen(file_id, "dset_test", H5P_DEFAULT);
+  es_id = H5EScreate();
+  if (prefetch_rows(dset, rank, ldims, dxf_id, es_id) < 0 ||
+      prefetch_rows(dset, rank, ldims, dxf_id, es_id) < 0)
+    nerr++;
+  H5ESwait(es_id, H5ES_WAIT_FOREVER, &num_inprogress, &error_occured);
+  if (num_inprogress != 0 || error_occured)
+    nerr++;
+  nerr += read_rows(dset, shift, ldims, memspace, dxf_id, data);
+  H5Dclose(dset);
+  H5ESclose(es_id);
+
+  // 5) a synchronous prefetch of the rows of the rank, then read
+  if (rank == 0)
+    printf("Prefetch synchronously, then read\n");
+  dset = H5Dopen(file_id, "dset_test", H5P_DEFAULT);
+  hid_t fspace = H5Dget_space(dset);
+  H5Sselect_hyperslab(fspace, H5S_SELECT_SET, offset, NULL, count, ldims);
+  if (H5Dprefetch(dset, fspace, dxf_id) < 0)
+    nerr++;
+  if (H5Dprefetch_status(dset, &bytes_done, &bytes_total) < 0 ||
+      bytes_done != bytes_total)
+    nerr++;
+  H5Sclose(fspace);
+  nerr += read_rows(dset, shift, ldims, memspace, dxf_id, data);
+  nerr += read_rows(dset, rank, ldims, memspace, dxf_id, data);
+  H5Dclose(dset);
+
+  H5Fclose(file_id);
+  MPI_Allreduce(MPI_IN_PLACE, &nerr, 1, MPI_INT, MPI_SUM, comm);
+  if (rank == 0) {
+    if (nerr > 0)
+      printf("Found %d error(s)\n====================\n\n", nerr);
+    else
+      printf("Passed\n====================\n\n");
+  }
+  free(data);
+  H5Pclose(dxf_id);
+  H5Pclose(plist_id);
+  H5Sclose(memspace);
+  MPI_Finalize();
+  return nerr > 0;
+}
@@ -0,0 +1,190 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright (c) 2023, UChicago Argonne, LLC.                                *
+ * All Rights Reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5 Cache VOL connector.  The full copyright notice *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the LICENSE file, which can be found at the root of the source code       *
+ * distribution tree.                                                        *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+//
+// This test example is for testing the prefetch of a part of a dataset
+// (H5Dprefetch and H5Dprefetch_async with a selection): only the samples
+// touched by the selection, and not cached yet, are prefetched, and the
+// other samples are read through the cache afterwards.
+#include "cache_new_h5api.h"
+#include "hdf5.h"
+#include "mpi.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include <stdlib.h>
+#include <string.h>
+
+// read the rows (first + i * stride) collectively, and check them
+static int read_rows(hid_t dset, hsize_t first, hsize_t stride, hsize_t nrows,
+                     hsize_t d2, hid_t dxf_id, int *buf) {
+  hsize_t offset[2] = {first, 0};
+  hsize_t strides[2] = {stride, 1};
+  hsize_t count[2] = {nrows, 1};
+  hsize_t block[2] = {1, d2};
+  hsize_t mdims[2] = {nrows, d2};
+  int nerr = 0;
+  hid_t mspace = H5Screate_simple(2, mdims, NULL);
+  hid_t fspace = H5Dget_space(dset);
+  H5Sselect_hyperslab(fspace, H5S_SELECT_SET, offset, strides, count, block);
+  memset(buf, 0, nrows * d2 * sizeof(int));
+  if (H5Dread(dset, H5T_NATIVE_INT, mspace, fspace, dxf_id, buf) < 0)
+    nerr++;
+  for (hsize_t i = 0; i < nrows; i++)
+    for (hsize_t j = 0; j < d2; j++)
+      if (buf[i * d2 + j] != (int)(first + i * stride))
+        nerr++;
+  H5Sclose(fspace);
+  H5Sclose(mspace);
+  return nerr;
+}
+
+// the first nrows rows of each of the nproc ranks, or of rank only if
+// rank >= 0
+static hid_t select_first_rows(hid_t dset, int nproc, int rank, hsize_t d1,
+                               hsize_t nrows, hsize_t d2) {
+  hsize_t count[2] = {1, 1};
+  hsize_t block[2] = {nrows, d2};
+  hid_t fspace = H5Dget_space(dset);
+  H5Sselect_none(fspace);
+  for (int r = 0; r < nproc; r++) {
+    hsize_t offset[2] = {r * d1, 0};
+    if (rank < 0 || r == rank)
+      H5Sselect_hyperslab(fspace, H5S_SELECT_OR, offset, NULL, count, block);
+  }
+  return fspace;
+}
+
+int main(int argc, char **argv) {
+  size_t d1 = 256;
+  size_t d2 = 64;
+  hsize_t ldims[2] = {d1, d2};
+  MPI_Comm comm = MPI_COMM_WORLD;
+  MPI_Info info = MPI_INFO_NULL;
+  int rank, nproc, provided;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
+  MPI_Comm_size(comm, &nproc);
+  MPI_Comm_rank(comm, &rank);
+  hsize_t gdims[2] = {d1 * nproc, d2};
+  hsize_t ss = d2 * sizeof(int);
+  if (rank == 0) {
+    printf("****HDF5 Testing Partial Prefetch*****\n");
+    printf("=============================================\n");
+    printf(" Buf dim: %llu x %llu\n", ldims[0], ldims[1]);
+    printf("   nproc: %d\n", nproc);
+    printf("=============================================\n");
+  }
+  int nerr = 0;
+  hid_t plist_id = H5Pcreate(H5P_FILE_ACCESS);
+  H5Pset_fapl_mpio(plist_id, comm, info);
+  char f[255];
+  strcpy(f, "parallel_file_prefetch_partial.h5");
+  hid_t memspace = H5Screate_simple(2, ldims, NULL);
+  int *data = (int *)malloc(ldims[0] * ldims[1] * sizeof(int));
+  for (hsize_t i = 0; i < ldims[0]; i++)
+    for (hsize_t j = 0; j < ldims[1]; j++)
+      data[i * ldims[1] + j] = rank * ldims[0] + i;
+  hid_t dxf_id = H5Pcreate(H5P_DATASET_XFER);
+  H5Pset_dxpl_mpio(dxf_id, H5FD_MPIO_COLLECTIVE);
+
+  // write the dataset without the read cache; each sample holds its index
+  if (rank == 0)
+    printf("Creating file %s \n", f);
+  hid_t file_id = H5Fcreate(f, H5F_ACC_TRUNC, H5P_DEFAULT, plist_id);
+  hid_t filespace = H5Screate_simple(2, gdims, NULL);
+  hsize_t offset[2] = {rank * ldims[0], 0};
+  hsize_t count[2] = {1, 1};
+  H5Sselect_hyperslab(filespace, H5S_SELECT_SET, offset, NULL, count, ldims);
+  hid_t dset = H5Dcreate(file_id, "dset_test", H5T_NATIVE_INT, filespace,
+                         H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  H5Dwrite(dset, H5T_NATIVE_INT, memspace, filespace, dxf_id, data);
+  H5Dclose(dset);
+  H5Sclose(filespace);
+  H5Fclose(file_id);
+
+  // reopen it with the read cache
+  setenv("HDF5_CACHE_RD", "yes", 1);
+  file_id = H5Fopen(f, H5F_ACC_RDONLY, plist_id);
+  hsize_t mine = rank * d1, next = ((rank + 1) % nproc) * d1;
+  size_t num_inprogress;
+  hbool_t error_occured;
+  hsize_t bytes_done, bytes_total;
+
+  // 1) prefetch every fourth row of the dataset, and half of its features
+  if (rank == 0)
+    printf("Prefetch every fourth row\n");
+  dset = H5Dopen(file_id, "dset_test", H5P_DEFAULT);
+  hid_t fspace = H5Dget_space(dset);
+  hsize_t start[2] = {0, d2 / 4}, stride[2] = {4, 1};
+  hsize_t nblock[2] = {gdims[0] / 4, 1}, block[2] = {1, d2 / 2};
+  H5Sselect_hyperslab(fspace, H5S_SELECT_SET, start, stride, nblock, block);
+  if (H5Dprefetch(dset, fspace, dxf_id) < 0)
+    nerr++;
+  H5Sclose(fspace);
+  // the prefetched rows, then all the rows of the next rank: a quarter of
+  // them is cached
+  nerr += read_rows(dset, next, 4, d1 / 4, d2, dxf_id, data);
+  nerr += read_rows(dset, next, 1, d1, d2, dxf_id, data);
+  H5Dclose(dset);
+
+  // 2) prefetch the first half of the rows of each rank asynchronously: the
+  // prefetch of each rank is its half
+  if (rank == 0)
+    printf("Prefetch the first half of the rows asynchronously\n");
+  dset = H5Dopen(file_id, "dset_test", H5P_DEFAULT);
+  hid_t es_id = H5EScreate();
+  fspace = select_first_rows(dset, nproc, -1, d1, d1 / 2, d2);
+  if (H5Dprefetch_async(dset, fspace, dxf_id, es_id) < 0)
+    nerr++;
+  H5Sclose(fspace);
+  if (H5Dprefetch_status(dset, &bytes_done, &bytes_total) < 0 ||
+      bytes_total != d1 / 2 * ss)
+    nerr++;
+  H5ESwait(es_id, H5ES_WAIT_FOREVER, &num_inprogress, &error_occured);
+  if (num_inprogress != 0 || error_occured)
+    nerr++;
+  H5ESclose(es_id);
+  nerr += read_rows(dset, mine, 1, d1 / 2, d2, dxf_id, data);
+
+  // 3) prefetch all the rows of rank 0: only its second half is not cached
+  // yet, and the other ranks have nothing to prefetch
+  if (rank == 0)
+    printf("Prefetch the rows of rank 0\n");
+  es_id = H5EScreate();
+  fspace = select_first_rows(dset, nproc, 0, d1, d1, d2);
+  if (H5Dprefetch_async(dset, fspace, dxf_id, es_id) < 0)
+    nerr++;
+  H5Sclose(fspace);
+  H5ESwait(es_id, H5ES_WAIT_FOREVER, &num_inprogress, &error_occured);
+  if (num_inprogress != 0 || error_occured)
+    nerr++;
+  H5ESclose(es_id);
+  if (H5Dprefetch_status(dset, &bytes_done, &bytes_total) < 0 ||
+      bytes_total != ((rank == 0) ? d1 / 2 * ss : 0) ||
+      bytes_done != bytes_total)
+    nerr++;
+  nerr += read_rows(dset, 0, 1, d1, d2, dxf_id, data);
+  nerr += read_rows(dset, mine, 1, d1, d2, dxf_id, data);
+  H5Dclose(dset);
+  H5Fclose(file_id);
+
+  MPI_Allreduce(MPI_IN_PLACE, &nerr, 1, MPI_INT, MPI_SUM, comm);
+  if (rank == 0) {
+    if (nerr > 0)
+      printf("Found %d error(s)\n====================\n\n", nerr);
+    else
+      printf("Passed\n====================\n\n");
+  }
+  free(data);
+  H5Pclose(dxf_id);
+  H5Pclose(plist_id);
+  H5Sclose(memspace);
+  MPI_Finalize();
+  return nerr > 0;
+}
@@ -0,0 +1,140 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright (c) 2023, UChicago Argonne, LLC.                                *
+ * All Rights Reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5 Cache VOL connector.  The full copyright notice *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the LICENSE file, which can be found at the root of the source code       *
+ * distribution tree.                                                        *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+//
+// This test example is for testing the read-ahead of datasets that are not
+// cached yet (HDF5_CACHE_READ_AHEAD_DEPTH): each rank scans its rows in
+// batches, then reads every other batch, then breaks the pattern, so that
+// the batches fetched ahead are used, and dropped when they are not.
+#include "hdf5.h"
+#include "mpi.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include <stdlib.h>
+#include <string.h>
+
+// read nrows rows from row first collectively, and check them
+static int read_rows(hid_t dset, hsize_t first, hsize_t nrows, hsize_t d2,
+                     hid_t dxf_id, int *buf) {
+  hsize_t offset[2] = {first, 0};
+  hsize_t block[2] = {nrows, d2};
+  hsize_t count[2] = {1, 1};
+  int nerr = 0;
+  hid_t mspace = H5Screate_simple(2, block, NULL);
+  hid_t fspace = H5Dget_space(dset);
+  H5Sselect_hyperslab(fspace, H5S_SELECT_SET, offset, NULL, count, block);
+  memset(buf, 0, nrows * d2 * sizeof(int));
+  if (H5Dread(dset, H5T_NATIVE_INT, mspace, fspace, dxf_id, buf) < 0)
+    nerr++;
+  for (hsize_t i = 0; i < nrows; i++)
+    for (hsize_t j = 0; j < d2; j++)
+      if (buf[i * d2 + j] != (int)(first + i))
+        nerr++;
+  H5Sclose(fspace);
+  H5Sclose(mspace);
+  return nerr;
+}
+
+int main(int argc, char **argv) {
+  size_t d1 = 512;
+  size_t d2 = 64;
+  size_t batch_size = 16;
+  hsize_t ldims[2] = {d1, d2};
+  MPI_Comm comm = MPI_COMM_WORLD;
+  MPI_Info info = MPI_INFO_NULL;
+  int rank, nproc, provided;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
+  MPI_Comm_size(comm, &nproc);
+  MPI_Comm_rank(comm, &rank);
+  hsize_t gdims[2] = {d1 * nproc, d2};
+  size_t num_batches = d1 / batch_size;
+  if (rank == 0) {
+    printf("****HDF5 Testing Read-Ahead*****\n");
+    printf("=============================================\n");
+    printf(" Buf dim: %llu x %llu\n", ldims[0], ldims[1]);
+    printf(" Batch size: %zu\n", batch_size);
+    printf("   nproc: %d\n", nproc);
+    printf("=============================================\n");
+  }
+  int nerr = 0;
+  hid_t plist_id = H5Pcreate(H5P_FILE_ACCESS);
+  H5Pset_fapl_mpio(plist_id, comm, info);
+  char f[255];
+  strcpy(f, "parallel_file_read_ahead.h5");
+  hid_t memspace = H5Screate_simple(2, ldims, NULL);
+  int *data = (int *)malloc(ldims[0] * ldims[1] * sizeof(int));
+  for (hsize_t i = 0; i < ldims[0]; i++)
+    for (hsize_t j = 0; j < ldims[1]; j++)
+      data[i * ldims[1] + j] = rank * ldims[0] + i;
+  hid_t dxf_id = H5Pcreate(H5P_DATASET_XFER);
+  H5Pset_dxpl_mpio(dxf_id, H5FD_MPIO_COLLECTIVE);
+
+  // write the dataset without the read cache; each sample holds its index
+  if (rank == 0)
+    printf("Creating file %s \n", f);
+  hid_t file_id = H5Fcreate(f, H5F_ACC_TRUNC, H5P_DEFAULT, plist_id);
+  hid_t filespace = H5Screate_simple(2, gdims, NULL);
+  hsize_t offset[2] = {rank * ldims[0], 0};
+  hsize_t count[2] = {1, 1};
+  H5Sselect_hyperslab(filespace, H5S_SELECT_SET, offset, NULL, count, ldims);
+  hid_t dset = H5Dcreate(file_id, "dset_test", H5T_NATIVE_INT, filespace,
+                         H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  H5Dwrite(dset, H5T_NATIVE_INT, memspace, filespace, dxf_id, data);
+  H5Dclose(dset);
+  H5Sclose(filespace);
+  H5Fclose(file_id);
+
+  // reopen it with the read cache
+  setenv("HDF5_CACHE_RD", "yes", 1);
+  file_id = H5Fopen(f, H5F_ACC_RDONLY, plist_id);
+  dset = H5Dopen(file_id, "dset_test", H5P_DEFAULT);
+  hsize_t mine = rank * d1;
+  size_t nb;
+
+  // 1) a scan of the first half of the rows, batch after batch
+  if (rank == 0)
+    printf("Scanning batches\n");
+  for (nb = 0; nb < num_batches / 2; nb++)
+    nerr += read_rows(dset, mine + nb * batch_size, batch_size, d2, dxf_id,
+                      data);
+  // 2) every other batch of the second half
+  if (rank == 0)
+    printf("Reading every other batch\n");
+  for (; nb < num_batches; nb += 2)
+    nerr += read_rows(dset, mine + nb * batch_size, batch_size, d2, dxf_id,
+                      data);
+  // 3) back to the beginning, with another batch size: the batches fetched
+  // ahead are dropped
+  if (rank == 0)
+    printf("Breaking the pattern\n");
+  nerr += read_rows(dset, mine + 3, 2 * batch_size, d2, dxf_id, data);
+  // 4) the batches skipped in 2)
+  if (rank == 0)
+    printf("Reading the skipped batches\n");
+  for (nb = num_batches / 2 + 1; nb < num_batches; nb += 2)
+    nerr += read_rows(dset, mine + nb * batch_size, batch_size, d2, dxf_id,
+                      data);
+  H5Dclose(dset);
+  H5Fclose(file_id);
+
+  MPI_Allreduce(MPI_IN_PLACE, &nerr, 1, MPI_INT, MPI_SUM, comm);
+  if (rank == 0) {
+    if (nerr > 0)
+      printf("Found %d error(s)\n====================\n\n", nerr);
+    else
+      printf("Passed\n====================\n\n");
+  }
+  free(data);
+  H5Pclose(dxf_id);
+  H5Pclose(plist_id);
+  H5Sclose(memspace);
+  MPI_Finalize();
+  return nerr > 0;
+}
@@ -0,0 +1,156 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright (c) 2023, UChicago Argonne, LLC.                                *
+ * All Rights Reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5 Cache VOL connector.  The full copyright notice *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the LICENSE file, which can be found at the root of the source code       *
+ * distribution tree.                                                        *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+//
+// This test example is for testing the reads of batches of samples from the
+// read cache: the dataset is cached by a first epoch in which each rank
+// reads its own rows, and the next epochs read batches of shuffled samples,
+// which are spread over the caches of all the ranks and are not contiguous.
+#include "hdf5.h"
+#include "mpi.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include <algorithm>
+#include <random>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+using namespace std;
+
+// select the samples b[0..n) (sorted) of the dataset
+static void select_samples(hid_t fspace, const hsize_t *b, size_t n,
+                           hsize_t d2) {
+  hsize_t count[2] = {1, d2};
+  H5Sselect_none(fspace);
+  for (size_t i = 0; i < n; i++) {
+    hsize_t offset[2] = {b[i], 0};
+    H5Sselect_hyperslab(fspace, H5S_SELECT_OR, offset, NULL, count, NULL);
+  }
+}
+
+// read the samples b[0..n) (sorted), and check them
+static int read_samples(hid_t dset, hid_t fspace, const hsize_t *b, size_t n,
+                        hsize_t d2, hid_t dxf_id, int *buf) {
+  hsize_t mdims[2] = {n, d2};
+  hid_t mspace = H5Screate_simple(2, mdims, NULL);
+  int nerr = 0;
+  select_samples(fspace, b, n, d2);
+  memset(buf, 0, n * d2 * sizeof(int));
+  if (H5Dread(dset, H5T_NATIVE_INT, mspace, fspace, dxf_id, buf) < 0)
+    nerr++;
+  for (size_t i = 0; i < n; i++)
+    for (size_t j = 0; j < d2; j++)
+      if (buf[i * d2 + j] != (int)b[i])
+        nerr++;
+  H5Sclose(mspace);
+  return nerr;
+}
+
+int main(int argc, char **argv) {
+  size_t d1 = 256;
+  size_t d2 = 64;
+  size_t batch_size = 16;
+  int epochs = 3;
+  MPI_Comm comm = MPI_COMM_WORLD;
+  MPI_Info info = MPI_INFO_NULL;
+  int rank, nproc, provided;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
+  MPI_Comm_size(comm, &nproc);
+  MPI_Comm_rank(comm, &rank);
+  hsize_t ldims[2] = {d1, d2};
+  hsize_t gdims[2] = {d1 * nproc, d2};
+  size_t num_batches = d1 / batch_size;
+  if (rank == 0) {
+    printf("****HDF5 Testing Batch Reads from the Read Cache*****\n");
+    printf("=============================================\n");
+    printf(" Buf dim: %llu x %llu\n", ldims[0], ldims[1]);
+    printf(" Batch size: %zu\n", batch_size);
+    printf("   nproc: %d\n", nproc);
+    printf("=============================================\n");
+  }
+  int nerr = 0;
+  hid_t plist_id = H5Pcreate(H5P_FILE_ACCESS);
+  H5Pset_fapl_mpio(plist_id, comm, info);
+  char f[255];
+  strcpy(f, "parallel_file_batch.h5");
+  hid_t memspace = H5Screate_simple(2, ldims, NULL);
+  int *data = (int *)malloc(ldims[0] * ldims[1] * sizeof(int));
+  for (hsize_t i = 0; i < ldims[0]; i++)
+    for (hsize_t j = 0; j < ldims[1]; j++)
+      data[i * ldims[1] + j] = rank * ldims[0] + i;
+  hid_t dxf_id = H5Pcreate(H5P_DATASET_XFER);
+  H5Pset_dxpl_mpio(dxf_id, H5FD_MPIO_COLLECTIVE);
+
+  // write the dataset without the read cache; each sample holds its index
+  if (rank == 0)
+    printf("Creating file %s \n", f);
+  hid_t file_id = H5Fcreate(f, H5F_ACC_TRUNC, H5P_DEFAULT, plist_id);
+  hid_t filespace = H5Screate_simple(2, gdims, NULL);
+  hsize_t offset[2] = {rank * ldims[0], 0};
+  hsize_t count[2] = {1, 1};
+  H5Sselect_hyperslab(filespace, H5S_SELECT_SET, offset, NULL, count, ldims);
+  hid_t dset = H5Dcreate(file_id, "dset_test", H5T_NATIVE_INT, filespace,
+                         H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  H5Dwrite(dset, H5T_NATIVE_INT, memspace, filespace, dxf_id, data);
+  H5Dclose(dset);
+  H5Sclose(filespace);
+  H5Fclose(file_id);
+
+  // reopen it with the read cache
+  setenv("HDF5_CACHE_RD", "yes", 1);
+  file_id = H5Fopen(f, H5F_ACC_RDONLY, plist_id);
+  dset = H5Dopen(file_id, "dset_test", H5P_DEFAULT);
+  hid_t fspace = H5Dget_space(dset);
+
+  // the first epoch caches the rows of each rank, batch by batch
+  if (rank == 0)
+    printf("Epoch 0 (caching)\n");
+  vector<hsize_t> b(batch_size);
+  for (size_t nb = 0; nb < num_batches; nb++) {
+    for (size_t i = 0; i < batch_size; i++)
+      b[i] = offset[0] + nb * batch_size + i;
+    nerr += read_samples(dset, fspace, &b[0], batch_size, d2, dxf_id, data);
+  }
+
+  // the next epochs read shuffled samples from the caches of all the ranks;
+  // the same shuffle on all the ranks, rank r reads the r-th part of it
+  vector<hsize_t> id(gdims[0]);
+  for (hsize_t i = 0; i < gdims[0]; i++)
+    id[i] = i;
+  mt19937 g(100);
+  for (int e = 1; e < epochs; e++) {
+    if (rank == 0)
+      printf("Epoch %d\n", e);
+    ::shuffle(id.begin(), id.end(), g);
+    for (size_t nb = 0; nb < num_batches; nb++) {
+      const hsize_t *mine = &id[rank * d1 + nb * batch_size];
+      b.assign(mine, mine + batch_size);
+      sort(b.begin(), b.end());
+      nerr += read_samples(dset, fspace, &b[0], batch_size, d2, dxf_id, data);
+    }
+  }
+  H5Sclose(fspace);
+  H5Dclose(dset);
+  H5Fclose(file_id);
+
+  MPI_Allreduce(MPI_IN_PLACE, &nerr, 1, MPI_INT, MPI_SUM, comm);
+  if (rank == 0) {
+    if (nerr > 0)
+      printf("Found %d error(s)\n====================\n\n", nerr);
+    else
+      printf("Passed\n====================\n\n");
+  }
+  free(data);
+  H5Pclose(dxf_id);
+  H5Pclose(plist_id);
+  H5Sclose(memspace);
+  MPI_Finalize();
+  return nerr > 0;
+}
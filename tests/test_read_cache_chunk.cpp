@@ -0,0 +1,156 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright (c) 2023, UChicago Argonne, LLC.                                *
+ * All Rights Reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5 Cache VOL connector.  The full copyright notice *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the LICENSE file, which can be found at the root of the source code       *
+ * distribution tree.                                                        *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+//
+// This test example is for testing the read cache of chunked datasets
+// (HDF5_CACHE_READ_UNIT: CHUNK): the chunks do not divide the dimensions of
+// the dataset, and the reads are not aligned with the chunks. A compressed
+// dataset is read as well, with its chunks decoded by the cache
+// (HDF5_CACHE_DECODE_THREADS) or by HDF5.
+#include "hdf5.h"
+#include "mpi.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include <stdlib.h>
+#include <string.h>
+
+// read the block (offset, block) collectively, and check it; each element
+// holds its index in the dataset
+static int read_block(hid_t dset, const hsize_t *offset, const hsize_t *block,
+                      hsize_t d2, hid_t dxf_id, int *buf) {
+  hsize_t count[2] = {1, 1};
+  int nerr = 0;
+  hid_t mspace = H5Screate_simple(2, block, NULL);
+  hid_t fspace = H5Dget_space(dset);
+  H5Sselect_hyperslab(fspace, H5S_SELECT_SET, offset, NULL, count, block);
+  memset(buf, 0, block[0] * block[1] * sizeof(int));
+  if (H5Dread(dset, H5T_NATIVE_INT, mspace, fspace, dxf_id, buf) < 0)
+    nerr++;
+  for (hsize_t i = 0; i < block[0]; i++)
+    for (hsize_t j = 0; j < block[1]; j++)
+      if (buf[i * block[1] + j] !=
+          (int)((offset[0] + i) * d2 + offset[1] + j))
+        nerr++;
+  H5Sclose(fspace);
+  H5Sclose(mspace);
+  return nerr;
+}
+
+// cache the dataset, with each rank reading its rows, then read blocks of
+// the dataset from the cache
+static int check_dataset(hid_t file_id, const char *name, int rank,
+                         int nproc, hsize_t *ldims, hid_t dxf_id, int *buf) {
+  int nerr = 0;
+  hsize_t d1 = ldims[0], d2 = ldims[1];
+  hsize_t next = ((rank + 1) % nproc) * d1;
+  hid_t dset = H5Dopen(file_id, name, H5P_DEFAULT);
+  hsize_t offset[2] = {rank * d1, 0};
+  nerr += read_block(dset, offset, ldims, d2, dxf_id, buf);
+  for (int e = 0; e < 2; e++) {
+    hsize_t off1[2] = {next, 0};
+    nerr += read_block(dset, off1, ldims, d2, dxf_id, buf);
+    hsize_t off2[2] = {next + 7, 5}, block2[2] = {d1 / 2, d2 - 10};
+    nerr += read_block(dset, off2, block2, d2, dxf_id, buf);
+    hsize_t off3[2] = {rank * d1 + d1 - 3, d2 - 1}, block3[2] = {3, 1};
+    nerr += read_block(dset, off3, block3, d2, dxf_id, buf);
+  }
+  H5Dclose(dset);
+  return nerr;
+}
+
+int main(int argc, char **argv) {
+  size_t d1 = 100;
+  size_t d2 = 50;
+  hsize_t ldims[2] = {d1, d2};
+  hsize_t cdims[2] = {24, 16};
+  MPI_Comm comm = MPI_COMM_WORLD;
+  MPI_Info info = MPI_INFO_NULL;
+  int rank, nproc, provided;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
+  MPI_Comm_size(comm, &nproc);
+  MPI_Comm_rank(comm, &rank);
+  hsize_t gdims[2] = {d1 * nproc, d2};
+  if (rank == 0) {
+    printf("****HDF5 Testing Chunk Read Cache*****\n");
+    printf("=============================================\n");
+    printf(" Buf dim: %llu x %llu\n", ldims[0], ldims[1]);
+    printf(" Chunk dim: %llu x %llu\n", cdims[0], cdims[1]);
+    printf("   nproc: %d\n", nproc);
+    printf("=============================================\n");
+  }
+  int nerr = 0;
+  hid_t plist_id = H5Pcreate(H5P_FILE_ACCESS);
+  H5Pset_fapl_mpio(plist_id, comm, info);
+  char f[255];
+  strcpy(f, "parallel_file_chunk.h5");
+  hid_t memspace = H5Screate_simple(2, ldims, NULL);
+  int *data = (int *)malloc(ldims[0] * ldims[1] * sizeof(int));
+  for (hsize_t i = 0; i < ldims[0]; i++)
+    for (hsize_t j = 0; j < ldims[1]; j++)
+      data[i * ldims[1] + j] = (rank * ldims[0] + i) * d2 + j;
+  hid_t dxf_id = H5Pcreate(H5P_DATASET_XFER);
+  H5Pset_dxpl_mpio(dxf_id, H5FD_MPIO_COLLECTIVE);
+
+  // write the dataset without the read cache
+  if (rank == 0)
+    printf("Creating file %s \n", f);
+  hid_t file_id = H5Fcreate(f, H5F_ACC_TRUNC, H5P_DEFAULT, plist_id);
+  hid_t filespace = H5Screate_simple(2, gdims, NULL);
+  hsize_t offset[2] = {rank * ldims[0], 0};
+  hsize_t count[2] = {1, 1};
+  H5Sselect_hyperslab(filespace, H5S_SELECT_SET, offset, NULL, count, ldims);
+  hid_t dcpl_id = H5Pcreate(H5P_DATASET_CREATE);
+  H5Pset_chunk(dcpl_id, 2, cdims);
+  hid_t dset = H5Dcreate(file_id, "dset_test", H5T_NATIVE_INT, filespace,
+                         H5P_DEFAULT, dcpl_id, H5P_DEFAULT);
+  H5Dwrite(dset, H5T_NATIVE_INT, memspace, filespace, dxf_id, data);
+  H5Dclose(dset);
+  bool deflate = H5Zfilter_avail(H5Z_FILTER_DEFLATE) > 0;
+  if (deflate) {
+    H5Pset_deflate(dcpl_id, 6);
+    dset = H5Dcreate(file_id, "dset_deflate", H5T_NATIVE_INT, filespace,
+                     H5P_DEFAULT, dcpl_id, H5P_DEFAULT);
+    H5Dwrite(dset, H5T_NATIVE_INT, memspace, filespace, dxf_id, data);
+    H5Dclose(dset);
+  } else if (rank == 0) {
+    printf("No deflate filter, skipping dataset %s \n", "dset_deflate");
+  }
+  H5Pclose(dcpl_id);
+  H5Sclose(filespace);
+  H5Fclose(file_id);
+
+  // reopen it with the read cache
+  setenv("HDF5_CACHE_RD", "yes", 1);
+  file_id = H5Fopen(f, H5F_ACC_RDONLY, plist_id);
+  if (rank == 0)
+    printf("Reading dataset %s \n", "dset_test");
+  nerr += check_dataset(file_id, "dset_test", rank, nproc, ldims, dxf_id, data);
+  if (deflate) {
+    if (rank == 0)
+      printf("Reading dataset %s \n", "dset_deflate");
+    nerr += check_dataset(file_id, "dset_deflate", rank, nproc, ldims, dxf_id,
+                          data);
+  }
+  H5Fclose(file_id);
+
+  MPI_Allreduce(MPI_IN_PLACE, &nerr, 1, MPI_INT, MPI_SUM, comm);
+  if (rank == 0) {
+    if (nerr > 0)
+      printf("Found %d error(s)\n====================\n\n", nerr);
+    else
+      printf("Passed\n====================\n\n");
+  }
+  free(data);
+  H5Pclose(dxf_id);
+  H5Pclose(plist_id);
+  H5Sclose(memspace);
+  MPI_Finalize();
+  return nerr > 0;
+}
@@ -0,0 +1,237 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright (c) 2023, UChicago Argonne, LLC.                                *
+ * All Rights Reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5 Cache VOL connector.  The full copyright notice *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the LICENSE file, which can be found at the root of the source code       *
+ * distribution tree.                                                        *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+//
+// This test example is for testing the conversion of the data read from the
+// read cache to the memory datatype, and its scatter to the memory
+// selection: a dataset of doubles is read as floats (including values out of
+// the range of float) and as ints, into a strided memory selection, and a
+// dataset of a compound type is read with its members in another order.
+#include "hdf5.h"
+#include "mpi.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  int a;
+  double b;
+} file_t;
+
+typedef struct {
+  double b;
+  long long a;
+} mem_t;
+
+// value of the element (i, j) of the dataset of doubles; the elements of
+// the last column are out of the range of float
+static double value(hsize_t i, hsize_t j, hsize_t d2) {
+  if (j == d2 - 1)
+    return (i % 2 == 0) ? 1e300 : -1e300;
+  return (double)(i * d2 + j);
+}
+
+// select the rows [first, first + nrows) of the dataset
+static hid_t select_rows(hid_t dset, hsize_t first, hsize_t nrows,
+                         hsize_t d2) {
+  hsize_t offset[2] = {first, 0};
+  hsize_t block[2] = {nrows, d2};
+  hsize_t count[2] = {1, 1};
+  hid_t fspace = H5Dget_space(dset);
+  H5Sselect_hyperslab(fspace, H5S_SELECT_SET, offset, NULL, count, block);
+  return fspace;
+}
+
+// read the rows of the dataset of doubles as floats, and check them
+static int read_float(hid_t dset, hsize_t first, hsize_t nrows, hsize_t d2,
+                      hid_t dxf_id, float *buf) {
+  int nerr = 0;
+  hsize_t mdims[2] = {nrows, d2};
+  hid_t mspace = H5Screate_simple(2, mdims, NULL);
+  hid_t fspace = select_rows(dset, first, nrows, d2);
+  memset(buf, 0, nrows * d2 * sizeof(float));
+  if (H5Dread(dset, H5T_NATIVE_FLOAT, mspace, fspace, dxf_id, buf) < 0)
+    nerr++;
+  for (hsize_t i = 0; i < nrows; i++)
+    for (hsize_t j = 0; j < d2; j++) {
+      double v = value(first + i, j, d2);
+      float x = buf[i * d2 + j];
+      if (j == d2 - 1 ? !(isinf(x) && (x > 0) == (v > 0)) : x != (float)v)
+        nerr++;
+    }
+  H5Sclose(fspace);
+  H5Sclose(mspace);
+  return nerr;
+}
+
+// read the rows of the dataset of doubles as ints, without the last column,
+// into every other row of a buffer of 2 * nrows rows, and check them
+static int read_int_strided(hid_t dset, hsize_t first, hsize_t nrows,
+                            hsize_t d2, hid_t dxf_id, int *buf) {
+  int nerr = 0;
+  hsize_t mdims[2] = {2 * nrows, d2};
+  hsize_t moffset[2] = {1, 0}, mstride[2] = {2, 1};
+  hsize_t mcount[2] = {nrows, d2 - 1};
+  hsize_t offset[2] = {first, 0}, count[2] = {nrows, d2 - 1};
+  hid_t mspace = H5Screate_simple(2, mdims, NULL);
+  H5Sselect_hyperslab(mspace, H5S_SELECT_SET, moffset, mstride, mcount, NULL);
+  hid_t fspace = H5Dget_space(dset);
+  H5Sselect_hyperslab(fspace, H5S_SELECT_SET, offset, NULL, count, NULL);
+  for (hsize_t i = 0; i < 2 * nrows * d2; i++)
+    buf[i] = -1;
+  if (H5Dread(dset, H5T_NATIVE_INT, mspace, fspace, dxf_id, buf) < 0)
+    nerr++;
+  for (hsize_t i = 0; i < 2 * nrows; i++)
+    for (hsize_t j = 0; j < d2; j++) {
+      int x = buf[i * d2 + j];
+      if (i % 2 == 0 || j == d2 - 1) {
+        if (x != -1)
+          nerr++;
+      } else if (x != (int)value(first + i / 2, j, d2)) {
+        nerr++;
+      }
+    }
+  H5Sclose(fspace);
+  H5Sclose(mspace);
+  return nerr;
+}
+
+// read the rows of the compound dataset, with the members in another order
+// and a as a long long, and check them
+static int read_compound(hid_t dset, hid_t mem_type, hsize_t first,
+                         hsize_t nrows, hid_t dxf_id, mem_t *buf) {
+  int nerr = 0;
+  hid_t mspace = H5Screate_simple(1, &nrows, NULL);
+  hid_t fspace = H5Dget_space(dset);
+  H5Sselect_hyperslab(fspace, H5S_SELECT_SET, &first, NULL, &nrows, NULL);
+  memset(buf, 0, nrows * sizeof(mem_t));
+  if (H5Dread(dset, mem_type, mspace, fspace, dxf_id, buf) < 0)
+    nerr++;
+  for (hsize_t i = 0; i < nrows; i++)
+    if (buf[i].a != (long long)(first + i) || buf[i].b != 0.5 * (first + i))
+      nerr++;
+  H5Sclose(fspace);
+  H5Sclose(mspace);
+  return nerr;
+}
+
+int main(int argc, char **argv) {
+  size_t d1 = 128;
+  size_t d2 = 32;
+  hsize_t ldims[2] = {d1, d2};
+  MPI_Comm comm = MPI_COMM_WORLD;
+  MPI_Info info = MPI_INFO_NULL;
+  int rank, nproc, provided;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
+  MPI_Comm_size(comm, &nproc);
+  MPI_Comm_rank(comm, &rank);
+  hsize_t gdims[2] = {d1 * nproc, d2};
+  if (rank == 0) {
+    printf("****HDF5 Testing Read Cache Type Conversion*****\n");
+    printf("=============================================\n");
+    printf(" Buf dim: %llu x %llu\n", ldims[0], ldims[1]);
+    printf("   nproc: %d\n", nproc);
+    printf("=============================================\n");
+  }
+  int nerr = 0;
+  hid_t plist_id = H5Pcreate(H5P_FILE_ACCESS);
+  H5Pset_fapl_mpio(plist_id, comm, info);
+  char f[255];
+  strcpy(f, "parallel_file_convert.h5");
+  double *data = (double *)malloc(2 * d1 * d2 * sizeof(double));
+  file_t *cdata = (file_t *)malloc(d1 * sizeof(file_t));
+  mem_t *mdata = (mem_t *)malloc(d1 * sizeof(mem_t));
+  for (hsize_t i = 0; i < d1; i++) {
+    for (hsize_t j = 0; j < d2; j++)
+      data[i * d2 + j] = value(rank * d1 + i, j, d2);
+    cdata[i].a = rank * d1 + i;
+    cdata[i].b = 0.5 * (rank * d1 + i);
+  }
+  hid_t file_type = H5Tcreate(H5T_COMPOUND, sizeof(file_t));
+  H5Tinsert(file_type, "a", HOFFSET(file_t, a), H5T_NATIVE_INT);
+  H5Tinsert(file_type, "b", HOFFSET(file_t, b), H5T_NATIVE_DOUBLE);
+  hid_t mem_type = H5Tcreate(H5T_COMPOUND, sizeof(mem_t));
+  H5Tinsert(mem_type, "b", HOFFSET(mem_t, b), H5T_NATIVE_DOUBLE);
+  H5Tinsert(mem_type, "a", HOFFSET(mem_t, a), H5T_NATIVE_LLONG);
+  hid_t dxf_id = H5Pcreate(H5P_DATASET_XFER);
+  H5Pset_dxpl_mpio(dxf_id, H5FD_MPIO_COLLECTIVE);
+
+  // write the datasets without the read cache
+  if (rank == 0)
+    printf("Creating file %s \n", f);
+  hid_t file_id = H5Fcreate(f, H5F_ACC_TRUNC, H5P_DEFAULT, plist_id);
+  hid_t memspace = H5Screate_simple(2, ldims, NULL);
+  hid_t filespace = H5Screate_simple(2, gdims, NULL);
+  hsize_t offset[2] = {rank * d1, 0};
+  hsize_t count[2] = {1, 1};
+  H5Sselect_hyperslab(filespace, H5S_SELECT_SET, offset, NULL, count, ldims);
+  hid_t dset = H5Dcreate(file_id, "dset_double", H5T_NATIVE_DOUBLE, filespace,
+                         H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  H5Dwrite(dset, H5T_NATIVE_DOUBLE, memspace, filespace, dxf_id, data);
+  H5Dclose(dset);
+  H5Sclose(filespace);
+  H5Sclose(memspace);
+  memspace = H5Screate_simple(1, ldims, NULL);
+  filespace = H5Screate_simple(1, gdims, NULL);
+  H5Sselect_hyperslab(filespace, H5S_SELECT_SET, offset, NULL, ldims, NULL);
+  dset = H5Dcreate(file_id, "dset_compound", file_type, filespace,
+                   H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  H5Dwrite(dset, file_type, memspace, filespace, dxf_id, cdata);
+  H5Dclose(dset);
+  H5Sclose(filespace);
+  H5Sclose(memspace);
+  H5Fclose(file_id);
+
+  // reopen them with the read cache
+  setenv("HDF5_CACHE_RD", "yes", 1);
+  file_id = H5Fopen(f, H5F_ACC_RDONLY, plist_id);
+  hsize_t mine = rank * d1, next = ((rank + 1) % nproc) * d1;
+
+  // doubles to floats (a conversion kernel) and to ints (H5Tconvert); the
+  // first read caches the rows of each rank
+  if (rank == 0)
+    printf("Reading dataset %s \n", "dset_double");
+  dset = H5Dopen(file_id, "dset_double", H5P_DEFAULT);
+  nerr += read_float(dset, mine, d1, d2, dxf_id, (float *)data);
+  for (int e = 0; e < 2; e++) {
+    nerr += read_float(dset, next, d1, d2, dxf_id, (float *)data);
+    nerr += read_int_strided(dset, next + 5, d1 / 2, d2, dxf_id, (int *)data);
+  }
+  H5Dclose(dset);
+
+  // compound to compound, with a background buffer
+  if (rank == 0)
+    printf("Reading dataset %s \n", "dset_compound");
+  dset = H5Dopen(file_id, "dset_compound", H5P_DEFAULT);
+  nerr += read_compound(dset, mem_type, mine, d1, dxf_id, mdata);
+  for (int e = 0; e < 2; e++)
+    nerr += read_compound(dset, mem_type, next, d1, dxf_id, mdata);
+  H5Dclose(dset);
+  H5Fclose(file_id);
+
+  MPI_Allreduce(MPI_IN_PLACE, &nerr, 1, MPI_INT, MPI_SUM, comm);
+  if (rank == 0) {
+    if (nerr > 0)
+      printf("Found %d error(s)\n====================\n\n", nerr);
+    else
+      printf("Passed\n====================\n\n");
+  }
+  free(data);
+  free(cdata);
+  free(mdata);
+  H5Tclose(file_type);
+  H5Tclose(mem_type);
+  H5Pclose(dxf_id);
+  H5Pclose(plist_id);
+  MPI_Finalize();
+  return nerr > 0;
+}
@@ -0,0 +1,145 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright (c) 2023, UChicago Argonne, LLC.                                *
+ * All Rights Reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5 Cache VOL connector.  The full copyright notice *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the LICENSE file, which can be found at the root of the source code       *
+ * distribution tree.                                                        *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+//
+// This test example is for testing the reads of N-dimensional hyperslabs
+// from the read cache: the samples of a 3-D dataset are cached by reads of a
+// part of their features, and strided hyperslabs of samples and features are
+// read from the cache.
+#include "hdf5.h"
+#include "mpi.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include <stdlib.h>
+#include <string.h>
+
+// value of the element (i, j, k) of the dataset
+static int value(hsize_t i, hsize_t j, hsize_t k, const hsize_t *dims) {
+  return (int)((i * dims[1] + j) * dims[2] + k);
+}
+
+// read the hyperslab (offset, stride, count) collectively, and check it
+static int read_hyperslab(hid_t dset, const hsize_t *dims,
+                          const hsize_t *offset, const hsize_t *stride,
+                          const hsize_t *count, hid_t dxf_id, int *buf) {
+  int nerr = 0;
+  hid_t mspace = H5Screate_simple(3, count, NULL);
+  hid_t fspace = H5Dget_space(dset);
+  H5Sselect_hyperslab(fspace, H5S_SELECT_SET, offset, stride, count, NULL);
+  memset(buf, 0, count[0] * count[1] * count[2] * sizeof(int));
+  if (H5Dread(dset, H5T_NATIVE_INT, mspace, fspace, dxf_id, buf) < 0)
+    nerr++;
+  for (hsize_t i = 0; i < count[0]; i++)
+    for (hsize_t j = 0; j < count[1]; j++)
+      for (hsize_t k = 0; k < count[2]; k++)
+        if (buf[(i * count[1] + j) * count[2] + k] !=
+            value(offset[0] + i * stride[0], offset[1] + j * stride[1],
+                  offset[2] + k * stride[2], dims))
+          nerr++;
+  H5Sclose(fspace);
+  H5Sclose(mspace);
+  return nerr;
+}
+
+int main(int argc, char **argv) {
+  size_t d1 = 128;
+  size_t d2 = 8;
+  size_t d3 = 16;
+  hsize_t ldims[3] = {d1, d2, d3};
+  MPI_Comm comm = MPI_COMM_WORLD;
+  MPI_Info info = MPI_INFO_NULL;
+  int rank, nproc, provided;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
+  MPI_Comm_size(comm, &nproc);
+  MPI_Comm_rank(comm, &rank);
+  hsize_t gdims[3] = {d1 * nproc, d2, d3};
+  if (rank == 0) {
+    printf("****HDF5 Testing Hyperslab Reads from the Read Cache*****\n");
+    printf("=============================================\n");
+    printf(" Buf dim: %llu x %llu x %llu\n", ldims[0], ldims[1], ldims[2]);
+    printf("   nproc: %d\n", nproc);
+    printf("=============================================\n");
+  }
+  int nerr = 0;
+  hid_t plist_id = H5Pcreate(H5P_FILE_ACCESS);
+  H5Pset_fapl_mpio(plist_id, comm, info);
+  char f[255];
+  strcpy(f, "parallel_file_hyperslab.h5");
+  hid_t memspace = H5Screate_simple(3, ldims, NULL);
+  int *data = (int *)malloc(d1 * d2 * d3 * sizeof(int));
+  for (hsize_t i = 0; i < d1; i++)
+    for (hsize_t j = 0; j < d2; j++)
+      for (hsize_t k = 0; k < d3; k++)
+        data[(i * d2 + j) * d3 + k] = value(rank * d1 + i, j, k, gdims);
+  hid_t dxf_id = H5Pcreate(H5P_DATASET_XFER);
+  H5Pset_dxpl_mpio(dxf_id, H5FD_MPIO_COLLECTIVE);
+
+  // write the dataset without the read cache
+  if (rank == 0)
+    printf("Creating file %s \n", f);
+  hid_t file_id = H5Fcreate(f, H5F_ACC_TRUNC, H5P_DEFAULT, plist_id);
+  hid_t filespace = H5Screate_simple(3, gdims, NULL);
+  hsize_t offset[3] = {rank * d1, 0, 0};
+  hsize_t count[3] = {1, 1, 1};
+  H5Sselect_hyperslab(filespace, H5S_SELECT_SET, offset, NULL, count, ldims);
+  hid_t dset = H5Dcreate(file_id, "dset_test", H5T_NATIVE_INT, filespace,
+                         H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  H5Dwrite(dset, H5T_NATIVE_INT, memspace, filespace, dxf_id, data);
+  H5Dclose(dset);
+  H5Sclose(filespace);
+  H5Fclose(file_id);
+
+  // reopen it with the read cache
+  setenv("HDF5_CACHE_RD", "yes", 1);
+  file_id = H5Fopen(f, H5F_ACC_RDONLY, plist_id);
+  dset = H5Dopen(file_id, "dset_test", H5P_DEFAULT);
+  hsize_t next = ((rank + 1) % nproc) * d1;
+
+  // 1) a block of the features of each sample of the rank: the samples are
+  // cached as a whole
+  if (rank == 0)
+    printf("Caching through a block of the features\n");
+  hsize_t off1[3] = {rank * d1, 2, 4};
+  hsize_t stride1[3] = {1, 1, 1};
+  hsize_t count1[3] = {d1, 4, 8};
+  nerr += read_hyperslab(dset, gdims, off1, stride1, count1, dxf_id, data);
+
+  // 2) strided hyperslabs of the samples and of the features, from the cache
+  if (rank == 0)
+    printf("Reading strided hyperslabs from the cache\n");
+  hsize_t off2[3] = {next + 1, 1, 0};
+  hsize_t stride2[3] = {2, 3, 5};
+  hsize_t count2[3] = {d1 / 2, 3, 4};
+  nerr += read_hyperslab(dset, gdims, off2, stride2, count2, dxf_id, data);
+  hsize_t off3[3] = {rank * d1 + 3, 0, 7};
+  hsize_t stride3[3] = {5, 1, 1};
+  hsize_t count3[3] = {d1 / 5, d2, 1};
+  nerr += read_hyperslab(dset, gdims, off3, stride3, count3, dxf_id, data);
+  // a whole sample of the next rank
+  hsize_t count4[3] = {1, d2, d3};
+  hsize_t off4[3] = {next + d1 - 1, 0, 0};
+  nerr += read_hyperslab(dset, gdims, off4, stride1, count4, dxf_id, data);
+  H5Dclose(dset);
+  H5Fclose(file_id);
+
+  MPI_Allreduce(MPI_IN_PLACE, &nerr, 1, MPI_INT, MPI_SUM, comm);
+  if (rank == 0) {
+    if (nerr > 0)
+      printf("Found %d error(s)\n====================\n\n", nerr);
+    else
+      printf("Passed\n====================\n\n");
+  }
+  free(data);
+  H5Pclose(dxf_id);
+  H5Pclose(plist_id);
+  H5Sclose(memspace);
+  MPI_Finalize();
+  return nerr > 0;
+}
@@ -0,0 +1,140 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright (c) 2023, UChicago Argonne, LLC.                                *
+ * All Rights Reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5 Cache VOL connector.  The full copyright notice *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the LICENSE file, which can be found at the root of the source code       *
+ * distribution tree.                                                        *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+//
+// This test example is for testing the persistent read caches
+// (HDF5_CACHE_PERSISTENT): the dataset is cached, and closed with the file,
+// then the file is opened again and the cache left by the first open is
+// adopted, as it would be by the next job. With --no-create, the file
+// written by a previous run is read, with the caches it left (or staged by
+// h5cache_stage).
+#include "hdf5.h"
+#include "mpi.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include <stdlib.h>
+#include <string.h>
+
+// read nrows rows from row first collectively, and check them
+static int read_rows(hid_t dset, hsize_t first, hsize_t nrows, hsize_t d2,
+                     hid_t dxf_id, int *buf) {
+  hsize_t offset[2] = {first, 0};
+  hsize_t block[2] = {nrows, d2};
+  hsize_t count[2] = {1, 1};
+  int nerr = 0;
+  hid_t mspace = H5Screate_simple(2, block, NULL);
+  hid_t fspace = H5Dget_space(dset);
+  H5Sselect_hyperslab(fspace, H5S_SELECT_SET, offset, NULL, count, block);
+  memset(buf, 0, nrows * d2 * sizeof(int));
+  if (H5Dread(dset, H5T_NATIVE_INT, mspace, fspace, dxf_id, buf) < 0)
+    nerr++;
+  for (hsize_t i = 0; i < nrows; i++)
+    for (hsize_t j = 0; j < d2; j++)
+      if (buf[i * d2 + j] != (int)(first + i))
+        nerr++;
+  H5Sclose(fspace);
+  H5Sclose(mspace);
+  return nerr;
+}
+
+// open the dataset with the read cache, read the rows of the rank and of
+// the next rank, and close it with the file
+static int read_file(const char *f, hid_t plist_id, int rank, int nproc,
+                     hsize_t d1, hsize_t d2, hid_t dxf_id, int *buf) {
+  int nerr = 0;
+  hsize_t mine = rank * d1, next = ((rank + 1) % nproc) * d1;
+  hid_t file_id = H5Fopen(f, H5F_ACC_RDONLY, plist_id);
+  hid_t dset = H5Dopen(file_id, "dset_test", H5P_DEFAULT);
+  nerr += read_rows(dset, mine, d1, d2, dxf_id, buf);
+  for (int e = 0; e < 2; e++) {
+    nerr += read_rows(dset, next, d1, d2, dxf_id, buf);
+    nerr += read_rows(dset, mine + d1 / 4, d1 / 2, d2, dxf_id, buf);
+  }
+  H5Dclose(dset);
+  H5Fclose(file_id);
+  return nerr;
+}
+
+int main(int argc, char **argv) {
+  size_t d1 = 256;
+  size_t d2 = 64;
+  hsize_t ldims[2] = {d1, d2};
+  MPI_Comm comm = MPI_COMM_WORLD;
+  MPI_Info info = MPI_INFO_NULL;
+  int rank, nproc, provided;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
+  MPI_Comm_size(comm, &nproc);
+  MPI_Comm_rank(comm, &rank);
+  hsize_t gdims[2] = {d1 * nproc, d2};
+  bool create = true;
+  for (int i = 1; i < argc; i++)
+    if (strcmp(argv[i], "--no-create") == 0)
+      create = false;
+  if (rank == 0) {
+    printf("****HDF5 Testing Persistent Read Cache*****\n");
+    printf("=============================================\n");
+    printf(" Buf dim: %llu x %llu\n", ldims[0], ldims[1]);
+    printf("   nproc: %d\n", nproc);
+    printf("=============================================\n");
+  }
+  int nerr = 0;
+  hid_t plist_id = H5Pcreate(H5P_FILE_ACCESS);
+  H5Pset_fapl_mpio(plist_id, comm, info);
+  char f[255];
+  strcpy(f, "parallel_file_persistent.h5");
+  int *data = (int *)malloc(ldims[0] * ldims[1] * sizeof(int));
+  hid_t dxf_id = H5Pcreate(H5P_DATASET_XFER);
+  H5Pset_dxpl_mpio(dxf_id, H5FD_MPIO_COLLECTIVE);
+
+  // write the dataset without the read cache; each sample holds its index
+  if (create) {
+    for (hsize_t i = 0; i < ldims[0]; i++)
+      for (hsize_t j = 0; j < ldims[1]; j++)
+        data[i * ldims[1] + j] = rank * ldims[0] + i;
+    if (rank == 0)
+      printf("Creating file %s \n", f);
+    hid_t file_id = H5Fcreate(f, H5F_ACC_TRUNC, H5P_DEFAULT, plist_id);
+    hid_t memspace = H5Screate_simple(2, ldims, NULL);
+    hid_t filespace = H5Screate_simple(2, gdims, NULL);
+    hsize_t offset[2] = {rank * ldims[0], 0};
+    hsize_t count[2] = {1, 1};
+    H5Sselect_hyperslab(filespace, H5S_SELECT_SET, offset, NULL, count,
+                        ldims);
+    hid_t dset = H5Dcreate(file_id, "dset_test", H5T_NATIVE_INT, filespace,
+                           H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    H5Dwrite(dset, H5T_NATIVE_INT, memspace, filespace, dxf_id, data);
+    H5Dclose(dset);
+    H5Sclose(filespace);
+    H5Sclose(memspace);
+    H5Fclose(file_id);
+  }
+
+  // read it with the read cache twice: the second open adopts the cache
+  // that the first one kept
+  setenv("HDF5_CACHE_RD", "yes", 1);
+  for (int pass = 0; pass < 2; pass++) {
+    if (rank == 0)
+      printf("Reading file %s (pass %d)\n", f, pass);
+    nerr += read_file(f, plist_id, rank, nproc, d1, d2, dxf_id, data);
+  }
+
+  MPI_Allreduce(MPI_IN_PLACE, &nerr, 1, MPI_INT, MPI_SUM, comm);
+  if (rank == 0) {
+    if (nerr > 0)
+      printf("Found %d error(s)\n====================\n\n", nerr);
+    else
+      printf("Passed\n====================\n\n");
+  }
+  free(data);
+  H5Pclose(dxf_id);
+  H5Pclose(plist_id);
+  MPI_Finalize();
+  return nerr > 0;
+}
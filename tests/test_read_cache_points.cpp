@@ -0,0 +1,124 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright (c) 2023, UChicago Argonne, LLC.                                *
+ * All Rights Reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5 Cache VOL connector.  The full copyright notice *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the LICENSE file, which can be found at the root of the source code       *
+ * distribution tree.                                                        *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+//
+// This test example is for testing the reads of point selections
+// (H5Sselect_elements) from the read cache: once the dataset is cached,
+// random points of the whole dataset are read, in an order that is not the
+// order of the dataset.
+#include "hdf5.h"
+#include "mpi.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include <random>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+using namespace std;
+
+int main(int argc, char **argv) {
+  size_t d1 = 256;
+  size_t d2 = 32;
+  size_t npoints = 1000;
+  hsize_t ldims[2] = {d1, d2};
+  MPI_Comm comm = MPI_COMM_WORLD;
+  MPI_Info info = MPI_INFO_NULL;
+  int rank, nproc, provided;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
+  MPI_Comm_size(comm, &nproc);
+  MPI_Comm_rank(comm, &rank);
+  hsize_t gdims[2] = {d1 * nproc, d2};
+  if (rank == 0) {
+    printf("****HDF5 Testing Point Reads from the Read Cache*****\n");
+    printf("=============================================\n");
+    printf(" Buf dim: %llu x %llu\n", ldims[0], ldims[1]);
+    printf(" Points: %zu\n", npoints);
+    printf("   nproc: %d\n", nproc);
+    printf("=============================================\n");
+  }
+  int nerr = 0;
+  hid_t plist_id = H5Pcreate(H5P_FILE_ACCESS);
+  H5Pset_fapl_mpio(plist_id, comm, info);
+  char f[255];
+  strcpy(f, "parallel_file_points.h5");
+  hid_t memspace = H5Screate_simple(2, ldims, NULL);
+  int *data = (int *)malloc(ldims[0] * ldims[1] * sizeof(int));
+  // each element holds its index in the dataset
+  for (hsize_t i = 0; i < ldims[0]; i++)
+    for (hsize_t j = 0; j < ldims[1]; j++)
+      data[i * ldims[1] + j] = (rank * ldims[0] + i) * d2 + j;
+  hid_t dxf_id = H5Pcreate(H5P_DATASET_XFER);
+  H5Pset_dxpl_mpio(dxf_id, H5FD_MPIO_COLLECTIVE);
+
+  // write the dataset without the read cache
+  if (rank == 0)
+    printf("Creating file %s \n", f);
+  hid_t file_id = H5Fcreate(f, H5F_ACC_TRUNC, H5P_DEFAULT, plist_id);
+  hid_t filespace = H5Screate_simple(2, gdims, NULL);
+  hsize_t offset[2] = {rank * ldims[0], 0};
+  hsize_t count[2] = {1, 1};
+  H5Sselect_hyperslab(filespace, H5S_SELECT_SET, offset, NULL, count, ldims);
+  hid_t dset = H5Dcreate(file_id, "dset_test", H5T_NATIVE_INT, filespace,
+                         H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  H5Dwrite(dset, H5T_NATIVE_INT, memspace, filespace, dxf_id, data);
+  H5Dclose(dset);
+  H5Sclose(filespace);
+  H5Fclose(file_id);
+
+  // reopen it with the read cache, and cache it: each rank reads its rows
+  setenv("HDF5_CACHE_RD", "yes", 1);
+  file_id = H5Fopen(f, H5F_ACC_RDONLY, plist_id);
+  dset = H5Dopen(file_id, "dset_test", H5P_DEFAULT);
+  hid_t fspace = H5Dget_space(dset);
+  H5Sselect_hyperslab(fspace, H5S_SELECT_SET, offset, NULL, count, ldims);
+  if (H5Dread(dset, H5T_NATIVE_INT, memspace, fspace, dxf_id, data) < 0)
+    nerr++;
+
+  // read random points of the whole dataset from the cache, a different set
+  // on each rank
+  if (rank == 0)
+    printf("Reading points from the cache\n");
+  vector<hsize_t> coord(2 * npoints);
+  mt19937 g(100 + rank);
+  uniform_int_distribution<hsize_t> row(0, gdims[0] - 1), col(0, d2 - 1);
+  hsize_t mdims[1] = {npoints};
+  hid_t mspace = H5Screate_simple(1, mdims, NULL);
+  for (int e = 0; e < 2; e++) {
+    for (size_t p = 0; p < npoints; p++) {
+      coord[2 * p] = row(g);
+      coord[2 * p + 1] = col(g);
+    }
+    H5Sselect_elements(fspace, H5S_SELECT_SET, npoints, &coord[0]);
+    memset(data, 0, npoints * sizeof(int));
+    if (H5Dread(dset, H5T_NATIVE_INT, mspace, fspace, dxf_id, data) < 0)
+      nerr++;
+    for (size_t p = 0; p < npoints; p++)
+      if (data[p] != (int)(coord[2 * p] * d2 + coord[2 * p + 1]))
+        nerr++;
+  }
+  H5Sclose(mspace);
+  H5Sclose(fspace);
+  H5Dclose(dset);
+  H5Fclose(file_id);
+
+  MPI_Allreduce(MPI_IN_PLACE, &nerr, 1, MPI_INT, MPI_SUM, comm);
+  if (rank == 0) {
+    if (nerr > 0)
+      printf("Found %d error(s)\n====================\n\n", nerr);
+    else
+      printf("Passed\n====================\n\n");
+  }
+  free(data);
+  H5Pclose(dxf_id);
+  H5Pclose(plist_id);
+  H5Sclose(memspace);
+  MPI_Finalize();
+  return nerr > 0;
+}
@@ -0,0 +1,151 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright (c) 2023, UChicago Argonne, LLC.                                *
+ * All Rights Reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5 Cache VOL connector.  The full copyright notice *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the LICENSE file, which can be found at the root of the source code       *
+ * distribution tree.                                                        *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+//
+// This test example is for testing the reads of runs of samples through the
+// read cache: the samples that are not cached are read from the file by
+// runs of consecutive samples, so the selections mix single samples, runs
+// of different lengths, runs next to each other and runs that cross the
+// rows of two ranks.
+#include "hdf5.h"
+#include "mpi.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+using namespace std;
+
+// read the runs (start, length) of samples (sorted, not overlapping)
+// collectively, and check them
+static int read_runs(hid_t dset, const vector<hsize_t> &runs, hsize_t d2,
+                     hid_t dxf_id, int *buf) {
+  hsize_t n = 0, i, k;
+  int nerr = 0;
+  hid_t fspace = H5Dget_space(dset);
+  H5Sselect_none(fspace);
+  for (k = 0; k < runs.size(); k += 2) {
+    hsize_t offset[2] = {runs[k], 0};
+    hsize_t block[2] = {runs[k + 1], d2};
+    hsize_t count[2] = {1, 1};
+    H5Sselect_hyperslab(fspace, H5S_SELECT_OR, offset, NULL, count, block);
+    n += runs[k + 1];
+  }
+  hsize_t mdims[2] = {n, d2};
+  hid_t mspace = H5Screate_simple(2, mdims, NULL);
+  memset(buf, 0, n * d2 * sizeof(int));
+  if (H5Dread(dset, H5T_NATIVE_INT, mspace, fspace, dxf_id, buf) < 0)
+    nerr++;
+  n = 0;
+  for (k = 0; k < runs.size(); k += 2)
+    for (i = 0; i < runs[k + 1]; i++, n++)
+      for (hsize_t j = 0; j < d2; j++)
+        if (buf[n * d2 + j] != (int)(runs[k] + i))
+          nerr++;
+  H5Sclose(mspace);
+  H5Sclose(fspace);
+  return nerr;
+}
+
+int main(int argc, char **argv) {
+  size_t d1 = 256;
+  size_t d2 = 32;
+  hsize_t ldims[2] = {d1, d2};
+  MPI_Comm comm = MPI_COMM_WORLD;
+  MPI_Info info = MPI_INFO_NULL;
+  int rank, nproc, provided;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
+  MPI_Comm_size(comm, &nproc);
+  MPI_Comm_rank(comm, &rank);
+  hsize_t gdims[2] = {d1 * nproc, d2};
+  if (rank == 0) {
+    printf("****HDF5 Testing Read Cache Runs*****\n");
+    printf("=============================================\n");
+    printf(" Buf dim: %llu x %llu\n", ldims[0], ldims[1]);
+    printf("   nproc: %d\n", nproc);
+    printf("=============================================\n");
+  }
+  int nerr = 0;
+  hid_t plist_id = H5Pcreate(H5P_FILE_ACCESS);
+  H5Pset_fapl_mpio(plist_id, comm, info);
+  char f[255];
+  strcpy(f, "parallel_file_runs.h5");
+  hid_t memspace = H5Screate_simple(2, ldims, NULL);
+  // room for the rows of the rank and a few rows of the next rank
+  int *data = (int *)malloc((ldims[0] + 8) * ldims[1] * sizeof(int));
+  for (hsize_t i = 0; i < ldims[0]; i++)
+    for (hsize_t j = 0; j < ldims[1]; j++)
+      data[i * ldims[1] + j] = rank * ldims[0] + i;
+  hid_t dxf_id = H5Pcreate(H5P_DATASET_XFER);
+  H5Pset_dxpl_mpio(dxf_id, H5FD_MPIO_COLLECTIVE);
+
+  // write the dataset without the read cache; each sample holds its index
+  if (rank == 0)
+    printf("Creating file %s \n", f);
+  hid_t file_id = H5Fcreate(f, H5F_ACC_TRUNC, H5P_DEFAULT, plist_id);
+  hid_t filespace = H5Screate_simple(2, gdims, NULL);
+  hsize_t offset[2] = {rank * ldims[0], 0};
+  hsize_t count[2] = {1, 1};
+  H5Sselect_hyperslab(filespace, H5S_SELECT_SET, offset, NULL, count, ldims);
+  hid_t dset = H5Dcreate(file_id, "dset_test", H5T_NATIVE_INT, filespace,
+                         H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  H5Dwrite(dset, H5T_NATIVE_INT, memspace, filespace, dxf_id, data);
+  H5Dclose(dset);
+  H5Sclose(filespace);
+  H5Fclose(file_id);
+
+  // reopen it with the read cache
+  setenv("HDF5_CACHE_RD", "yes", 1);
+  file_id = H5Fopen(f, H5F_ACC_RDONLY, plist_id);
+  dset = H5Dopen(file_id, "dset_test", H5P_DEFAULT);
+  hsize_t b = rank * d1;
+
+  // 1) single samples, short and long runs, and runs next to each other,
+  // read from the file
+  if (rank == 0)
+    printf("Reading runs from the file\n");
+  vector<hsize_t> runs = {b,       1,  b + 2,   1,  b + 4,   3,  b + 7,  5,
+                          b + 12,  17, b + 40,  1,  b + 42,  2,  b + 64, 64,
+                          b + 128, 1,  b + 130, 60, b + 250, 3};
+  // a run across the rows of this rank and of the next one
+  if (rank < nproc - 1)
+    runs.insert(runs.end(), {b + d1 - 2, 6});
+  nerr += read_runs(dset, runs, d2, dxf_id, data);
+
+  // 2) the rows in between: the runs mix cached and uncached samples
+  if (rank == 0)
+    printf("Reading cached and uncached runs\n");
+  runs = {b + 1, 3, b + 29, 40, b + 100, 50, b + 190, 66};
+  nerr += read_runs(dset, runs, d2, dxf_id, data);
+
+  // 3) all the rows of the rank, from the cache
+  if (rank == 0)
+    printf("Reading from the cache\n");
+  runs = {b, d1};
+  nerr += read_runs(dset, runs, d2, dxf_id, data);
+  runs = {b + 3, 1, b + 5, 10, b + 15, 1, b + 200, 56};
+  nerr += read_runs(dset, runs, d2, dxf_id, data);
+  H5Dclose(dset);
+  H5Fclose(file_id);
+
+  MPI_Allreduce(MPI_IN_PLACE, &nerr, 1, MPI_INT, MPI_SUM, comm);
+  if (rank == 0) {
+    if (nerr > 0)
+      printf("Found %d error(s)\n====================\n\n", nerr);
+    else
+      printf("Passed\n====================\n\n");
+  }
+  free(data);
+  H5Pclose(dxf_id);
+  H5Pclose(plist_id);
+  H5Sclose(memspace);
+  MPI_Finalize();
+  return nerr > 0;
+}
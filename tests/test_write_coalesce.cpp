@@ -0,0 +1,141 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright (c) 2023, UChicago Argonne, LLC.                                *
+ * All Rights Reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5 Cache VOL connector.  The full copyright notice *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the LICENSE file, which can be found at the root of the source code       *
+ * distribution tree.                                                        *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+//
+// This test example is for testing the merging of small writes in the write
+// cache (HDF5_CACHE_FUSION_THRESHOLD): each rank writes its rows in small
+// blocks, in order to one dataset and in reverse order to another, and the
+// data is checked after the file is closed and reopened without the cache.
+#include "hdf5.h"
+#include "mpi.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include <stdlib.h>
+#include <string.h>
+
+// write the rows of the rank in blocks of nrows rows
+static void write_blocks(hid_t dset, int rank, hsize_t *ldims, hsize_t nrows,
+                         bool reverse, hid_t dxf_id, const int *data) {
+  hsize_t nblock = ldims[0] / nrows;
+  hsize_t bdims[2] = {nrows, ldims[1]};
+  hsize_t count[2] = {1, 1};
+  hid_t memspace = H5Screate_simple(2, bdims, NULL);
+  for (hsize_t b = 0; b < nblock; b++) {
+    hsize_t i = reverse ? nblock - 1 - b : b;
+    hsize_t offset[2] = {rank * ldims[0] + i * nrows, 0};
+    hid_t filespace = H5Dget_space(dset);
+    H5Sselect_hyperslab(filespace, H5S_SELECT_SET, offset, NULL, count, bdims);
+    H5Dwrite(dset, H5T_NATIVE_INT, memspace, filespace, dxf_id,
+             &data[i * nrows * ldims[1]]);
+    H5Sclose(filespace);
+  }
+  H5Sclose(memspace);
+}
+
+// read the rows of the rank, and check them
+static int check_rows(hid_t dset, int rank, hsize_t *ldims, int *buf) {
+  hsize_t offset[2] = {rank * ldims[0], 0};
+  hsize_t count[2] = {1, 1};
+  int nerr = 0;
+  hid_t memspace = H5Screate_simple(2, ldims, NULL);
+  hid_t filespace = H5Dget_space(dset);
+  H5Sselect_hyperslab(filespace, H5S_SELECT_SET, offset, NULL, count, ldims);
+  memset(buf, 0, ldims[0] * ldims[1] * sizeof(int));
+  if (H5Dread(dset, H5T_NATIVE_INT, memspace, filespace, H5P_DEFAULT, buf) <
+      0)
+    nerr++;
+  for (hsize_t i = 0; i < ldims[0]; i++)
+    for (hsize_t j = 0; j < ldims[1]; j++)
+      if (buf[i * ldims[1] + j] != (int)(offset[0] + i))
+        nerr++;
+  H5Sclose(filespace);
+  H5Sclose(memspace);
+  return nerr;
+}
+
+int main(int argc, char **argv) {
+  size_t d1 = 512;
+  size_t d2 = 64;
+  hsize_t nrows = 8;
+  hsize_t ldims[2] = {d1, d2};
+  MPI_Comm comm = MPI_COMM_WORLD;
+  MPI_Info info = MPI_INFO_NULL;
+  int rank, nproc, provided;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
+  MPI_Comm_size(comm, &nproc);
+  MPI_Comm_rank(comm, &rank);
+  hsize_t gdims[2] = {d1 * nproc, d2};
+  if (rank == 0) {
+    printf("****HDF5 Testing Write Merging*****\n");
+    printf("=============================================\n");
+    printf(" Buf dim: %llu x %llu\n", ldims[0], ldims[1]);
+    printf(" Rows per write: %llu\n", nrows);
+    printf("   nproc: %d\n", nproc);
+    printf("=============================================\n");
+  }
+  int nerr = 0;
+  hid_t plist_id = H5Pcreate(H5P_FILE_ACCESS);
+  H5Pset_fapl_mpio(plist_id, comm, info);
+  char f[255];
+  strcpy(f, "parallel_file_coalesce.h5");
+  int *data = (int *)malloc(ldims[0] * ldims[1] * sizeof(int));
+  for (hsize_t i = 0; i < ldims[0]; i++)
+    for (hsize_t j = 0; j < ldims[1]; j++)
+      data[i * ldims[1] + j] = rank * ldims[0] + i;
+  hid_t dxf_id = H5Pcreate(H5P_DATASET_XFER);
+  H5Pset_dxpl_mpio(dxf_id, H5FD_MPIO_INDEPENDENT);
+
+  // write through the write cache
+  setenv("HDF5_CACHE_WR", "yes", 1);
+  if (rank == 0)
+    printf("Creating file %s \n", f);
+  hid_t file_id = H5Fcreate(f, H5F_ACC_TRUNC, H5P_DEFAULT, plist_id);
+  hid_t filespace = H5Screate_simple(2, gdims, NULL);
+  hid_t dset = H5Dcreate(file_id, "dset_test", H5T_NATIVE_INT, filespace,
+                         H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  hid_t dset2 = H5Dcreate(file_id, "dset_test2", H5T_NATIVE_INT, filespace,
+                          H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  if (rank == 0)
+    printf("Writing dataset %s \n", "dset_test");
+  write_blocks(dset, rank, ldims, nrows, false, dxf_id, data);
+  if (rank == 0)
+    printf("Writing dataset %s \n", "dset_test2");
+  write_blocks(dset2, rank, ldims, nrows, true, dxf_id, data);
+  H5Dclose(dset);
+  H5Dclose(dset2);
+  H5Sclose(filespace);
+  if (rank == 0)
+    printf("Closing file %s \n", f);
+  H5Fclose(file_id);
+
+  // read the data back without the write cache
+  setenv("HDF5_CACHE_WR", "no", 1);
+  file_id = H5Fopen(f, H5F_ACC_RDONLY, plist_id);
+  dset = H5Dopen(file_id, "dset_test", H5P_DEFAULT);
+  dset2 = H5Dopen(file_id, "dset_test2", H5P_DEFAULT);
+  nerr += check_rows(dset, rank, ldims, data);
+  nerr += check_rows(dset2, rank, ldims, data);
+  H5Dclose(dset);
+  H5Dclose(dset2);
+  H5Fclose(file_id);
+
+  MPI_Allreduce(MPI_IN_PLACE, &nerr, 1, MPI_INT, MPI_SUM, comm);
+  if (rank == 0) {
+    if (nerr > 0)
+      printf("Found %d error(s)\n====================\n\n", nerr);
+    else
+      printf("Passed\n====================\n\n");
+  }
+  free(data);
+  H5Pclose(dxf_id);
+  H5Pclose(plist_id);
+  MPI_Finalize();
+  return nerr > 0;
+}
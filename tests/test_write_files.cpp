@@ -0,0 +1,161 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright (c) 2023, UChicago Argonne, LLC.                                *
+ * All Rights Reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5 Cache VOL connector.  The full copyright notice *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the LICENSE file, which can be found at the root of the source code       *
+ * distribution tree.                                                        *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+//
+// This test example is for testing the write buffers of several files: each
+// file maps its own write buffer once, and hands out ranges of it to the
+// writes. Two files are written at the same time, block by block, then a
+// third one after they are closed, and the data of each file is checked
+// after it is reopened without the cache.
+#include "hdf5.h"
+#include "mpi.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include <stdlib.h>
+#include <string.h>
+
+// the value of row i of file k
+#define ROW_VALUE(k, i) ((int)((k)*1000000 + (i)))
+
+// create the file k with its dataset
+static hid_t create_file(int k, hid_t plist_id, hsize_t *gdims, hid_t *dset) {
+  char f[255];
+  sprintf(f, "parallel_file_files_%d.h5", k);
+  hid_t file_id = H5Fcreate(f, H5F_ACC_TRUNC, H5P_DEFAULT, plist_id);
+  hid_t filespace = H5Screate_simple(2, gdims, NULL);
+  *dset = H5Dcreate(file_id, "dset_test", H5T_NATIVE_INT, filespace,
+                    H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  H5Sclose(filespace);
+  return file_id;
+}
+
+// write the block b of nrows rows of the rank
+static void write_block(hid_t dset, int rank, hsize_t *ldims, hsize_t nrows,
+                        hsize_t b, hid_t dxf_id, const int *data) {
+  hsize_t bdims[2] = {nrows, ldims[1]};
+  hsize_t offset[2] = {rank * ldims[0] + b * nrows, 0};
+  hsize_t count[2] = {1, 1};
+  hid_t memspace = H5Screate_simple(2, bdims, NULL);
+  hid_t filespace = H5Dget_space(dset);
+  H5Sselect_hyperslab(filespace, H5S_SELECT_SET, offset, NULL, count, bdims);
+  H5Dwrite(dset, H5T_NATIVE_INT, memspace, filespace, dxf_id,
+           &data[b * nrows * ldims[1]]);
+  H5Sclose(filespace);
+  H5Sclose(memspace);
+}
+
+// read the rows of the rank in the file k, and check them
+static int check_file(int k, hid_t plist_id, int rank, hsize_t *ldims,
+                      int *buf) {
+  char f[255];
+  sprintf(f, "parallel_file_files_%d.h5", k);
+  hsize_t offset[2] = {rank * ldims[0], 0};
+  hsize_t count[2] = {1, 1};
+  int nerr = 0;
+  hid_t file_id = H5Fopen(f, H5F_ACC_RDONLY, plist_id);
+  hid_t dset = H5Dopen(file_id, "dset_test", H5P_DEFAULT);
+  hid_t memspace = H5Screate_simple(2, ldims, NULL);
+  hid_t filespace = H5Dget_space(dset);
+  H5Sselect_hyperslab(filespace, H5S_SELECT_SET, offset, NULL, count, ldims);
+  memset(buf, 0, ldims[0] * ldims[1] * sizeof(int));
+  if (H5Dread(dset, H5T_NATIVE_INT, memspace, filespace, H5P_DEFAULT, buf) <
+      0)
+    nerr++;
+  for (hsize_t i = 0; i < ldims[0]; i++)
+    for (hsize_t j = 0; j < ldims[1]; j++)
+      if (buf[i * ldims[1] + j] != ROW_VALUE(k, offset[0] + i))
+        nerr++;
+  H5Sclose(filespace);
+  H5Sclose(memspace);
+  H5Dclose(dset);
+  H5Fclose(file_id);
+  return nerr;
+}
+
+int main(int argc, char **argv) {
+  size_t d1 = 512;
+  size_t d2 = 64;
+  hsize_t nrows = 8;
+  const int nfiles = 3;
+  hsize_t ldims[2] = {d1, d2};
+  MPI_Comm comm = MPI_COMM_WORLD;
+  MPI_Info info = MPI_INFO_NULL;
+  int rank, nproc, provided;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
+  MPI_Comm_size(comm, &nproc);
+  MPI_Comm_rank(comm, &rank);
+  hsize_t gdims[2] = {d1 * nproc, d2};
+  hsize_t nblock = d1 / nrows;
+  if (rank == 0) {
+    printf("****HDF5 Testing Write Buffers of Several Files*****\n");
+    printf("=============================================\n");
+    printf(" Buf dim: %llu x %llu\n", ldims[0], ldims[1]);
+    printf(" Rows per write: %llu\n", nrows);
+    printf("   Files: %d\n", nfiles);
+    printf("   nproc: %d\n", nproc);
+    printf("=============================================\n");
+  }
+  int nerr = 0;
+  hid_t plist_id = H5Pcreate(H5P_FILE_ACCESS);
+  H5Pset_fapl_mpio(plist_id, comm, info);
+  int *data[nfiles];
+  for (int k = 0; k < nfiles; k++) {
+    data[k] = (int *)malloc(ldims[0] * ldims[1] * sizeof(int));
+    for (hsize_t i = 0; i < ldims[0]; i++)
+      for (hsize_t j = 0; j < ldims[1]; j++)
+        data[k][i * ldims[1] + j] = ROW_VALUE(k, rank * ldims[0] + i);
+  }
+  hid_t dxf_id = H5Pcreate(H5P_DATASET_XFER);
+  H5Pset_dxpl_mpio(dxf_id, H5FD_MPIO_INDEPENDENT);
+
+  // write the first two files through the write cache at the same time
+  setenv("HDF5_CACHE_WR", "yes", 1);
+  if (rank == 0)
+    printf("Writing files 0 and 1\n");
+  hid_t dset[2];
+  hid_t file_id[2];
+  for (int k = 0; k < 2; k++)
+    file_id[k] = create_file(k, plist_id, gdims, &dset[k]);
+  for (hsize_t b = 0; b < nblock; b++)
+    for (int k = 0; k < 2; k++)
+      write_block(dset[k], rank, ldims, nrows, b, dxf_id, data[k]);
+  for (int k = 0; k < 2; k++) {
+    H5Dclose(dset[k]);
+    H5Fclose(file_id[k]);
+  }
+
+  // then the last one, with a new write buffer
+  if (rank == 0)
+    printf("Writing file 2\n");
+  file_id[0] = create_file(2, plist_id, gdims, &dset[0]);
+  for (hsize_t b = 0; b < nblock; b++)
+    write_block(dset[0], rank, ldims, nrows, b, dxf_id, data[2]);
+  H5Dclose(dset[0]);
+  H5Fclose(file_id[0]);
+
+  // read the data back without the write cache
+  setenv("HDF5_CACHE_WR", "no", 1);
+  for (int k = 0; k < nfiles; k++)
+    nerr += check_file(k, plist_id, rank, ldims, data[k]);
+
+  MPI_Allreduce(MPI_IN_PLACE, &nerr, 1, MPI_INT, MPI_SUM, comm);
+  if (rank == 0) {
+    if (nerr > 0)
+      printf("Found %d error(s)\n====================\n\n", nerr);
+    else
+      printf("Passed\n====================\n\n");
+  }
+  for (int k = 0; k < nfiles; k++)
+    free(data[k]);
+  H5Pclose(dxf_id);
+  H5Pclose(plist_id);
+  MPI_Finalize();
+  return nerr > 0;
+}
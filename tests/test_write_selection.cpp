@@ -0,0 +1,124 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright (c) 2023, UChicago Argonne, LLC.                                *
+ * All Rights Reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5 Cache VOL connector.  The full copyright notice *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the LICENSE file, which can be found at the root of the source code       *
+ * distribution tree.                                                        *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+//
+// This test example is for testing the writes of selections with many
+// sequences through the write cache: each rank writes every other column of
+// its rows from every other element of a buffer, so that the memory and the
+// file selections have more sequences than the copy walks at once, and the
+// data is checked after the file is closed and reopened without the cache.
+#include "hdf5.h"
+#include "mpi.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include <stdlib.h>
+#include <string.h>
+
+int main(int argc, char **argv) {
+  size_t d1 = 256;
+  size_t d2 = 64;
+  hsize_t ldims[2] = {d1, d2};
+  MPI_Comm comm = MPI_COMM_WORLD;
+  MPI_Info info = MPI_INFO_NULL;
+  int rank, nproc, provided;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
+  MPI_Comm_size(comm, &nproc);
+  MPI_Comm_rank(comm, &rank);
+  hsize_t gdims[2] = {d1 * nproc, d2};
+  hsize_t nel = d1 * d2 / 2;
+  if (rank == 0) {
+    printf("****HDF5 Testing Strided Writes*****\n");
+    printf("=============================================\n");
+    printf(" Buf dim: %llu x %llu\n", ldims[0], ldims[1]);
+    printf(" Sequences: %llu\n", nel);
+    printf("   nproc: %d\n", nproc);
+    printf("=============================================\n");
+  }
+  int nerr = 0;
+  hid_t plist_id = H5Pcreate(H5P_FILE_ACCESS);
+  H5Pset_fapl_mpio(plist_id, comm, info);
+  char f[255];
+  strcpy(f, "parallel_file_selection.h5");
+  // the elements of the odd columns, in the order of the file selection, in
+  // every other element of the buffer
+  int *data = (int *)malloc(ldims[0] * ldims[1] * sizeof(int));
+  for (hsize_t i = 0; i < d1; i++)
+    for (hsize_t j = 0; j < d2 / 2; j++) {
+      data[2 * (i * d2 / 2 + j)] = (rank * d1 + i) * d2 + 2 * j + 1;
+      data[2 * (i * d2 / 2 + j) + 1] = -1;
+    }
+  hid_t dxf_id = H5Pcreate(H5P_DATASET_XFER);
+  H5Pset_dxpl_mpio(dxf_id, H5FD_MPIO_INDEPENDENT);
+
+  // write through the write cache
+  setenv("HDF5_CACHE_WR", "yes", 1);
+  if (rank == 0)
+    printf("Creating file %s \n", f);
+  hid_t file_id = H5Fcreate(f, H5F_ACC_TRUNC, H5P_DEFAULT, plist_id);
+  hid_t filespace = H5Screate_simple(2, gdims, NULL);
+  hsize_t offset[2] = {rank * d1, 1};
+  hsize_t stride[2] = {1, 2};
+  hsize_t count[2] = {d1, d2 / 2};
+  H5Sselect_hyperslab(filespace, H5S_SELECT_SET, offset, stride, count, NULL);
+  hsize_t mdims[1] = {2 * nel};
+  hsize_t moffset[1] = {0}, mstride[1] = {2}, mcount[1] = {nel};
+  hid_t memspace = H5Screate_simple(1, mdims, NULL);
+  H5Sselect_hyperslab(memspace, H5S_SELECT_SET, moffset, mstride, mcount,
+                      NULL);
+  hid_t dset = H5Dcreate(file_id, "dset_test", H5T_NATIVE_INT, filespace,
+                         H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  if (rank == 0)
+    printf("Writing dataset %s \n", "dset_test");
+  if (H5Dwrite(dset, H5T_NATIVE_INT, memspace, filespace, dxf_id, data) < 0)
+    nerr++;
+  H5Dclose(dset);
+  H5Sclose(memspace);
+  H5Sclose(filespace);
+  if (rank == 0)
+    printf("Closing file %s \n", f);
+  H5Fclose(file_id);
+
+  // read the rows of the rank back without the write cache; the even columns
+  // were not written
+  setenv("HDF5_CACHE_WR", "no", 1);
+  file_id = H5Fopen(f, H5F_ACC_RDONLY, plist_id);
+  dset = H5Dopen(file_id, "dset_test", H5P_DEFAULT);
+  filespace = H5Dget_space(dset);
+  offset[1] = 0;
+  count[0] = count[1] = 1;
+  H5Sselect_hyperslab(filespace, H5S_SELECT_SET, offset, NULL, count, ldims);
+  memspace = H5Screate_simple(2, ldims, NULL);
+  memset(data, 0xff, ldims[0] * ldims[1] * sizeof(int));
+  if (H5Dread(dset, H5T_NATIVE_INT, memspace, filespace, H5P_DEFAULT, data) <
+      0)
+    nerr++;
+  for (hsize_t i = 0; i < d1; i++)
+    for (hsize_t j = 0; j < d2; j++)
+      if (data[i * d2 + j] !=
+          ((j % 2 == 1) ? (int)((rank * d1 + i) * d2 + j) : 0))
+        nerr++;
+  H5Sclose(memspace);
+  H5Sclose(filespace);
+  H5Dclose(dset);
+  H5Fclose(file_id);
+
+  MPI_Allreduce(MPI_IN_PLACE, &nerr, 1, MPI_INT, MPI_SUM, comm);
+  if (rank == 0) {
+    if (nerr > 0)
+      printf("Found %d error(s)\n====================\n\n", nerr);
+    else
+      printf("Passed\n====================\n\n");
+  }
+  free(data);
+  H5Pclose(dxf_id);
+  H5Pclose(plist_id);
+  MPI_Finalize();
+  return nerr > 0;
+}
@@ -0,0 +1,189 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright (c) 2023, UChicago Argonne, LLC.                                *
+ * All Rights Reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5 Cache VOL connector.  The full copyright notice *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the LICENSE file, which can be found at the root of the source code       *
+ * distribution tree.                                                        *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*
+  Stage the read caches of datasets ahead of an application, e.g., in a job
+  prologue or in a job step running before the application.
+
+    mpirun -np N h5cache_stage [-c config] file dset1 [dset2 ...]
+
+  Each dataset is opened through the Cache VOL with the read cache on and
+  prefetched as a whole (H5Dprefetch), so that its samples are read from the
+  parallel file system and written to the node-local caches, with the layout
+  the application will use. With "HDF5_CACHE_PREFETCH_AGGREGATORS" in the
+  configuration, the reads are done by a few ranks per node in large
+  contiguous blocks.
+
+  The caches are only kept for the application with "HDF5_CACHE_PERSISTENT:
+  yes" in the configuration (the tool stops otherwise), and the tool has to
+  run with the same number of ranks, on the same nodes, as the application.
+ */
+#include "hdf5.h"
+#include "mpi.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cache_new_h5api.h"
+
+static void usage(const char *prog) {
+  fprintf(stderr, "Usage: %s [-c config] file dataset [dataset ...]\n", prog);
+  fprintf(stderr, "  -c config  configuration file of the Cache VOL; used "
+                  "when HDF5_VOL_CONNECTOR is not set\n");
+}
+
+/* path of the configuration file of the Cache VOL: the one given with -c, or
+ * the config= key of HDF5_VOL_CONNECTOR */
+static bool get_config_path(const char *config, char *path, size_t len) {
+  const char *p = config;
+  size_t n;
+  if (p == NULL) {
+    const char *connector = getenv("HDF5_VOL_CONNECTOR");
+    if (connector == NULL || (p = strstr(connector, "config=")) == NULL)
+      return false;
+    p += strlen("config=");
+  }
+  n = strcspn(p, ";} \t");
+  if (n == 0 || n >= len)
+    return false;
+  memcpy(path, p, n);
+  path[n] = '\0';
+  return true;
+}
+
+/* whether the configuration keeps the caches after the datasets are closed
+ * ("HDF5_CACHE_PERSISTENT: yes"), parsed as the Cache VOL does */
+static bool is_persistent_config(const char *path) {
+  char line[256], key[256], value[256];
+  bool persistent = false;
+  FILE *fp = fopen(path, "r");
+  if (fp == NULL)
+    return false;
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    if (line[0] == '#')
+      continue;
+    if (sscanf(line, "%[^:]:%s", key, value) == 2 &&
+        !strcmp(key, "HDF5_CACHE_PERSISTENT"))
+      persistent = !strcmp(value, "yes");
+  }
+  fclose(fp);
+  return persistent;
+}
+
+int main(int argc, char **argv) {
+  int rank, nproc, provided;
+  int opt, i, nerr = 0;
+  char *config = NULL;
+  char connector[1024], path[1024];
+  double t0, t1;
+
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &nproc);
+
+  while ((opt = getopt(argc, argv, "c:h")) != -1) {
+    switch (opt) {
+    case 'c':
+      config = optarg;
+      break;
+    default:
+      if (rank == 0)
+        usage(argv[0]);
+      MPI_Finalize();
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (argc - optind < 2) {
+    if (rank == 0)
+      usage(argv[0]);
+    MPI_Finalize();
+    return 1;
+  }
+  if (provided != MPI_THREAD_MULTIPLE && rank == 0)
+    fprintf(stderr, "h5cache_stage: MPI_THREAD_MULTIPLE is not supported, "
+                    "the Async VOL may not work\n");
+
+  // the connector has to be set before the first call to HDF5
+  if (config != NULL && getenv("HDF5_VOL_CONNECTOR") == NULL) {
+    snprintf(connector, sizeof(connector),
+             "cache_ext config=%s;under_vol=0;under_info={}", config);
+    setenv("HDF5_VOL_CONNECTOR", connector, 1);
+  }
+  setenv("HDF5_CACHE_RD", "yes", 1);
+
+  // without persistent caches, the staged caches would be removed as soon as
+  // the datasets are closed
+  int persistent = 0;
+  if (rank == 0)
+    persistent = get_config_path(config, path, sizeof(path)) &&
+                 is_persistent_config(path);
+  MPI_Bcast(&persistent, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  if (!persistent) {
+    if (rank == 0)
+      fprintf(stderr, "h5cache_stage: the configuration of the Cache VOL "
+                      "does not set \"HDF5_CACHE_PERSISTENT: yes\"; the "
+                      "staged caches would not be kept\n");
+    MPI_Finalize();
+    return 1;
+  }
+
+  hid_t fapl = H5Pcreate(H5P_FILE_ACCESS);
+  H5Pset_fapl_mpio(fapl, MPI_COMM_WORLD, MPI_INFO_NULL);
+  hid_t fd = H5Fopen(argv[optind], H5F_ACC_RDONLY, fapl);
+  H5Pclose(fapl);
+  if (fd < 0) {
+    if (rank == 0)
+      fprintf(stderr, "h5cache_stage: could not open %s\n", argv[optind]);
+    MPI_Finalize();
+    return 1;
+  }
+  if (rank == 0)
+    printf("Staging %d dataset(s) of %s with %d ranks\n", argc - optind - 1,
+           argv[optind], nproc);
+  for (i = optind + 1; i < argc; i++) {
+    hid_t dset = H5Dopen(fd, argv[i], H5P_DEFAULT);
+    int ok = dset >= 0, all_ok;
+    hsize_t nbytes = 0;
+    t0 = MPI_Wtime();
+    // the prefetch is collective, so it is only started if all the ranks
+    // opened the dataset
+    MPI_Allreduce(&ok, &all_ok, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    ok = all_ok;
+    if (ok) {
+      hid_t fspace = H5Dget_space(dset);
+      hid_t dtype = H5Dget_type(dset);
+      nbytes = H5Sget_simple_extent_npoints(fspace) * H5Tget_size(dtype);
+      H5Tclose(dtype);
+      H5Sclose(fspace);
+      ok = H5Dprefetch(dset, H5S_ALL, H5P_DEFAULT) >= 0;
+    }
+    // closing the dataset writes the manifest of the persistent caches
+    if (dset >= 0)
+      H5Dclose(dset);
+    MPI_Allreduce(&ok, &all_ok, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    t1 = MPI_Wtime() - t0;
+    if (rank == 0) {
+      if (all_ok)
+        printf("  %s: %llu bytes in %.3f s (%.3f MiB/s)\n", argv[i],
+               (unsigned long long)nbytes, t1,
+               t1 > 0 ? nbytes / t1 / 1048576.0 : 0.0);
+      else
+        printf("  %s: FAILED\n", argv[i]);
+    }
+    if (!all_ok)
+      nerr++;
+  }
+
+  H5Fclose(fd);
+  MPI_Finalize();
+  return nerr > 0 ? 1 : 0;
+}